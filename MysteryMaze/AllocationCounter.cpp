@@ -0,0 +1,165 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace {
+    std::atomic<std::uint64_t> allocations{ 0 };
+    std::atomic<std::uint64_t> bytes{ 0 };
+
+    const std::size_t tagCount = static_cast<std::size_t>(MemoryTag::Count);
+
+    struct TagCounters {
+        std::atomic<std::int64_t> live{ 0 };
+        std::atomic<std::int64_t> peak{ 0 };
+        std::atomic<std::uint64_t> allocations{ 0 };
+        std::atomic<std::uint64_t> frees{ 0 };
+    };
+    TagCounters tags[tagCount];
+
+    thread_local MemoryTag currentTag = MemoryTag::Other;
+
+    // The last four bytes of every block we hand out: "MMT" and the tag
+    const std::uint32_t trailerMagic = 0x4d4d5400;
+    const std::size_t trailerSize = sizeof(std::uint32_t);
+
+    std::size_t usableSize(void* memory) {
+#if defined(_WIN32)
+        return _msize(memory);
+#elif defined(__APPLE__)
+        return malloc_size(memory);
+#else
+        return malloc_usable_size(memory);
+#endif
+    }
+
+    void* countedAlloc(std::size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+        void* memory = std::malloc(size + trailerSize);
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+
+        MemoryTag tag = currentTag;
+        std::size_t usable = usableSize(memory);
+        std::uint32_t trailer = trailerMagic | static_cast<std::uint32_t>(tag);
+        std::memcpy(static_cast<char*>(memory) + usable - trailerSize, &trailer, trailerSize);
+
+        TagCounters& counters = tags[static_cast<std::size_t>(tag)];
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        std::int64_t live = counters.live.fetch_add(static_cast<std::int64_t>(usable), std::memory_order_relaxed) + static_cast<std::int64_t>(usable);
+        std::int64_t peak = counters.peak.load(std::memory_order_relaxed);
+        while (live > peak && !counters.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+        return memory;
+    }
+
+    void countedFree(void* memory) {
+        if (!memory) {
+            return;
+        }
+        std::size_t usable = usableSize(memory);
+        std::uint32_t trailer = 0;
+        if (usable >= trailerSize) {
+            char* at = static_cast<char*>(memory) + usable - trailerSize;
+            std::memcpy(&trailer, at, trailerSize);
+            std::memset(at, 0, trailerSize); // So a later owner of the block is not mistaken for ours
+        }
+        std::uint32_t tag = trailer & 0xff;
+        if ((trailer & ~0xffu) == trailerMagic && tag < tagCount) {
+            TagCounters& counters = tags[tag];
+            counters.frees.fetch_add(1, std::memory_order_relaxed);
+            counters.live.fetch_sub(static_cast<std::int64_t>(usable), std::memory_order_relaxed);
+        }
+        std::free(memory);
+    }
+}
+
+std::uint64_t allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+std::uint64_t allocatedBytes() {
+    return bytes.load(std::memory_order_relaxed);
+}
+
+const char* memoryTagName(MemoryTag tag) {
+    switch (tag) {
+    case MemoryTag::Other: return "other";
+    case MemoryTag::Maze: return "maze";
+    case MemoryTag::AI: return "ai";
+    case MemoryTag::Rendering: return "rendering";
+    case MemoryTag::Save: return "save";
+    case MemoryTag::Network: return "network";
+    case MemoryTag::Text: return "text";
+    case MemoryTag::Count: break;
+    }
+    return "?";
+}
+
+MemoryTagStats memoryTagStats(MemoryTag tag) {
+    const TagCounters& counters = tags[static_cast<std::size_t>(tag)];
+    MemoryTagStats stats;
+    stats.liveBytes = counters.live.load(std::memory_order_relaxed);
+    stats.peakBytes = counters.peak.load(std::memory_order_relaxed);
+    stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+    stats.frees = counters.frees.load(std::memory_order_relaxed);
+    return stats;
+}
+
+MemoryTag setMemoryTag(MemoryTag tag) {
+    MemoryTag previous = currentTag;
+    currentTag = tag;
+    return previous;
+}
+
+void* operator new(std::size_t size) {
+    return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size) {
+    return countedAlloc(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return countedAlloc(size);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return countedAlloc(size);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* memory) noexcept {
+    countedFree(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    countedFree(memory);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+
+// Counting hook on the global operator new. Every heap allocation made by
+// the game (and by SFML, std::string, etc.) bumps the counter, so the
+// difference between two reads is the number of allocations in between.
+std::uint64_t allocationCount();
+std::uint64_t allocatedBytes();
+
+// Each allocation is also charged to the subsystem that made it, named by
+// the innermost MemoryTagScope on the allocating thread, and credited back
+// to the same tag when it is freed, wherever that happens. Sizes are what
+// the heap really set aside, which may be a little more than was asked for.
+//
+// The tag rides in the last bytes of the block. A block this hook did not
+// allocate (one from inside a DLL with a heap of its own, say) is not
+// counted when freed here, and one of ours freed elsewhere stays live.
+enum class MemoryTag : std::uint8_t {
+    Other,
+    Maze,      // Level arenas and mapped maze files
+    AI,        // Enemy search, bots, ghosts and distance fields
+    Rendering,
+    Save,      // Saves, autosave, replays and the save catalog
+    Network,
+    Text,      // HUD and console strings
+    Count,
+};
+
+const char* memoryTagName(MemoryTag tag);
+
+struct MemoryTagStats {
+    std::int64_t liveBytes = 0;
+    std::int64_t peakBytes = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+};
+
+MemoryTagStats memoryTagStats(MemoryTag tag);
+
+// Charges this thread's allocations to tag from now on; returns the tag it replaces
+MemoryTag setMemoryTag(MemoryTag tag);
+
+// Charges this thread's allocations to tag until it goes out of scope
+class MemoryTagScope {
+public:
+    explicit MemoryTagScope(MemoryTag tag) : previous(setMemoryTag(tag)) {}
+    ~MemoryTagScope() { setMemoryTag(previous); }
+
+    MemoryTagScope(const MemoryTagScope&) = delete;
+    MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+private:
+    MemoryTag previous;
+};
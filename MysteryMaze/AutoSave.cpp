@@ -0,0 +1,90 @@
+#include "AutoSave.h"
+#include "World.h"
+#include "Profiler.h"
+#include "AllocationCounter.h"
+#include <iostream>
+
+AutoSaver::AutoSaver(SaveCatalog& catalog, SaveMode mode, float intervalSeconds)
+    : catalog(catalog), mode(mode),
+      interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(intervalSeconds))),
+      lastSave(std::chrono::steady_clock::now()) {
+    worker = std::thread(&AutoSaver::workerLoop, this);
+}
+
+AutoSaver::~AutoSaver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWorker.notify_one();
+    worker.join();
+}
+
+void AutoSaver::update(const World& world) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (std::chrono::steady_clock::now() - lastSave < interval) {
+        return;
+    }
+    {
+        // Try again next frame rather than dropping a save the player asked for
+        std::lock_guard<std::mutex> lock(mutex);
+        if (snapshotQueued && back.slot != autosaveSlot) {
+            return;
+        }
+    }
+    saveNow(world);
+}
+
+void AutoSaver::saveNow(const World& world, int slot) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    lastSave = std::chrono::steady_clock::now();
+    {
+        // The worker only holds the lock to swap buffers, never while writing
+        std::lock_guard<std::mutex> lock(mutex);
+        serializeWorld(world, back.data, mode);
+        back.slot = slot;
+        back.entry = makeSlotEntry(world, mode, back.data.size());
+        makeThumbnail(world, back.thumbnail);
+        snapshotQueued = true;
+    }
+    wakeWorker.notify_one();
+}
+
+int AutoSaver::completedSaves() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return saved;
+}
+
+int AutoSaver::failedSaves() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+void AutoSaver::workerLoop() {
+    nameProfilerThread("autosave");
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorker.wait(lock, [this] { return snapshotQueued || stopping; });
+            if (!snapshotQueued) {
+                return; // Stopping with nothing left to write
+            }
+            std::swap(front, back);
+            snapshotQueued = false;
+        }
+
+        std::string filename = SaveCatalog::slotFilename(front.slot);
+        bool ok = writeFileAtomically(filename, front.data.data(), front.data.size())
+            && catalog.updateSlot(front.slot, front.entry, front.thumbnail);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ok) {
+            ++saved;
+        }
+        else {
+            ++failed;
+            std::cerr << "Autosave to " << filename << " failed" << std::endl;
+        }
+    }
+}
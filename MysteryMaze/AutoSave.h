@@ -0,0 +1,63 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SaveCatalog.h"
+
+struct World;
+
+// Saves the world without ever making the caller wait on the disk.
+//
+// The calling thread serializes a snapshot into the back buffer (a copy of a
+// few kilobytes), then a worker thread swaps it to the front and writes it
+// out with writeFileAtomically before updating the slot's catalog entry.
+// If another snapshot arrives while the worker is still busy it simply
+// replaces the queued one; timed autosaves never replace a requested save.
+class AutoSaver {
+public:
+    AutoSaver(SaveCatalog& catalog, SaveMode mode, float intervalSeconds);
+    ~AutoSaver(); // Finishes any queued save before returning
+
+    AutoSaver(const AutoSaver&) = delete;
+    AutoSaver& operator=(const AutoSaver&) = delete;
+
+    // Call once per frame; queues a save to the autosave slot every intervalSeconds
+    void update(const World& world);
+
+    // Queue a save right away (e.g. on a key press)
+    void saveNow(const World& world, int slot = autosaveSlot);
+
+    int completedSaves() const;
+    int failedSaves() const;
+
+private:
+    // Everything the worker needs to write one save
+    struct Snapshot {
+        std::vector<char> data;
+        int slot = autosaveSlot;
+        SaveSlotEntry entry = {};
+        unsigned char thumbnail[thumbnailBytes] = {};
+    };
+
+    void workerLoop();
+
+    SaveCatalog& catalog;
+    SaveMode mode;
+    std::chrono::steady_clock::duration interval;
+    std::chrono::steady_clock::time_point lastSave;
+
+    Snapshot front; // Only touched by the worker while it writes
+    Snapshot back;  // Snapshot waiting to be written
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeWorker;
+    bool snapshotQueued = false;
+    bool stopping = false;
+    int saved = 0;
+    int failed = 0;
+
+    std::thread worker;
+};
@@ -0,0 +1,440 @@
+#include "BenchGate.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+    // Just enough JSON to read back what writeBenchResults wrote: objects,
+    // arrays, numbers and strings without escapes
+    struct Json {
+        enum class Type { Null, Number, String, Array, Object };
+        Type type = Type::Null;
+        double number = 0.0;
+        std::string text;
+        std::vector<Json> items;
+        std::vector<std::pair<std::string, Json>> members;
+
+        const Json* member(const char* key) const {
+            for (const auto& entry : members) {
+                if (entry.first == key) {
+                    return &entry.second;
+                }
+            }
+            return nullptr;
+        }
+    };
+
+    class JsonParser {
+    public:
+        explicit JsonParser(const std::string& text) : next(text.c_str()), end(text.c_str() + text.size()) {}
+
+        bool parse(Json& value) {
+            if (!parseValue(value)) {
+                return false;
+            }
+            skipSpace();
+            return next == end;
+        }
+
+    private:
+        void skipSpace() {
+            while (next < end && std::isspace(static_cast<unsigned char>(*next))) {
+                ++next;
+            }
+        }
+
+        bool take(char c) {
+            skipSpace();
+            if (next < end && *next == c) {
+                ++next;
+                return true;
+            }
+            return false;
+        }
+
+        bool parseString(std::string& text) {
+            if (!take('"')) {
+                return false;
+            }
+            const char* start = next;
+            while (next < end && *next != '"') {
+                if (*next == '\\') {
+                    return false;
+                }
+                ++next;
+            }
+            if (next == end) {
+                return false;
+            }
+            text.assign(start, next++);
+            return true;
+        }
+
+        bool parseValue(Json& value) {
+            skipSpace();
+            if (next == end) {
+                return false;
+            }
+            if (*next == '{') {
+                value.type = Json::Type::Object;
+                ++next;
+                if (take('}')) {
+                    return true;
+                }
+                do {
+                    std::pair<std::string, Json> entry;
+                    if (!parseString(entry.first) || !take(':') || !parseValue(entry.second)) {
+                        return false;
+                    }
+                    value.members.push_back(std::move(entry));
+                } while (take(','));
+                return take('}');
+            }
+            if (*next == '[') {
+                value.type = Json::Type::Array;
+                ++next;
+                if (take(']')) {
+                    return true;
+                }
+                do {
+                    value.items.emplace_back();
+                    if (!parseValue(value.items.back())) {
+                        return false;
+                    }
+                } while (take(','));
+                return take(']');
+            }
+            if (*next == '"') {
+                value.type = Json::Type::String;
+                return parseString(value.text);
+            }
+            char* after = nullptr;
+            value.number = std::strtod(next, &after);
+            if (after == next) {
+                return false;
+            }
+            value.type = Json::Type::Number;
+            next = after;
+            return true;
+        }
+
+        const char* next;
+        const char* end;
+    };
+
+    double numberOf(const Json& object, const char* key) {
+        const Json* value = object.member(key);
+        return value && value->type == Json::Type::Number ? value->number : 0.0;
+    }
+
+    std::vector<double> numbersOf(const Json& object, const char* key) {
+        std::vector<double> numbers;
+        const Json* value = object.member(key);
+        if (value && value->type == Json::Type::Array) {
+            for (const Json& item : value->items) {
+                numbers.push_back(item.number);
+            }
+        }
+        return numbers;
+    }
+
+    const char* formatNumber(char (&buffer)[32], double value) {
+        std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+        return buffer;
+    }
+
+    void writeNumbers(std::ostream& out, const std::vector<double>& numbers) {
+        char buffer[32];
+        out << '[';
+        for (std::size_t i = 0; i < numbers.size(); ++i) {
+            out << (i ? ", " : "") << formatNumber(buffer, numbers[i]);
+        }
+        out << ']';
+    }
+
+    double median(std::vector<double> values) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        std::sort(values.begin(), values.end());
+        std::size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+    }
+
+    // Standard deviation of the samples relative to their median, estimated
+    // from the median absolute deviation so one outlier repeat cannot blow it up
+    double relativeSpread(const std::vector<double>& samples) {
+        double middle = median(samples);
+        if (samples.size() < 2 || middle <= 0.0) {
+            return 0.0;
+        }
+        std::vector<double> deviations;
+        for (double sample : samples) {
+            deviations.push_back(std::fabs(sample - middle));
+        }
+        return 1.4826 * median(deviations) / middle;
+    }
+
+    // Smallest relative change in the median of baseline's repeats against
+    // current's that their spread cannot account for. The median of n
+    // repeats wanders by about 1.25 standard deviations over the root of n.
+    double noiseThreshold(const std::vector<double>& baseline, const std::vector<double>& current) {
+        double variance = 0.0;
+        if (!baseline.empty()) {
+            double spread = relativeSpread(baseline);
+            variance += spread * spread / baseline.size();
+        }
+        if (!current.empty()) {
+            double spread = relativeSpread(current);
+            variance += spread * spread / current.size();
+        }
+        return gateNoiseSigmas * 1.25 * std::sqrt(variance);
+    }
+
+    // The time each benchmark is held to; the rest are shown but do not fail the gate
+    GateMetric timeMetricOf(const std::string& name, bool& tracked) {
+        auto startsWith = [&name](const char* prefix) { return name.compare(0, std::char_traits<char>::length(prefix), prefix) == 0; };
+        tracked = true;
+        if (startsWith("generateMaze/") || startsWith("buildDistanceField/")) {
+            return GateMetric::CellsPerSecond;
+        }
+        if (startsWith("frame/")) {
+            return GateMetric::P99Ns;
+        }
+        tracked = startsWith("save");
+        return GateMetric::NsPerOp;
+    }
+
+    const BenchResult* find(const std::vector<BenchResult>& results, const std::string& name) {
+        for (const BenchResult& result : results) {
+            if (result.name == name) {
+                return &result;
+            }
+        }
+        return nullptr;
+    }
+
+    GateRow compareTime(const BenchResult& before, const BenchResult& after, GateMetric metric, bool tracked, double minimumChange) {
+        GateRow row;
+        row.name = after.name;
+        row.metric = metric;
+        const std::vector<double>* beforeSamples = &before.nsPerOpSamples;
+        const std::vector<double>* afterSamples = &after.nsPerOpSamples;
+        if (metric == GateMetric::CellsPerSecond) {
+            row.baseline = before.cellsPerSecond;
+            row.current = after.cellsPerSecond;
+            row.change = row.baseline > 0.0 ? (row.baseline - row.current) / row.baseline : 0.0;
+        }
+        else {
+            row.baseline = metric == GateMetric::P99Ns ? before.p99Ns : before.nsPerOp;
+            row.current = metric == GateMetric::P99Ns ? after.p99Ns : after.nsPerOp;
+            row.change = row.baseline > 0.0 ? (row.current - row.baseline) / row.baseline : 0.0;
+            if (metric == GateMetric::P99Ns) {
+                beforeSamples = &before.p99Samples;
+                afterSamples = &after.p99Samples;
+            }
+        }
+        row.threshold = std::max(minimumChange, noiseThreshold(*beforeSamples, *afterSamples));
+        if (!tracked) {
+            row.status = GateStatus::Untracked;
+        }
+        else if (row.change > row.threshold) {
+            row.status = GateStatus::Regressed;
+        }
+        else if (row.change < -row.threshold) {
+            row.status = GateStatus::Faster;
+        }
+        return row;
+    }
+
+    const char* metricName(GateMetric metric) {
+        switch (metric) {
+        case GateMetric::CellsPerSecond: return "cells/s";
+        case GateMetric::NsPerOp: return "time/op";
+        case GateMetric::P99Ns: return "p99";
+        case GateMetric::AllocsPerOp: return "allocs/op";
+        }
+        return "";
+    }
+
+    const char* statusName(GateStatus status) {
+        switch (status) {
+        case GateStatus::Same: return "ok";
+        case GateStatus::Faster: return "better";
+        case GateStatus::Regressed: return "REGRESSED";
+        case GateStatus::Untracked: return "-";
+        case GateStatus::NotRun: return "not run";
+        case GateStatus::New: return "new";
+        }
+        return "";
+    }
+
+    // Times with a unit that keeps them short; rates in millions
+    std::string formatMetric(GateMetric metric, double value) {
+        char buffer[32];
+        switch (metric) {
+        case GateMetric::CellsPerSecond:
+            std::snprintf(buffer, sizeof(buffer), "%.1fM", value / 1e6);
+            break;
+        case GateMetric::AllocsPerOp:
+            std::snprintf(buffer, sizeof(buffer), "%.2f", value);
+            break;
+        default:
+            if (value >= 1e6) {
+                std::snprintf(buffer, sizeof(buffer), "%.2f ms", value / 1e6);
+            }
+            else if (value >= 1e3) {
+                std::snprintf(buffer, sizeof(buffer), "%.2f us", value / 1e3);
+            }
+            else {
+                std::snprintf(buffer, sizeof(buffer), "%.1f ns", value);
+            }
+            break;
+        }
+        return buffer;
+    }
+}
+
+void writeBenchResults(std::ostream& out, const std::vector<BenchResult>& results, int minMs, int repeats) {
+    char buffer[32];
+    out << "{\n  \"min_ms\": " << minMs << ",\n  \"repeats\": " << repeats << ",\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        out << "    { \"name\": \"" << result.name << "\", \"iterations\": " << result.iterations;
+        out << ", \"ns_per_op\": " << formatNumber(buffer, result.nsPerOp);
+        out << ", \"cells_per_second\": " << formatNumber(buffer, result.cellsPerSecond);
+        out << ", \"allocs_per_op\": " << formatNumber(buffer, result.allocsPerOp);
+        out << ", \"p99_ns\": " << formatNumber(buffer, result.p99Ns);
+        out << ",\n      \"samples_ns_per_op\": ";
+        writeNumbers(out, result.nsPerOpSamples);
+        out << ", \"samples_p99_ns\": ";
+        writeNumbers(out, result.p99Samples);
+        out << " }" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    out << "  ]\n}\n";
+}
+
+bool readBenchResults(const std::string& filename, std::vector<BenchResult>& results) {
+    std::ifstream in(filename);
+    if (!in) {
+        return false;
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+
+    Json root;
+    if (!JsonParser(text.str()).parse(root) || root.type != Json::Type::Object) {
+        return false;
+    }
+    const Json* benchmarks = root.member("benchmarks");
+    if (!benchmarks || benchmarks->type != Json::Type::Array) {
+        return false;
+    }
+    results.clear();
+    for (const Json& entry : benchmarks->items) {
+        const Json* name = entry.member("name");
+        if (entry.type != Json::Type::Object || !name || name->type != Json::Type::String) {
+            return false;
+        }
+        BenchResult result;
+        result.name = name->text;
+        result.iterations = static_cast<std::uint64_t>(numberOf(entry, "iterations"));
+        result.nsPerOp = numberOf(entry, "ns_per_op");
+        result.cellsPerSecond = numberOf(entry, "cells_per_second");
+        result.allocsPerOp = numberOf(entry, "allocs_per_op");
+        result.p99Ns = numberOf(entry, "p99_ns");
+        result.nsPerOpSamples = numbersOf(entry, "samples_ns_per_op");
+        result.p99Samples = numbersOf(entry, "samples_p99_ns");
+        results.push_back(std::move(result));
+    }
+    return true;
+}
+
+std::vector<GateRow> compareBenchResults(const std::vector<BenchResult>& baseline, const std::vector<BenchResult>& current, double minimumChange) {
+    std::vector<GateRow> rows;
+    for (const BenchResult& after : current) {
+        bool tracked = false;
+        GateMetric metric = timeMetricOf(after.name, tracked);
+        const BenchResult* before = find(baseline, after.name);
+        if (!before) {
+            GateRow row;
+            row.name = after.name;
+            row.metric = metric;
+            row.current = metric == GateMetric::CellsPerSecond ? after.cellsPerSecond : metric == GateMetric::P99Ns ? after.p99Ns : after.nsPerOp;
+            row.status = GateStatus::New;
+            rows.push_back(row);
+            continue;
+        }
+        rows.push_back(compareTime(*before, after, metric, tracked, minimumChange));
+
+        if (before->allocsPerOp > 0.0 || after.allocsPerOp > 0.0) {
+            GateRow allocs;
+            allocs.name = after.name;
+            allocs.metric = GateMetric::AllocsPerOp;
+            allocs.baseline = before->allocsPerOp;
+            allocs.current = after.allocsPerOp;
+            allocs.change = allocs.current - allocs.baseline;
+            allocs.threshold = 0.5;
+            allocs.status = allocs.change >= allocs.threshold ? GateStatus::Regressed
+                : allocs.change <= -allocs.threshold ? GateStatus::Faster : GateStatus::Same;
+            rows.push_back(allocs);
+        }
+    }
+    for (const BenchResult& before : baseline) {
+        if (!find(current, before.name)) {
+            bool tracked = false;
+            GateRow row;
+            row.name = before.name;
+            row.metric = timeMetricOf(before.name, tracked);
+            row.baseline = row.metric == GateMetric::CellsPerSecond ? before.cellsPerSecond : row.metric == GateMetric::P99Ns ? before.p99Ns : before.nsPerOp;
+            row.status = GateStatus::NotRun;
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+bool anyRegressed(const std::vector<GateRow>& rows) {
+    return std::any_of(rows.begin(), rows.end(), [](const GateRow& row) { return row.status == GateStatus::Regressed; });
+}
+
+void printGateTable(std::ostream& out, const std::vector<GateRow>& rows) {
+    std::size_t nameWidth = 9;
+    for (const GateRow& row : rows) {
+        nameWidth = std::max(nameWidth, row.name.size());
+    }
+    out << std::left << std::setw(static_cast<int>(nameWidth)) << "benchmark" << std::right
+        << std::setw(11) << "metric" << std::setw(13) << "baseline" << std::setw(13) << "current"
+        << std::setw(10) << "change" << std::setw(11) << "tolerance" << "  status" << '\n';
+    out << std::string(nameWidth + 58 + 10, '-') << '\n';
+
+    char change[32];
+    char tolerance[32];
+    for (const GateRow& row : rows) {
+        bool compared = row.status != GateStatus::New && row.status != GateStatus::NotRun;
+        if (!compared) {
+            change[0] = '\0';
+            tolerance[0] = '\0';
+        }
+        else if (row.metric == GateMetric::AllocsPerOp) {
+            std::snprintf(change, sizeof(change), "%+.2f", row.change);
+            std::snprintf(tolerance, sizeof(tolerance), "%.2f", row.threshold);
+        }
+        else {
+            // Shown as the change in the number itself, so a drop in cells/s reads as negative
+            double shown = row.metric == GateMetric::CellsPerSecond ? -row.change : row.change;
+            std::snprintf(change, sizeof(change), "%+.1f%%", shown * 100.0);
+            std::snprintf(tolerance, sizeof(tolerance), "%.1f%%", row.threshold * 100.0);
+        }
+        out << std::left << std::setw(static_cast<int>(nameWidth)) << row.name << std::right
+            << std::setw(11) << metricName(row.metric)
+            << std::setw(13) << (row.status == GateStatus::New ? "" : formatMetric(row.metric, row.baseline))
+            << std::setw(13) << (row.status == GateStatus::NotRun ? "" : formatMetric(row.metric, row.current))
+            << std::setw(10) << change << std::setw(11) << tolerance << "  " << statusName(row.status) << '\n';
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Microbenchmark results, and the regression gate that holds them against a
+// baseline recorded earlier (bench_baseline.json, checked in next to the
+// sources). Both are read and written as MicroBench's JSON.
+
+// One benchmark's figures. The headline numbers are the median of the
+// repeats; the samples keep each repeat's, which is what the gate judges
+// noise by.
+struct BenchResult {
+    std::string name;
+    std::uint64_t iterations = 0;
+    double nsPerOp = 0.0;
+    double cellsPerSecond = 0.0; // 0 where the benchmark does not work on the grid
+    double allocsPerOp = 0.0;
+    double p99Ns = 0.0;          // Of one run: one maze generated, one frame, one save...
+    std::vector<double> nsPerOpSamples;
+    std::vector<double> p99Samples;
+};
+
+void writeBenchResults(std::ostream& out, const std::vector<BenchResult>& results, int minMs, int repeats);
+
+// False if the file is missing or not MicroBench's JSON
+bool readBenchResults(const std::string& filename, std::vector<BenchResult>& results);
+
+// Which number of a benchmark the gate holds it to
+enum class GateMetric {
+    CellsPerSecond, // Higher is better
+    NsPerOp,
+    P99Ns,
+    AllocsPerOp,
+};
+
+enum class GateStatus {
+    Same,       // Within the noise
+    Faster,
+    Regressed,
+    Untracked,  // Shown for information only
+    NotRun,     // In the baseline but not measured this time
+    New,        // Measured but not in the baseline yet
+};
+
+struct GateRow {
+    std::string name;
+    GateMetric metric = GateMetric::NsPerOp;
+    double baseline = 0.0;
+    double current = 0.0;
+    double change = 0.0;    // Relative; positive is worse
+    double threshold = 0.0; // The worsening tolerated, relative
+    GateStatus status = GateStatus::Same;
+};
+
+// The worsening always tolerated, relative, whatever the noise
+const double gateMinimumChange = 0.05;
+// How many robust standard deviations of repeat-to-repeat spread a change
+// must clear to count
+const double gateNoiseSigmas = 3.0;
+
+// One row per tracked metric of every benchmark in either set. A change
+// counts only when it is worse than both minimumChange and the noise both
+// runs showed between their repeats; allocations are counted exactly, so
+// any rise of half an allocation per op or more is a regression.
+std::vector<GateRow> compareBenchResults(const std::vector<BenchResult>& baseline, const std::vector<BenchResult>& current,
+    double minimumChange = gateMinimumChange);
+
+bool anyRegressed(const std::vector<GateRow>& rows);
+
+void printGateTable(std::ostream& out, const std::vector<GateRow>& rows);
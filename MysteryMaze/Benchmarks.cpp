@@ -0,0 +1,756 @@
+#include "Benchmarks.h"
+#include "World.h"
+#include "SaveGame.h"
+#include "GridCodec.h"
+#include "Replay.h"
+#include "Rollback.h"
+#include "RaceHost.h"
+#include "RaceClient.h"
+#include "Lockstep.h"
+#include "NetworkEmulator.h"
+#include "RaceBot.h"
+#include "Spectator.h"
+#include "Histogram.h"
+#include "AllocationCounter.h"
+#include "HudText.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+// Average microseconds per call of load(), repeated until at least a quarter second has passed
+template <typename Load>
+static double timeLoads(Load load) {
+    using Clock = std::chrono::steady_clock;
+    int iterations = 0;
+    Clock::time_point start = Clock::now();
+    Clock::duration elapsed;
+    do {
+        load();
+        ++iterations;
+        elapsed = Clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(250));
+    return std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+}
+
+void runSaveBenchmark(std::ostream& out) {
+    const int levels[] = { 1, 5, 10, 25, 50, 100 };
+    const char* fullFile = "bench_full.dat";
+    const char* seedFile = "bench_seed.dat";
+
+    out << std::left << std::setw(7) << "level" << std::setw(11) << "maze"
+        << std::setw(12) << "full bytes" << std::setw(12) << "seed bytes"
+        << std::setw(14) << "full load us" << std::setw(14) << "seed load us" << '\n';
+
+    for (int level : levels) {
+        World world;
+        world.seed = 12345;
+        world.level = level;
+        world.width = world.height = firstLevelSize + levelGrowth * (level - 1);
+        startLevel(world);
+        for (int i = 0; i < world.width * 4; ++i) {
+            world.enemy.move(world, world.gameRng);
+        }
+
+        saveWorld(world, fullFile, SaveMode::FullGrid);
+        saveWorld(world, seedFile, SaveMode::SeedDelta);
+        std::vector<char> full, seed;
+        serializeWorld(world, full, SaveMode::FullGrid);
+        serializeWorld(world, seed, SaveMode::SeedDelta);
+
+        World loaded;
+        double fullLoad = timeLoads([&] { loadWorld(loaded, fullFile); });
+        double seedLoad = timeLoads([&] { loadWorld(loaded, seedFile); });
+
+        out << std::setw(7) << level << std::setw(11) << (std::to_string(world.width) + "x" + std::to_string(world.height))
+            << std::setw(12) << full.size() << std::setw(12) << seed.size()
+            << std::setw(14) << std::fixed << std::setprecision(1) << fullLoad
+            << std::setw(14) << seedLoad << '\n';
+    }
+
+    std::remove(fullFile);
+    std::remove(seedFile);
+}
+
+void runCompressionBenchmark(std::ostream& out) {
+    const int levels[] = { 1, 5, 10, 25, 50, 100, 250 };
+
+    out << std::left << std::setw(7) << "level" << std::setw(11) << "maze"
+        << std::setw(12) << "raw bytes" << std::setw(12) << "packed" << std::setw(8) << "ratio"
+        << std::setw(14) << "encode MB/s" << std::setw(14) << "decode MB/s" << '\n';
+
+    for (int level : levels) {
+        World world;
+        world.seed = 12345;
+        world.level = level;
+        world.width = world.height = firstLevelSize + levelGrowth * (level - 1);
+        startLevel(world);
+
+        std::size_t cells = world.maze.size();
+        std::vector<char> packed;
+        std::vector<char> decoded(cells);
+        compressGrid(world.maze.data(), cells, '#', ' ', packed);
+
+        double encodeUs = timeLoads([&] {
+            packed.clear();
+            compressGrid(world.maze.data(), cells, '#', ' ', packed);
+        });
+        double decodeUs = timeLoads([&] { decompressGrid(packed.data(), packed.size(), decoded.data(), cells, '#', ' '); });
+
+        // One byte per cell, so cells per microsecond is MB/s
+        out << std::setw(7) << level << std::setw(11) << (std::to_string(world.width) + "x" + std::to_string(world.height))
+            << std::setw(12) << cells << std::setw(12) << packed.size()
+            << std::setw(8) << std::fixed << std::setprecision(1) << static_cast<double>(cells) / packed.size()
+            << std::setw(14) << cells / encodeUs
+            << std::setw(14) << cells / decodeUs << '\n';
+    }
+}
+
+bool runReplayBenchmark(std::ostream& out, const std::string& filename, int repeats) {
+    std::vector<char> replay;
+    if (!readReplayFile(filename, replay)) {
+        out << "Unable to read replay " << filename << '\n';
+        return false;
+    }
+
+    out << std::left << std::setw(5) << "run" << std::setw(10) << "ticks" << std::setw(8) << "levels"
+        << std::setw(12) << "sim s" << std::setw(12) << "wall ms" << std::setw(12) << "speedup"
+        << std::setw(12) << "ticks/s" << "final state" << '\n';
+
+    bool allMatched = true;
+    for (int run = 1; run <= repeats; ++run) {
+        World world;
+        world.showMessages = false;
+        ReplayStats stats;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = runReplay(world, replay.data(), replay.size(), stats);
+        double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double simSeconds = stats.ticks * static_cast<double>(tickSeconds);
+        allMatched = allMatched && ok && stats.hashMatched;
+
+        out << std::setw(5) << run << std::setw(10) << stats.ticks << std::setw(8) << stats.levelsCompleted
+            << std::setw(12) << std::fixed << std::setprecision(1) << simSeconds
+            << std::setw(12) << std::setprecision(2) << wallSeconds * 1000.0
+            << std::setw(12) << std::setprecision(0) << simSeconds / wallSeconds
+            << std::setw(12) << stats.ticks / wallSeconds
+            << (!ok ? "desync" : stats.hashMatched ? "matches" : "differs") << '\n';
+    }
+    return allMatched;
+}
+
+// hashWorld plus the enemy's search, which a rewind also has to put back exactly
+static std::uint64_t rollbackHash(const World& world) {
+    std::uint64_t hash = hashWorld(world);
+    auto mix = [&hash](const void* data, std::size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    mix(world.enemy.visited.data(), world.enemy.visited.size() * sizeof(bool));
+    mix(world.enemy.backtrackStack.begin(), world.enemy.backtrackStack.size() * sizeof(std::pair<int, int>));
+    return hash;
+}
+
+bool runRollbackBenchmark(std::ostream& out) {
+    const int levels[] = { 1, 25, 100 };
+    const std::uint32_t depths[] = { 1, 60, 239 };
+
+    out << std::left << std::setw(7) << "level" << std::setw(11) << "maze" << std::setw(14) << "capture ns";
+    for (std::uint32_t depth : depths) {
+        out << std::setw(16) << ("rewind " + std::to_string(depth) + " us");
+    }
+    out << "rewinds exact" << '\n';
+
+    bool allExact = true;
+    for (int level : levels) {
+        World world;
+        world.seed = 12345;
+        world.level = level;
+        world.width = world.height = firstLevelSize + levelGrowth * (level - 1);
+        world.showMessages = false;
+        world.answerPuzzle = [](const AdditionQuestion& question) { return question.correctAnswer; };
+        startLevel(world);
+
+        // A wandering player; the time limit is lifted so the run never ends.
+        // firstState, if given, gets the hash of the state the first tick captures.
+        RollbackBuffer rollback(4 * ticksPerSecond);
+        Rng input(level);
+        auto play = [&](std::uint32_t ticks, std::uint64_t* firstState = nullptr) {
+            for (std::uint32_t i = 0; i < ticks; ++i) {
+                world.timeLimit = levelTimeLimit + elapsedLevelTime(world);
+                char move = "WASD"[input.below(4)];
+                if (i == 0 && firstState) {
+                    *firstState = rollbackHash(world);
+                }
+                rollback.capture(world);
+                stepWorld(world, &move, 1);
+            }
+        };
+
+        play(static_cast<std::uint32_t>(rollback.capacity()));
+        double captureNs = timeLoads([&] { rollback.capture(world); }) * 1000.0;
+        play(static_cast<std::uint32_t>(rollback.capacity()));
+
+        out << std::setw(7) << level << std::setw(11) << (std::to_string(world.width) + "x" + std::to_string(world.height))
+            << std::setw(14) << std::fixed << std::setprecision(1) << captureNs;
+        int exact = 0;
+        int checked = 0;
+        for (std::uint32_t depth : depths) {
+            // Play depth ticks, then rewind them all, so every rewind sees a full window
+            // and lands on a state this run simulated and hashed on the way
+            double totalUs = 0.0;
+            int rewinds = 0;
+            for (; rewinds < 200; ++rewinds) {
+                std::uint64_t reference = 0;
+                play(depth, &reference);
+                auto start = std::chrono::steady_clock::now();
+                bool rewound = rollback.rewind(world, rollback.newestTick() - depth + 1);
+                totalUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                exact += rewound && rollbackHash(world) == reference ? 1 : 0;
+                ++checked;
+            }
+            out << std::setw(16) << std::setprecision(3) << totalUs / rewinds;
+        }
+        out << exact << "/" << checked << '\n';
+        allExact = allExact && exact == checked;
+    }
+    if (!allExact) {
+        out << "A rewind did not restore the state it was rewound to\n";
+    }
+    return allExact;
+}
+
+bool runRaceBenchmark(std::ostream& out, int clients, int seconds, std::uint32_t lagMs, int mazeSize) {
+    const int udpHeaderBytes = 28; // IPv4 and UDP headers on every datagram
+    clients = std::max(1, std::min(clients, maxRacers - 1));
+
+    World hostWorld;
+    hostWorld.seed = 12345;
+    hostWorld.width = hostWorld.height = std::max(5, mazeSize);
+    hostWorld.showMessages = false;
+    startLevel(hostWorld);
+    RaceHost host(hostWorld, clients + 1);
+    if (!host.listen(0)) {
+        out << "Unable to open a UDP socket" << std::endl;
+        return false;
+    }
+
+    std::vector<std::unique_ptr<World>> worlds;
+    std::vector<std::unique_ptr<RaceClient>> racers;
+    for (int i = 0; i < clients; ++i) {
+        worlds.emplace_back(new World());
+        racers.emplace_back(new RaceClient(*worlds.back()));
+        if (!racers.back()->connect(sf::IpAddress::LocalHost, host.port())) {
+            out << "Unable to open a UDP socket" << std::endl;
+            return false;
+        }
+        racers.back()->setLag(lagMs);
+    }
+
+    // Every client takes a bot step every few ticks, the way a player
+    // holding keys down would. The host's own racer stands still.
+    Rng input(1);
+    std::vector<std::vector<std::uint32_t>> toExit(clients);
+    std::uint32_t maxTicks = static_cast<std::uint32_t>(raceCountdownTicks + seconds * ticksPerSecond);
+    std::uint32_t ticks = 0;
+    double hostUs = 0.0;
+    for (; ticks < maxTicks && !host.over(); ++ticks) {
+        for (int i = 0; i < clients; ++i) {
+            char move = 0;
+            if (racers[i]->started() && ticks % 4 == static_cast<std::uint32_t>(i % 4)) {
+                move = botMove(*worlds[i], toExit[i], input);
+            }
+            racers[i]->tick(&move, move ? 1 : 0);
+        }
+        auto start = std::chrono::steady_clock::now();
+        host.tick(nullptr, 0);
+        hostUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // For scale: a snapshot with every racer in full, as if nothing were left out
+    WireBuffer full;
+    full.putUint8(static_cast<std::uint8_t>(RaceMessage::Snapshot));
+    full.emplace<SnapshotHeader>();
+    full.putUint8(static_cast<std::uint8_t>(host.racers().size()));
+    for (const RacerState& racer : host.racers()) {
+        writeRacerFields(full, RacerState(), racer);
+    }
+
+    out << clients << " clients on loopback with " << lagMs << " ms lag on a " << mazeSize << " cell maze, " << std::fixed << std::setprecision(1) << ticks * tickSeconds
+        << " s including the " << raceCountdownTicks / ticksPerSecond << " s countdown" << (host.over() ? ", race over" : "") << '\n';
+    out << std::left << std::setw(8) << "client" << std::setw(12) << "down B/s" << std::setw(12) << "wire B/s"
+        << std::setw(10) << "up B/s" << std::setw(11) << "snapshots" << std::setw(14) << "avg snapshot"
+        << std::setw(14) << "corrections" << std::setw(9) << "largest" << "status" << '\n';
+    bool allConnected = true;
+    for (int i = 0; i < clients; ++i) {
+        const RaceClient& racer = *racers[i];
+        const TrafficStats& traffic = racer.traffic();
+        double connected = racer.ticksConnected() * static_cast<double>(tickSeconds);
+        const char* status = !racer.welcomed() ? "not joined"
+            : racer.id() >= static_cast<int>(racer.racers().size()) ? "no snapshot"
+            : racer.racers()[racer.id()].status == RacerStatus::Racing ? "racing"
+            : racer.racers()[racer.id()].status == RacerStatus::Finished ? "finished" : "out";
+        allConnected = allConnected && racer.snapshotsReceived() > 0;
+        out << std::setw(8) << racer.id() << std::fixed << std::setprecision(0)
+            << std::setw(12) << traffic.bytesReceived / connected
+            << std::setw(12) << (traffic.bytesReceived + udpHeaderBytes * traffic.packetsReceived) / connected
+            << std::setw(10) << traffic.bytesSent / connected
+            << std::setw(11) << racer.snapshotsReceived()
+            << std::setw(14) << std::setprecision(1)
+            << static_cast<double>(traffic.bytesReceived) / std::max<std::uint32_t>(1, racer.snapshotsReceived())
+            << std::setw(14) << racer.prediction().corrections << std::setw(9) << racer.prediction().largestCorrection
+            << status << '\n';
+    }
+    out << "Every racer in full: " << full.size() << " bytes" << '\n';
+    out << "Host: " << std::setprecision(2) << hostUs / ticks << " us per tick, "
+        << std::setprecision(0) << host.traffic().bytesSent / (ticks * static_cast<double>(tickSeconds)) << " B/s sent in total" << '\n';
+    return allConnected;
+}
+
+bool runLockstepBenchmark(std::ostream& out, int peers, int seconds) {
+    const int mazeSizes[] = { firstLevelSize, 101, 401 };
+    peers = std::max(2, std::min(peers, maxRacers));
+
+    out << peers << " peers on loopback, up to " << seconds << " s a race; client traffic is per client" << '\n';
+    out << std::left << std::setw(7) << "maze" << std::setw(8) << "ticks" << std::setw(10) << "up B/s"
+        << std::setw(12) << "down B/s" << std::setw(14) << "host out B/s" << std::setw(8) << "stalls"
+        << std::setw(9) << "hashes" << "state" << '\n';
+    bool allInStep = true;
+    for (int size : mazeSizes) {
+        std::vector<std::unique_ptr<World>> worlds;
+        std::vector<std::unique_ptr<LockstepPeer>> session;
+        for (int i = 0; i < peers; ++i) {
+            worlds.emplace_back(new World());
+            worlds.back()->showMessages = false;
+            session.emplace_back(new LockstepPeer(*worlds.back()));
+        }
+        worlds[0]->seed = 12345;
+        worlds[0]->width = worlds[0]->height = size;
+        startLevel(*worlds[0]);
+        if (!session[0]->host(0, peers)) {
+            out << "Unable to open a UDP socket" << std::endl;
+            return false;
+        }
+        for (int i = 1; i < peers; ++i) {
+            if (!session[i]->join(sf::IpAddress::LocalHost, session[0]->port())) {
+                out << "Unable to open a UDP socket" << std::endl;
+                return false;
+            }
+        }
+
+        // Every peer, the host included, is a bot
+        Rng input(1);
+        std::vector<std::vector<std::uint32_t>> toExit(peers);
+        std::uint32_t maxTicks = static_cast<std::uint32_t>(seconds * ticksPerSecond);
+        std::uint32_t ticks = 0;
+        for (; ticks < maxTicks && !session[0]->over(); ++ticks) {
+            for (int i = 0; i < peers; ++i) {
+                char move = 0;
+                if (session[i]->started() && ticks % 4 == static_cast<std::uint32_t>(i % 4)) {
+                    move = botMove(*worlds[i], toExit[i], input);
+                }
+                session[i]->tick(&move, move ? 1 : 0);
+            }
+        }
+
+        double up = 0.0, down = 0.0;
+        std::uint32_t stalls = 0, hashes = 0;
+        bool inStep = true;
+        for (int i = 0; i < peers; ++i) {
+            const LockstepPeer& peer = *session[i];
+            double connected = std::max<std::uint32_t>(1, peer.ticksConnected()) * static_cast<double>(tickSeconds);
+            if (i > 0) {
+                up += peer.traffic().bytesSent / connected / (peers - 1);
+                down += peer.traffic().bytesReceived / connected / (peers - 1);
+            }
+            stalls = std::max(stalls, peer.stalledTicks());
+            hashes += peer.hashesCompared();
+            inStep = inStep && peer.started() && !peer.desynced();
+        }
+        allInStep = allInStep && inStep;
+        out << std::setw(7) << size << std::setw(8) << ticks << std::fixed << std::setprecision(0) << std::setw(10) << up
+            << std::setw(12) << down
+            << std::setw(14) << session[0]->traffic().bytesSent / (std::max<std::uint32_t>(1, ticks) * static_cast<double>(tickSeconds))
+            << std::setw(8) << stalls << std::setw(9) << hashes
+            << (inStep ? (session[0]->over() ? "in step, race over" : "in step") : "DESYNC") << '\n';
+    }
+    return allInStep;
+}
+
+// What one race under emulated conditions came to, summed over its clients
+struct NetcodeRun {
+    double seconds = 0.0;
+    std::uint64_t snapshots = 0;
+    std::uint64_t skipped = 0;
+    std::uint64_t reconciliations = 0;
+    std::uint64_t corrections = 0;
+    std::uint64_t correctedCells = 0;
+    std::uint32_t largest = 0;
+    std::uint64_t bytesReceived = 0;
+    bool allJoined = true;
+};
+
+static bool runNetcodeRace(const NetworkConditions& conditions, std::uint64_t seed, int clients, int seconds, NetcodeRun& run) {
+    World hostWorld;
+    hostWorld.seed = 12345;
+    hostWorld.width = hostWorld.height = firstLevelSize;
+    hostWorld.showMessages = false;
+    startLevel(hostWorld);
+    RaceHost host(hostWorld, clients + 1);
+    if (!host.listen(0)) {
+        return false;
+    }
+    std::vector<std::unique_ptr<World>> worlds;
+    std::vector<std::unique_ptr<RaceClient>> racers;
+    for (int i = 0; i < clients; ++i) {
+        worlds.emplace_back(new World());
+        racers.emplace_back(new RaceClient(*worlds.back()));
+        if (!racers.back()->connect(sf::IpAddress::LocalHost, host.port())) {
+            return false;
+        }
+        racers.back()->setNetworkConditions(conditions, conditions, seed + i);
+    }
+
+    Rng input(seed);
+    std::vector<std::vector<std::uint32_t>> toExit(clients);
+    std::uint32_t maxTicks = static_cast<std::uint32_t>(raceCountdownTicks + seconds * ticksPerSecond);
+    std::uint32_t ticks = 0;
+    for (; ticks < maxTicks && !host.over(); ++ticks) {
+        for (int i = 0; i < clients; ++i) {
+            char move = 0;
+            if (racers[i]->started() && ticks % 4 == static_cast<std::uint32_t>(i % 4)) {
+                move = botMove(*worlds[i], toExit[i], input);
+            }
+            racers[i]->tick(&move, move ? 1 : 0);
+        }
+        host.tick(nullptr, 0);
+    }
+
+    run.seconds = ticks * static_cast<double>(tickSeconds);
+    for (const std::unique_ptr<RaceClient>& racer : racers) {
+        const PredictionStats& prediction = racer->prediction();
+        run.snapshots += racer->snapshotsReceived();
+        run.skipped += racer->snapshotsSkipped();
+        run.reconciliations += prediction.reconciliations;
+        run.corrections += prediction.corrections;
+        run.correctedCells += prediction.correctedCells;
+        run.largest = std::max(run.largest, prediction.largestCorrection);
+        run.bytesReceived += racer->traffic().bytesReceived;
+        run.allJoined = run.allJoined && racer->snapshotsReceived() > 0;
+    }
+    return true;
+}
+
+// Lockstep peers on a first level maze, the clients behind the conditions
+static bool runNetcodeLockstep(const NetworkConditions& conditions, std::uint64_t seed, int peers, int seconds,
+    std::uint32_t& ticks, std::uint32_t& stalls, bool& inStep) {
+    std::vector<std::unique_ptr<World>> worlds;
+    std::vector<std::unique_ptr<LockstepPeer>> session;
+    for (int i = 0; i < peers; ++i) {
+        worlds.emplace_back(new World());
+        worlds.back()->showMessages = false;
+        session.emplace_back(new LockstepPeer(*worlds.back()));
+    }
+    worlds[0]->seed = 12345;
+    worlds[0]->width = worlds[0]->height = firstLevelSize;
+    startLevel(*worlds[0]);
+    if (!session[0]->host(0, peers)) {
+        return false;
+    }
+    for (int i = 1; i < peers; ++i) {
+        if (!session[i]->join(sf::IpAddress::LocalHost, session[0]->port())) {
+            return false;
+        }
+        session[i]->setNetworkConditions(conditions, conditions, seed + i);
+    }
+
+    Rng input(seed);
+    std::vector<std::vector<std::uint32_t>> toExit(peers);
+    std::uint32_t maxTicks = static_cast<std::uint32_t>(seconds * ticksPerSecond);
+    for (ticks = 0; ticks < maxTicks && !session[0]->over(); ++ticks) {
+        for (int i = 0; i < peers; ++i) {
+            char move = 0;
+            if (session[i]->started() && ticks % 4 == static_cast<std::uint32_t>(i % 4)) {
+                move = botMove(*worlds[i], toExit[i], input);
+            }
+            session[i]->tick(&move, move ? 1 : 0);
+        }
+    }
+
+    stalls = 0;
+    inStep = true;
+    for (const std::unique_ptr<LockstepPeer>& peer : session) {
+        stalls = std::max(stalls, peer->stalledTicks());
+        inStep = inStep && peer->started() && !peer->desynced();
+    }
+    return true;
+}
+
+bool runNetcodeBenchmark(std::ostream& out, int clients, int seconds, std::uint64_t seed) {
+    clients = std::max(1, std::min(clients, maxRacers - 1));
+    std::vector<NetworkProfile> profiles(1, NetworkProfile{ "none", NetworkConditions() });
+    profiles.insert(profiles.end(), networkProfiles().begin(), networkProfiles().end());
+
+    out << clients << " clients on loopback behind each profile both ways, up to " << seconds << " s a race, seed " << seed << '\n';
+    out << std::left << std::setw(11) << "profile" << std::setw(10) << "snaps/s" << std::setw(8) << "lost %"
+        << std::setw(12) << "down B/s" << std::setw(14) << "corrected %" << std::setw(11) << "avg cells"
+        << std::setw(9) << "largest" << std::setw(16) << "lockstep ticks" << std::setw(10) << "stalls %" << "state" << '\n';
+    bool allWorked = true;
+    for (const NetworkProfile& profile : profiles) {
+        NetcodeRun race;
+        std::uint32_t ticks = 0, stalls = 0;
+        bool inStep = false;
+        if (!runNetcodeRace(profile.conditions, seed, clients, seconds, race)
+            || !runNetcodeLockstep(profile.conditions, seed, clients + 1, seconds, ticks, stalls, inStep)) {
+            out << "Unable to open a UDP socket" << std::endl;
+            return false;
+        }
+        allWorked = allWorked && race.allJoined && inStep;
+        double clientSeconds = std::max(tickSeconds, static_cast<float>(race.seconds)) * static_cast<double>(clients);
+        out << std::setw(11) << profile.name << std::fixed << std::setprecision(1)
+            << std::setw(10) << race.snapshots / clientSeconds
+            << std::setw(8) << std::setprecision(2) << 100.0 * race.skipped / std::max<std::uint64_t>(1, race.snapshots + race.skipped)
+            << std::setw(12) << std::setprecision(0) << race.bytesReceived / clientSeconds
+            << std::setw(14) << std::setprecision(2) << 100.0 * race.corrections / std::max<std::uint64_t>(1, race.reconciliations)
+            << std::setw(11) << static_cast<double>(race.correctedCells) / std::max<std::uint64_t>(1, race.corrections)
+            << std::setw(9) << race.largest << std::setw(16) << ticks
+            << std::setw(10) << std::setprecision(1) << 100.0 * stalls / std::max<std::uint32_t>(1, ticks)
+            << (!race.allJoined ? "NO SNAPSHOTS" : !inStep ? "DESYNC OR NO START" : "ok") << '\n';
+    }
+    return allWorked;
+}
+
+bool runSpectatorBenchmark(std::ostream& out, int maxSpectators, int spectatorsPerStep, int seconds) {
+    using Clock = std::chrono::steady_clock;
+    maxSpectators = std::max(1, maxSpectators);
+    spectatorsPerStep = std::max(1, std::min(spectatorsPerStep, maxSpectators));
+
+    SpectatorBroadcaster broadcaster(maxSpectators);
+    if (!broadcaster.listen(0)) {
+        out << "Unable to open a UDP socket" << std::endl;
+        return false;
+    }
+
+    // The game being watched, played by a bot; a new level whenever it
+    // finishes or loses one, which every spectator is then sent in full
+    World game;
+    game.seed = 12345;
+    game.showMessages = false;
+    game.answerPuzzle = openPurpleBlock;
+    startLevel(game);
+    std::vector<std::uint32_t> toExit;
+    Rng input(1);
+
+    std::vector<std::unique_ptr<World>> worlds;
+    std::vector<std::unique_ptr<SpectatorClient>> spectators;
+
+    out << "Spectators on loopback, one thread, " << seconds << " s of game a step; broadcast costs are for the game's side" << '\n';
+    out << std::left << std::setw(12) << "spectators" << std::setw(10) << "in sync" << std::setw(12) << "tick us"
+        << std::setw(8) << "p99" << std::setw(8) << "core %" << std::setw(15) << "per core est" << std::setw(13) << "sends/s"
+        << std::setw(10) << "B/tick" << std::setw(13) << "built/tick" << std::setw(9) << "levels" << std::setw(10) << "restarts"
+        << "allocs/tick" << '\n';
+    bool allInSync = true;
+    for (int count = spectatorsPerStep;; count = std::min(maxSpectators, count + spectatorsPerStep)) {
+        // Spectators join a hundred a tick, as thousands at once would overflow
+        // the game's receive buffer, then everyone gets a second to settle
+        for (int settle = ticksPerSecond; settle > 0;) {
+            for (int joined = 0; joined < 100 && static_cast<int>(spectators.size()) < count; ++joined) {
+                worlds.emplace_back(new World());
+                spectators.emplace_back(new SpectatorClient(*worlds.back()));
+                if (!spectators.back()->connect(sf::IpAddress::LocalHost, broadcaster.port())) {
+                    out << "Unable to open a UDP socket for spectator " << spectators.size() << std::endl;
+                    return false;
+                }
+            }
+            broadcaster.tick(game);
+            for (std::unique_ptr<SpectatorClient>& spectator : spectators) {
+                spectator->tick();
+            }
+            if (static_cast<int>(spectators.size()) == count) {
+                --settle;
+            }
+        }
+
+        BroadcastStats before = broadcaster.stats();
+        std::uint32_t restartsBefore = 0;
+        for (std::unique_ptr<SpectatorClient>& spectator : spectators) {
+            restartsBefore += spectator->restarts();
+        }
+        Histogram tickNs;
+        std::uint64_t allocations = 0;
+        std::uint32_t ticks = static_cast<std::uint32_t>(seconds * ticksPerSecond);
+        for (std::uint32_t i = 0; i < ticks; ++i) {
+            char move = i % 4 == 0 ? botMove(game, toExit, input) : 0;
+            TickResult result = stepWorld(game, &move, move ? 1 : 0);
+            if (result == TickResult::ExitReached) {
+                advanceLevel(game);
+                toExit.clear();
+            }
+            else if (result != TickResult::Playing) {
+                startLevel(game);
+                toExit.clear();
+            }
+
+            std::uint64_t allocationsBefore = allocationCount();
+            Clock::time_point start = Clock::now();
+            broadcaster.tick(game);
+            tickNs.record(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+            allocations += allocationCount() - allocationsBefore;
+
+            for (std::unique_ptr<SpectatorClient>& spectator : spectators) {
+                spectator->tick();
+            }
+        }
+
+        // A spectator in sync has every tick so far and the game's player where the game has it
+        const BroadcastStats& after = broadcaster.stats();
+        int inSync = 0;
+        std::uint32_t restarts = 0;
+        for (std::unique_ptr<SpectatorClient>& spectator : spectators) {
+            restarts += spectator->restarts();
+            inSync += spectator->watching() && spectator->player().x == game.playerX && spectator->player().y == game.playerY
+                && spectator->player().enemyX == game.enemy.x && spectator->player().enemyY == game.enemy.y ? 1 : 0;
+        }
+        allInSync = allInSync && inSync == count;
+
+        double tickUs = tickNs.mean() / 1000.0;
+        double gameSeconds = ticks * static_cast<double>(tickSeconds);
+        std::uint64_t sent = after.datagramsSent - before.datagramsSent;
+        char line[192];
+        std::snprintf(line, sizeof(line), "%-12d%-10d%-12.1f%-8.1f%-8.2f%-15.0f%-13.0f%-10.1f%-13.2f%-9llu%-10u%.2f",
+            count, inSync, tickUs, tickNs.percentile(0.99) / 1000.0, 100.0 * tickUs / (1e6 * tickSeconds),
+            count * 1e6 * tickSeconds / std::max(0.001, tickUs), sent / gameSeconds,
+            static_cast<double>(after.bytesSent - before.bytesSent) / std::max<std::uint64_t>(1, sent),
+            static_cast<double>(after.serialized - before.serialized) / ticks,
+            static_cast<unsigned long long>(after.levelsSent - before.levelsSent), restarts - restartsBefore,
+            static_cast<double>(allocations) / ticks);
+        out << line << std::endl;
+
+        if (count >= maxSpectators) {
+            break;
+        }
+    }
+
+    for (std::unique_ptr<SpectatorClient>& spectator : spectators) {
+        spectator->leave();
+    }
+    broadcaster.finish();
+    return allInSync;
+}
+
+namespace {
+    const int memoryTagCount = static_cast<int>(MemoryTag::Count);
+    const std::uint32_t soakTicksPerLevel = 600;
+
+    struct MemorySnapshot {
+        std::int64_t liveBytes[memoryTagCount];
+    };
+
+    MemorySnapshot takeMemorySnapshot() {
+        MemorySnapshot snapshot;
+        for (int tag = 0; tag < memoryTagCount; ++tag) {
+            snapshot.liveBytes[tag] = memoryTagStats(static_cast<MemoryTag>(tag)).liveBytes;
+        }
+        return snapshot;
+    }
+
+    // What one level change costs in the game: a fresh level, some play by
+    // a bot, a save round trip and the HUD timer
+    struct SoakGame {
+        World world;
+        World loaded;
+        std::vector<std::uint32_t> toExit;
+        std::vector<char> save;
+        Rng input{ 7 };
+        std::uint64_t levelAllocations = 0; // Heap allocations made by the last level change
+
+        SoakGame() {
+            world.showMessages = false;
+            world.answerPuzzle = [](const AdditionQuestion& question) { return question.correctAnswer; };
+            loaded.showMessages = false;
+        }
+
+        void restart() {
+            world.seed = 12345;
+            world.level = 1;
+            world.width = world.height = firstLevelSize;
+            startLevel(world);
+            play();
+        }
+
+        void advance() {
+            std::uint64_t before = allocationCount();
+            advanceLevel(world);
+            levelAllocations = allocationCount() - before;
+            play();
+        }
+
+        void play() {
+            toExit.clear();
+            for (std::uint32_t tick = 0; tick < soakTicksPerLevel; ++tick) {
+                world.timeLimit = levelTimeLimit + elapsedLevelTime(world);
+                char move = tick % 4 == 0 ? botMove(world, toExit, input) : 0;
+                if (stepWorld(world, &move, move ? 1 : 0) != TickResult::Playing) {
+                    break;
+                }
+            }
+            serializeWorld(world, save, SaveMode::FullGrid);
+            deserializeWorld(loaded, save.data(), save.size());
+            timerString(remainingTime(world));
+        }
+    };
+}
+
+bool runMemorySoak(std::ostream& out, int levels, int repeats) {
+    levels = std::max(1, levels);
+    SoakGame game;
+
+    out << std::left << std::setw(10) << "level" << std::setw(11) << "maze";
+    for (int tag = 0; tag < memoryTagCount; ++tag) {
+        out << std::setw(14) << (std::string(memoryTagName(static_cast<MemoryTag>(tag))) + " KB");
+    }
+    out << std::setw(13) << "maze B/cell" << std::setw(14) << "level allocs" << "arena used/reserved" << '\n';
+    auto row = [&](const std::string& label) {
+        MemorySnapshot snapshot = takeMemorySnapshot();
+        std::int64_t cells = static_cast<std::int64_t>(game.world.width) * game.world.height;
+        out << std::setw(10) << label << std::setw(11)
+            << (std::to_string(game.world.width) + "x" + std::to_string(game.world.height));
+        for (int tag = 0; tag < memoryTagCount; ++tag) {
+            out << std::setw(14) << std::fixed << std::setprecision(1) << snapshot.liveBytes[tag] / 1024.0;
+        }
+        out << std::setw(13) << std::setprecision(2) << snapshot.liveBytes[static_cast<int>(MemoryTag::Maze)] / static_cast<double>(cells)
+            << std::setw(14) << game.levelAllocations << game.world.arena.bytesUsed() << "/" << game.world.arena.bytesReserved() << '\n';
+    };
+
+    game.restart();
+    for (int level = 1; level < levels; ++level) {
+        game.advance();
+        if (level % 10 == 9 || level == levels - 1) {
+            row(std::to_string(game.world.level));
+        }
+    }
+    MemorySnapshot climbed = takeMemorySnapshot();
+
+    // The same levels again: everything they need is already there
+    bool steady = true;
+    for (int repeat = 1; repeat <= repeats; ++repeat) {
+        game.restart();
+        for (int level = 1; level < levels; ++level) {
+            game.advance();
+        }
+        row("again " + std::to_string(repeat));
+        MemorySnapshot now = takeMemorySnapshot();
+        for (int tag = 0; tag < memoryTagCount; ++tag) {
+            if (now.liveBytes[tag] > climbed.liveBytes[tag]) {
+                out << "  " << memoryTagName(static_cast<MemoryTag>(tag)) << " grew by "
+                    << now.liveBytes[tag] - climbed.liveBytes[tag] << " bytes\n";
+                steady = false;
+            }
+        }
+    }
+    out << (steady ? "No tag grew after the first climb\n" : "Memory grew across level changes\n");
+    return steady;
+}
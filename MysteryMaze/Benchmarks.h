@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "World.h"
+
+// Compare save size and load time of full-grid and seed-plus-delta saves at several levels
+void runSaveBenchmark(std::ostream& out);
+
+// Compression ratio and encode / decode throughput of the maze grid codec at several levels
+void runCompressionBenchmark(std::ostream& out);
+
+// Cost of capturing a tick into the rollback buffer and of rewinding it at
+// several depths. Every rewind is checked against the state it should land
+// on, hashed as it was first simulated; returns false if any differ.
+bool runRollbackBenchmark(std::ostream& out);
+
+// Replay a recorded game headlessly, repeats times, and report simulation speed.
+// Returns false if the replay fails or no longer ends in the recorded state.
+bool runReplayBenchmark(std::ostream& out, const std::string& filename, int repeats);
+
+// Host a race on loopback between clients bot players on a mazeSize maze,
+// for up to seconds of simulated time, and report the bandwidth each client
+// used and how often its prediction was corrected, with lagMs of emulated
+// round trip. Returns false if a client never got a snapshot.
+bool runRaceBenchmark(std::ostream& out, int clients, int seconds, std::uint32_t lagMs = 0, int mazeSize = firstLevelSize);
+
+// Lockstep races between peers bot players on loopback, for up to seconds
+// each, on growing mazes, to show the traffic does not grow with the maze.
+// Returns false if any peer failed to start or fell out of step.
+bool runLockstepBenchmark(std::ostream& out, int peers, int seconds);
+
+// Race and lockstep netcode behind each network profile, with every client's
+// link emulated both ways and all drops and delays drawn from seed, so a run
+// can be repeated exactly. Reports snapshot throughput and loss, how often
+// and how far prediction was corrected, and how long lockstep stalled.
+// Returns false if a client never got a snapshot or a lockstep race failed.
+bool runNetcodeBenchmark(std::ostream& out, int clients, int seconds, std::uint64_t seed);
+
+// A bot-played game streamed on loopback to spectatorsPerStep more
+// spectators a step, up to maxSpectators, each step seconds of game long and
+// run as fast as it goes. Reports the broadcaster's time a tick, the share
+// of one core that is at 60 ticks a second and the spectators one core would
+// carry at that rate, and how many spectators ended the step in sync.
+// Returns false if any spectator fell out of sync.
+bool runSpectatorBenchmark(std::ostream& out, int maxSpectators, int spectatorsPerStep, int seconds);
+
+// Plays levels 1 to levels with a bot, saving and loading each one, then
+// starts over from level 1 repeats more times. Reports live heap bytes per
+// memory tag as the maze grows, with the heap allocations the last level
+// change made and the level arena's use, and returns false if any tag holds more
+// after a repeat than it did after the first climb, that is, if anything is
+// left behind by a level change beyond what the biggest level needs.
+bool runMemorySoak(std::ostream& out, int levels, int repeats);
@@ -0,0 +1,148 @@
+#include "FileChecks.h"
+#include "World.h"
+#include "SaveGame.h"
+#include "MazeFile.h"
+#include "Replay.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+    // A seed save of a real level, then resized to width x height with its checksum fixed up
+    std::vector<char> resizedSeedSave(int width, int height) {
+        World world;
+        world.seed = 12345;
+        world.showMessages = false;
+        startLevel(world);
+        std::vector<char> buffer;
+        serializeWorld(world, buffer, SaveMode::SeedDelta);
+
+        SeedSaveRecord record;
+        std::memcpy(&record, buffer.data() + sizeof(SaveHeader), sizeof(record));
+        record.width = width;
+        record.height = height;
+        std::memcpy(buffer.data() + sizeof(SaveHeader), &record, sizeof(record));
+
+        SaveHeader header;
+        std::memcpy(&header, buffer.data(), sizeof(header));
+        header.checksum = crc32(buffer.data() + sizeof(SaveHeader), header.payloadSize);
+        std::memcpy(buffer.data(), &header, sizeof(header));
+        return buffer;
+    }
+
+    bool rejectsSeedSave(int width, int height) {
+        std::vector<char> save = resizedSeedSave(width, height);
+        World world;
+        world.showMessages = false;
+        return !deserializeWorld(world, save.data(), save.size());
+    }
+
+    const char* const checkMazeFilename = "check_maze.mzm";
+
+    // A plain maze file of a real level with its header changed by patch, then loaded
+    template <typename Patch>
+    bool rejectsMazeFile(Patch patch) {
+        World world;
+        world.seed = 12345;
+        world.showMessages = false;
+        startLevel(world);
+        if (!writeMazeFile(world, checkMazeFilename, true)) {
+            return false;
+        }
+        std::vector<char> file;
+        {
+            std::ifstream infile(checkMazeFilename, std::ios::binary);
+            file.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+        }
+        MazeFileHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        patch(header);
+        std::memcpy(file.data(), &header, sizeof(header));
+        {
+            std::ofstream outfile(checkMazeFilename, std::ios::binary | std::ios::trunc);
+            outfile.write(file.data(), static_cast<std::streamsize>(file.size()));
+        }
+
+        World loaded;
+        loaded.showMessages = false;
+        bool rejected = !loadMazeFile(loaded, checkMazeFilename);
+        loaded.mazeMapping.reset(); // Unmapped before the file goes
+        std::remove(checkMazeFilename);
+        return rejected;
+    }
+
+    // A replay whose first event is a snapshot claiming to be 2^40 bytes long
+    std::vector<char> oversizedSnapshotReplay() {
+        ReplayHeader header = { replayMagic, replayFormatVersion, sizeof(ReplayHeader), static_cast<std::uint32_t>(ticksPerSecond) };
+        std::vector<char> replay(sizeof(header));
+        std::memcpy(replay.data(), &header, sizeof(header));
+        replay.push_back(0); // Tick delta
+        replay.push_back(static_cast<char>(ReplayEvent::Snapshot));
+        std::uint64_t size = std::uint64_t(1) << 40;
+        for (; size >= 0x80; size >>= 7) {
+            replay.push_back(static_cast<char>((size & 0x7f) | 0x80));
+        }
+        replay.push_back(static_cast<char>(size));
+        replay.resize(replay.size() + 64, 0);
+        return replay;
+    }
+
+    bool rejectsOversizedSnapshotInMemory() {
+        std::vector<char> replay = oversizedSnapshotReplay();
+        World world;
+        world.showMessages = false;
+        ReplayStats stats;
+        return !runReplay(world, replay.data(), replay.size(), stats);
+    }
+
+    bool rejectsOversizedSnapshotStreamed() {
+        const char* filename = "check_replay.rpl";
+        std::vector<char> replay = oversizedSnapshotReplay();
+        {
+            std::ofstream outfile(filename, std::ios::binary | std::ios::trunc);
+            outfile.write(replay.data(), static_cast<std::streamsize>(replay.size()));
+        }
+        bool rejected;
+        {
+            World world;
+            world.showMessages = false;
+            ReplayReader reader;
+            rejected = !reader.openFile(filename);
+            if (!rejected) {
+                ReplayPlayer player(world, reader);
+                rejected = !player.advance() && player.failed();
+            }
+        }
+        std::remove(filename);
+        return rejected;
+    }
+}
+
+bool runFileChecks(std::ostream& out) {
+    struct Check {
+        const char* name;
+        bool passed;
+    };
+    const Check checks[] = {
+        { "seed save of a 3x3 maze is rejected", rejectsSeedSave(3, 3) },
+        { "seed save of an even-sized maze is rejected", rejectsSeedSave(22, 22) },
+        { "seed save of an odd-sized maze loads", !rejectsSeedSave(25, 25) },
+        // Offsets that wrap past 2^64 when the section size is added
+        { "maze file with a wrapping tile offset is rejected",
+            rejectsMazeFile([](MazeFileHeader& header) { header.tilesOffset = ~static_cast<std::uint64_t>(0) - 100; }) },
+        { "maze file with a wrapping distance offset is rejected",
+            rejectsMazeFile([](MazeFileHeader& header) { header.distancesOffset = ~static_cast<std::uint64_t>(0) - 255; }) },
+        { "maze file as written loads", !rejectsMazeFile([](MazeFileHeader&) {}) },
+        { "replay snapshot longer than the replay is rejected", rejectsOversizedSnapshotInMemory() },
+        { "streamed replay snapshot longer than the file is rejected", rejectsOversizedSnapshotStreamed() },
+    };
+
+    bool allPassed = true;
+    for (const Check& check : checks) {
+        out << (check.passed ? "ok      " : "FAILED  ") << check.name << '\n';
+        allPassed = allPassed && check.passed;
+    }
+    return allPassed;
+}
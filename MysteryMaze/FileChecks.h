@@ -0,0 +1,6 @@
+#pragma once
+#include <ostream>
+
+// Feed the loaders damaged and hostile files that once hung or crashed
+// them, and check each is turned away. Returns false if any is accepted.
+bool runFileChecks(std::ostream& out);
@@ -0,0 +1,24 @@
+#include "Ghost.h"
+#include "AllocationCounter.h"
+
+bool Ghost::open(const std::string& filename) {
+    MemoryTagScope memoryTag(MemoryTag::AI);
+    if (!reader.openFile(filename)) {
+        return false;
+    }
+    world.showMessages = false;
+    player.reset(new ReplayPlayer(world, reader));
+    running = true;
+    return true;
+}
+
+void Ghost::step() {
+    MemoryTagScope memoryTag(MemoryTag::AI);
+    if (!running) {
+        return;
+    }
+    // The ghost stays where its run ended, normally on the exit
+    bool advanced = player->advance();
+    started = started || advanced;
+    running = advanced && player->lastResult() == TickResult::Playing;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "World.h"
+#include "Replay.h"
+
+// The player's best run on a seed, replayed next to the live game in
+// time-attack mode. Its recording is streamed from disk a small chunk at a
+// time and stepped through its own world, so it costs one level's worth of
+// memory however long the run was.
+class Ghost {
+public:
+    bool open(const std::string& filename);
+
+    // Call once per live tick
+    void step();
+
+    bool visible() const { return started; }
+    int x() const { return world.playerX; }
+    int y() const { return world.playerY; }
+
+private:
+    World world;
+    ReplayReader reader;
+    std::unique_ptr<ReplayPlayer> player;
+    bool started = false;
+    bool running = false;
+};
@@ -0,0 +1,131 @@
+#include "GridCodec.h"
+#include <cstdint>
+#include <cstring>
+
+static void appendU32(std::vector<char>& out, std::uint32_t value) {
+    char bytes[4];
+    std::memcpy(bytes, &value, 4);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+static std::uint32_t readU32(const char* data) {
+    std::uint32_t value;
+    std::memcpy(&value, data, 4);
+    return value;
+}
+
+std::size_t compressGrid(const char* cells, std::size_t count, char background, char foreground, std::vector<char>& out) {
+    std::size_t start = out.size();
+
+    // Exceptions first, so the decoder can patch them in after expanding the bit plane
+    std::size_t countOffset = out.size();
+    appendU32(out, 0);
+    std::uint32_t exceptions = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (cells[i] != background && cells[i] != foreground) {
+            appendU32(out, static_cast<std::uint32_t>(i));
+            out.push_back(cells[i]);
+            ++exceptions;
+        }
+    }
+    std::memcpy(out.data() + countOffset, &exceptions, 4);
+
+    // Pack one bit per cell, into scratch kept per thread so repeated saves
+    // (the autosaver's included) do not allocate once it has grown
+    std::size_t planeBytes = (count + 7) / 8;
+    static thread_local std::vector<unsigned char> plane;
+    plane.assign(planeBytes, 0);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (cells[i] != background) {
+            plane[i >> 3] |= static_cast<unsigned char>(1u << (i & 7));
+        }
+    }
+
+    // PackBits: control n in [0, 127] copies n + 1 literal bytes,
+    // n in [-127, -1] repeats the next byte 1 - n times
+    std::size_t i = 0;
+    while (i < planeBytes) {
+        std::size_t run = 1;
+        while (i + run < planeBytes && run < 128 && plane[i + run] == plane[i]) {
+            ++run;
+        }
+        if (run >= 3) {
+            out.push_back(static_cast<char>(1 - static_cast<int>(run)));
+            out.push_back(static_cast<char>(plane[i]));
+            i += run;
+            continue;
+        }
+
+        // Gather literals until the next run of three or more
+        std::size_t literalStart = i;
+        while (i < planeBytes && i - literalStart < 128) {
+            if (i + 2 < planeBytes && plane[i] == plane[i + 1] && plane[i] == plane[i + 2]) {
+                break;
+            }
+            ++i;
+        }
+        out.push_back(static_cast<char>(i - literalStart - 1));
+        out.insert(out.end(), plane.begin() + literalStart, plane.begin() + i);
+    }
+
+    return out.size() - start;
+}
+
+std::size_t decompressGrid(const char* data, std::size_t size, char* cells, std::size_t count, char background, char foreground) {
+    if (size < 4) {
+        return 0;
+    }
+    std::uint32_t exceptions = readU32(data);
+    std::size_t exceptionBytes = static_cast<std::size_t>(exceptions) * 5;
+    if (exceptions > count || size - 4 < exceptionBytes) {
+        return 0;
+    }
+    const char* exceptionData = data + 4;
+    std::size_t pos = 4 + exceptionBytes;
+
+    // Expand the PackBits stream straight into cells, eight cells per plane byte
+    std::size_t planeBytes = (count + 7) / 8;
+    std::size_t written = 0;
+    auto expand = [&](unsigned char bits) {
+        std::size_t first = written * 8;
+        std::size_t last = first + 8 < count ? first + 8 : count;
+        for (std::size_t cell = first; cell < last; ++cell) {
+            cells[cell] = (bits >> (cell - first)) & 1 ? foreground : background;
+        }
+        ++written;
+    };
+    while (written < planeBytes) {
+        if (pos >= size) {
+            return 0;
+        }
+        int control = static_cast<signed char>(data[pos++]);
+        if (control >= 0) {
+            std::size_t literals = static_cast<std::size_t>(control) + 1;
+            if (size - pos < literals || planeBytes - written < literals) {
+                return 0;
+            }
+            for (std::size_t k = 0; k < literals; ++k) {
+                expand(static_cast<unsigned char>(data[pos++]));
+            }
+        }
+        else if (control != -128) {
+            std::size_t repeats = static_cast<std::size_t>(1 - control);
+            if (pos >= size || planeBytes - written < repeats) {
+                return 0;
+            }
+            unsigned char bits = static_cast<unsigned char>(data[pos++]);
+            for (std::size_t k = 0; k < repeats; ++k) {
+                expand(bits);
+            }
+        }
+    }
+
+    for (std::uint32_t e = 0; e < exceptions; ++e) {
+        std::uint32_t index = readU32(exceptionData + e * 5);
+        if (index >= count) {
+            return 0;
+        }
+        cells[index] = exceptionData[e * 5 + 4];
+    }
+    return pos;
+}
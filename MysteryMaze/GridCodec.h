@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Compact encoding for maze-like grids where almost every cell is one of two
+// values (wall / floor, unvisited / visited).
+//
+//   uint32 exception count, then (uint32 index, uint8 value) per cell that is
+//          neither background nor foreground (exit, purple blocks, ...)
+//   PackBits run-length coding of the bit plane, one bit per cell,
+//          set where the cell is not background, row-major, LSB first
+//
+// Appends to out; returns the number of bytes appended.
+std::size_t compressGrid(const char* cells, std::size_t count, char background, char foreground, std::vector<char>& out);
+
+// Decodes exactly count cells. Returns the number of bytes consumed, or 0 if
+// the data is truncated or malformed.
+std::size_t decompressGrid(const char* data, std::size_t size, char* cells, std::size_t count, char background, char foreground);
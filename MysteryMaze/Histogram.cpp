@@ -0,0 +1,69 @@
+#include "Histogram.h"
+#include <algorithm>
+
+static int highestBit(std::uint32_t value) {
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+
+// 32 single-value buckets, then 32 for each power of two from 2^5 to 2^31
+Histogram::Histogram() : counts(subBuckets + (32 - 5) * subBuckets, 0) {}
+
+std::size_t Histogram::bucketOf(std::uint32_t value) {
+    if (value < subBuckets) {
+        return value;
+    }
+    int shift = highestBit(value) - 5;
+    return subBuckets + static_cast<std::size_t>(shift) * subBuckets + ((value >> shift) - subBuckets);
+}
+
+std::uint32_t Histogram::bucketTop(std::size_t bucket) {
+    if (bucket < subBuckets) {
+        return static_cast<std::uint32_t>(bucket);
+    }
+    std::size_t shift = (bucket - subBuckets) / subBuckets;
+    std::uint64_t low = static_cast<std::uint64_t>(subBuckets + (bucket - subBuckets) % subBuckets) << shift;
+    return static_cast<std::uint32_t>(low + (std::uint64_t(1) << shift) - 1);
+}
+
+void Histogram::record(std::uint32_t value) {
+    ++counts[bucketOf(value)];
+    ++total;
+    sum += value;
+    largest = std::max(largest, value);
+}
+
+void Histogram::merge(const Histogram& other) {
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    largest = std::max(largest, other.largest);
+}
+
+void Histogram::clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    sum = 0;
+    largest = 0;
+}
+
+std::uint32_t Histogram::percentile(double fraction) const {
+    if (total == 0) {
+        return 0;
+    }
+    std::uint64_t wanted = static_cast<std::uint64_t>(fraction * total + 0.5);
+    wanted = std::max<std::uint64_t>(1, std::min(wanted, total));
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < counts.size(); ++bucket) {
+        seen += counts[bucket];
+        if (seen >= wanted) {
+            return std::min(bucketTop(bucket), largest);
+        }
+    }
+    return largest;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Counts of values in buckets that widen with the value, for percentiles
+// of timings without keeping every sample. Below 32 each value has its own
+// bucket; above that every power of two is split into 32, so a percentile
+// is within about 3% of the true value. Recording never allocates.
+class Histogram {
+public:
+    Histogram();
+
+    void record(std::uint32_t value);
+    void merge(const Histogram& other);
+    void clear();
+
+    std::uint64_t count() const { return total; }
+    std::uint32_t max() const { return largest; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0.0; }
+
+    // The value at or below which fraction of the samples fall (0.5 for the
+    // median), as the top of its bucket but never above the largest sample
+    std::uint32_t percentile(double fraction) const;
+
+private:
+    static const int subBuckets = 32;
+    static std::size_t bucketOf(std::uint32_t value);
+    static std::uint32_t bucketTop(std::size_t bucket);
+
+    std::vector<std::uint32_t> counts;
+    std::uint64_t total = 0;
+    std::uint64_t sum = 0;
+    std::uint32_t largest = 0;
+};
@@ -0,0 +1,10 @@
+#include "HudText.h"
+#include "AllocationCounter.h"
+
+std::string timerString(float timeLeft) {
+    MemoryTagScope memoryTag(MemoryTag::Text);
+    int minutes = static_cast<int>(timeLeft) / 60;
+    int seconds = static_cast<int>(timeLeft) % 60;
+    return "Time Remaining: " + std::to_string(minutes) + ":" +
+        (seconds < 10 ? "0" : "") + std::to_string(seconds);
+}
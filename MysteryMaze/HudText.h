@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+
+// Text drawn over the maze, built apart from SFML so it can be benchmarked
+// headless. The game hands the strings to its sf::Text objects.
+
+// "Time Remaining: m:ss" for the seconds left on the level timer
+std::string timerString(float timeLeft);
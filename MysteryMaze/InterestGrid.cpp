@@ -0,0 +1,171 @@
+#include "InterestGrid.h"
+#include <cstdlib>
+#include <cstring>
+
+void InterestGrid::reset(int mazeWidth, int mazeHeight) {
+    columns = std::max(1, std::min(maxInterestChunks, (mazeWidth + interestChunkCells - 1) / interestChunkCells));
+    rows = std::max(1, std::min(maxInterestChunks, (mazeHeight + interestChunkCells - 1) / interestChunkCells));
+    std::size_t cells = static_cast<std::size_t>(columns) * rows;
+    chunkAt.assign(cells, -1);
+    previousChunkAt.assign(cells, -1);
+    changedIn.assign(cells, 0);
+    chunks.clear();
+    previousChunks.clear();
+    chunks.reserve(maxRacers);
+    previousChunks.reserve(maxRacers);
+    placed.reserve(maxRacers);
+    fresh = true;
+}
+
+int InterestGrid::chunkOf(int x, int y) const {
+    return std::min(interestChunk(y), rows - 1) * columns + std::min(interestChunk(x), columns - 1);
+}
+
+void InterestGrid::build(std::uint32_t sequence, const std::vector<RacerState>& racers) {
+    // The last build becomes the previous one; only its chunks need clearing
+    // from the one it replaces
+    chunkAt.swap(previousChunkAt);
+    chunks.swap(previousChunks);
+    bytes.swap(previousBytes);
+    for (const Chunk& chunk : chunks) {
+        chunkAt[chunk.index] = -1;
+    }
+    chunks.clear();
+    bytes.clear();
+
+    placed.clear();
+    for (std::size_t id = 0; id < racers.size(); ++id) {
+        if (racers[id].status != RacerStatus::Out) {
+            placed.push_back(std::make_pair(chunkOf(racers[id].x, racers[id].y), static_cast<int>(id)));
+        }
+    }
+    std::sort(placed.begin(), placed.end());
+
+    for (std::size_t first = 0; first < placed.size();) {
+        std::size_t last = first;
+        while (last < placed.size() && placed[last].first == placed[first].first) {
+            ++last;
+        }
+        Chunk chunk;
+        chunk.index = placed[first].first;
+        chunk.offset = bytes.size();
+        int column = chunk.index % columns;
+        int row = chunk.index / columns;
+        bytes.push_back(static_cast<char>(column & 0xff)); // Little-endian, like the rest of the wire
+        bytes.push_back(static_cast<char>(column >> 8));
+        bytes.push_back(static_cast<char>(row & 0xff));
+        bytes.push_back(static_cast<char>(row >> 8));
+        bytes.push_back(static_cast<char>(last - first));
+        for (std::size_t i = first; i < last; ++i) {
+            const RacerState& racer = racers[placed[i].second];
+            int dx = std::max(0, std::min(racer.x - column * interestChunkCells, interestChunkCells - 1));
+            int dy = std::max(0, std::min(racer.y - row * interestChunkCells, interestChunkCells - 1));
+            unsigned entry = static_cast<unsigned>(placed[i].second) << 10 | static_cast<unsigned>(dx) << 5 | dy;
+            bytes.push_back(static_cast<char>(entry & 0xff));
+            bytes.push_back(static_cast<char>(entry >> 8));
+        }
+        chunk.size = bytes.size() - chunk.offset;
+        chunkAt[chunk.index] = static_cast<int>(chunks.size());
+        chunks.push_back(chunk);
+        first = last;
+    }
+    markChanges(sequence);
+}
+
+bool InterestGrid::sameAs(const Chunk& chunk, int previousEntry) const {
+    if (previousEntry < 0) {
+        return false;
+    }
+    const Chunk& before = previousChunks[previousEntry];
+    return before.size == chunk.size
+        && std::memcmp(&bytes[chunk.offset], &previousBytes[before.offset], chunk.size) == 0;
+}
+
+void InterestGrid::markChanges(std::uint32_t sequence) {
+    if (fresh) {
+        // No client has a baseline from before now
+        std::fill(changedIn.begin(), changedIn.end(), sequence);
+        fresh = false;
+        return;
+    }
+    for (const Chunk& chunk : chunks) {
+        if (!sameAs(chunk, previousChunkAt[chunk.index])) {
+            changedIn[chunk.index] = sequence;
+        }
+    }
+    for (const Chunk& before : previousChunks) {
+        if (chunkAt[before.index] < 0) {
+            changedIn[before.index] = sequence; // Emptied
+        }
+    }
+}
+
+void InterestGrid::writeAround(WireBuffer& buffer, const RacerState& own, std::uint32_t baselineSequence,
+    const RacerState* baseline) const {
+    int centre = chunkOf(own.x, own.y);
+    int column = centre % columns;
+    int row = centre / columns;
+    bool same = baseline && baselineSequence != noBaseline && chunkOf(baseline->x, baseline->y) == centre;
+    const Chunk* near[9];
+    std::uint8_t count = 0;
+    for (int r = std::max(0, row - 1); r <= std::min(rows - 1, row + 1); ++r) {
+        for (int c = std::max(0, column - 1); c <= std::min(columns - 1, column + 1); ++c) {
+            int index = r * columns + c;
+            same = same && changedIn[index] <= baselineSequence;
+            if (chunkAt[index] >= 0) {
+                near[count++] = &chunks[chunkAt[index]];
+            }
+        }
+    }
+    if (same) {
+        buffer.putUint8(sameNearbyChunks);
+        return;
+    }
+    buffer.putUint8(count);
+    for (std::uint8_t i = 0; i < count; ++i) {
+        buffer.append(&bytes[near[i]->offset], near[i]->size);
+    }
+}
+
+bool readNearbyRacers(WireReader& reader, std::vector<RacerState>& racers, int ownId, std::uint32_t& inView) {
+    std::uint8_t chunkCount = 0;
+    if (!reader.getUint8(chunkCount) || ownId < 0 || ownId >= static_cast<int>(racers.size())) {
+        return false;
+    }
+    inView = 0;
+    if (chunkCount == sameNearbyChunks) {
+        // Everyone left where the baseline had them, so the view follows from that
+        int column = interestChunk(racers[ownId].x);
+        int row = interestChunk(racers[ownId].y);
+        for (std::size_t id = 0; id < racers.size(); ++id) {
+            if (racers[id].status != RacerStatus::Out && std::abs(interestChunk(racers[id].x) - column) <= 1
+                && std::abs(interestChunk(racers[id].y) - row) <= 1) {
+                inView |= 1u << id;
+            }
+        }
+        return true;
+    }
+    if (chunkCount > 9) {
+        return false;
+    }
+    for (std::uint8_t chunk = 0; chunk < chunkCount; ++chunk) {
+        LittleUint16 column, row;
+        std::uint8_t count = 0;
+        if (!reader.get(column) || !reader.get(row) || !reader.getUint8(count) || column >= maxInterestChunks
+            || row >= maxInterestChunks) {
+            return false;
+        }
+        for (std::uint8_t i = 0; i < count; ++i) {
+            LittleUint16 wire;
+            if (!reader.get(wire) || (wire >> 10) >= racers.size()) {
+                return false;
+            }
+            std::uint16_t entry = wire;
+            RacerState& racer = racers[entry >> 10];
+            racer.x = column * interestChunkCells + (entry >> 5 & 0x1f);
+            racer.y = row * interestChunkCells + (entry & 0x1f);
+            inView |= 1u << (entry >> 10);
+        }
+    }
+    return true;
+}
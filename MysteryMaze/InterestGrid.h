@@ -0,0 +1,76 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "RaceProtocol.h"
+#include "WireBuffer.h"
+
+// Side of one chunk of the interest grid, in maze cells. A client is sent
+// the racers in its own chunk and the eight around it, so it always sees at
+// least this far in every direction.
+const int interestChunkCells = 32;
+const int maxInterestChunks = (maxRaceMazeSize + interestChunkCells - 1) / interestChunkCells; // Per side, enough for any race maze
+
+// Chunk count that stands for "the same chunks as in your baseline"
+const std::uint8_t sameNearbyChunks = 0xff;
+
+// Column or row of the chunk holding a cell
+inline int interestChunk(int cell) {
+    return std::max(0, std::min(cell / interestChunkCells, maxInterestChunks - 1));
+}
+
+// Who is near whom on a big maze: a spatial hash of racer positions over a
+// uniform grid of chunks. Each occupied chunk is serialized once per
+// snapshot, and every client near it gets a copy of the same bytes instead
+// of having the racers written out again for it. A client whose chunks have
+// not changed since its baseline gets sameNearbyChunks and nothing else.
+//
+// A chunk is uint16 column, uint16 row, uint8 count, then per racer a uint16
+// of id << 10 | x << 5 | y, its position within the chunk.
+class InterestGrid {
+public:
+    void reset(int mazeWidth, int mazeHeight);
+
+    // Bucket and serialize every racer still in the race for a snapshot
+    void build(std::uint32_t sequence, const std::vector<RacerState>& racers);
+
+    // The chunks around a racer now at own, for a client whose baseline is
+    // baselineSequence with the racer then at baseline (nullptr for none)
+    void writeAround(WireBuffer& buffer, const RacerState& own, std::uint32_t baselineSequence,
+        const RacerState* baseline) const;
+
+    std::size_t occupiedChunks() const { return chunks.size(); }
+
+private:
+    struct Chunk {
+        int index = 0;
+        std::size_t offset = 0;
+        std::size_t size = 0;
+    };
+
+    int chunkOf(int x, int y) const;
+    bool sameAs(const Chunk& chunk, int previousEntry) const;
+    void markChanges(std::uint32_t sequence);
+
+    int columns = 0;
+    int rows = 0;
+    bool fresh = true; // Nothing built since reset
+
+    // This build and the one before, to tell which chunks changed between them
+    std::vector<int> chunkAt;          // Per grid chunk: its entry in chunks, or -1 when empty
+    std::vector<Chunk> chunks;         // Occupied chunks
+    std::vector<char> bytes;           // Every occupied chunk, back to back
+    std::vector<int> previousChunkAt;
+    std::vector<Chunk> previousChunks;
+    std::vector<char> previousBytes;
+
+    std::vector<std::uint32_t> changedIn;    // Per grid chunk: the snapshot its racers last changed in
+    std::vector<std::pair<int, int>> placed; // (chunk, racer id), sorted so each chunk's racers are together
+};
+
+// Read what writeAround wrote into the other racers' positions and set
+// inView to a bit per racer near ownId. With sameNearbyChunks the positions
+// are left as the baseline had them and inView is worked out from those.
+bool readNearbyRacers(WireReader& reader, std::vector<RacerState>& racers, int ownId, std::uint32_t& inView);
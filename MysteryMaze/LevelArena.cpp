@@ -0,0 +1,73 @@
+#include "LevelArena.h"
+#include "AllocationCounter.h"
+#include <new>
+
+LevelArena::LevelArena(std::size_t firstBlockSize)
+    : firstBlock(nullptr), currentBlock(nullptr), offset(0), usedBefore(0), nextBlockSize(firstBlockSize) {
+    firstBlock = currentBlock = newBlock(firstBlockSize);
+}
+
+LevelArena::~LevelArena() {
+    Block* block = firstBlock;
+    while (block) {
+        Block* next = block->next;
+        ::operator delete(block);
+        block = next;
+    }
+}
+
+LevelArena::Block* LevelArena::newBlock(std::size_t size) {
+    MemoryTagScope memoryTag(MemoryTag::Maze);
+    void* memory = ::operator new(sizeof(Block) + size);
+    Block* block = static_cast<Block*>(memory);
+    block->next = nullptr;
+    block->size = size;
+    nextBlockSize = size * 2;
+    return block;
+}
+
+void* LevelArena::allocate(std::size_t bytes, std::size_t alignment) {
+    while (true) {
+        std::size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+        if (aligned + bytes <= currentBlock->size) {
+            offset = aligned + bytes;
+            return currentBlock->data() + aligned;
+        }
+
+        // Move on to the next block, reusing one kept from an earlier level if it is big enough
+        usedBefore += offset;
+        offset = 0;
+        if (!currentBlock->next || currentBlock->next->size < bytes + alignment) {
+            Block* block = newBlock(std::max(nextBlockSize, bytes + alignment));
+            block->next = currentBlock->next;
+            currentBlock->next = block;
+        }
+        currentBlock = currentBlock->next;
+    }
+}
+
+void LevelArena::reset() {
+    currentBlock = firstBlock;
+    offset = 0;
+    usedBefore = 0;
+}
+
+std::size_t LevelArena::bytesUsed() const {
+    return usedBefore + offset;
+}
+
+std::size_t LevelArena::bytesReserved() const {
+    std::size_t total = 0;
+    for (Block* block = firstBlock; block; block = block->next) {
+        total += block->size;
+    }
+    return total;
+}
+
+std::size_t LevelArena::blockCount() const {
+    std::size_t count = 0;
+    for (Block* block = firstBlock; block; block = block->next) {
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <algorithm>
+
+// Bump allocator for everything that only lives as long as one level
+// (maze grid, purple blocks, enemy bookkeeping, generator stack).
+// Memory is never freed individually; reset() rewinds the arena in O(1)
+// and keeps its blocks, so after the first few levels a level change
+// does not touch the heap at all.
+class LevelArena {
+public:
+    explicit LevelArena(std::size_t firstBlockSize = 64 * 1024);
+    ~LevelArena();
+
+    LevelArena(const LevelArena&) = delete;
+    LevelArena& operator=(const LevelArena&) = delete;
+
+    void* allocate(std::size_t bytes, std::size_t alignment);
+    void reset();
+
+    std::size_t bytesUsed() const;     // Bytes handed out since the last reset
+    std::size_t bytesReserved() const; // Total size of all blocks owned by the arena
+    std::size_t blockCount() const;
+
+private:
+    struct Block {
+        Block* next;
+        std::size_t size;
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    Block* newBlock(std::size_t size);
+
+    Block* firstBlock;
+    Block* currentBlock;
+    std::size_t offset;        // Offset into currentBlock
+    std::size_t usedBefore;    // Bytes used in the blocks before currentBlock
+    std::size_t nextBlockSize;
+};
+
+// Fixed-capacity array carved out of a LevelArena. It has no destructor work
+// to do, so it can simply be re-bound after the arena is reset.
+template <typename T>
+class ArenaArray {
+public:
+    void bind(LevelArena& arena, std::size_t capacity) {
+        items = static_cast<T*>(arena.allocate(capacity * sizeof(T), alignof(T)));
+        count = 0;
+        maxCount = capacity;
+    }
+
+    void push_back(const T& value) { items[count++] = value; }
+    void pop_back() { --count; }
+    T& back() { return items[count - 1]; }
+    const T& back() const { return items[count - 1]; }
+    T& operator[](std::size_t i) { return items[i]; }
+    const T& operator[](std::size_t i) const { return items[i]; }
+
+    // Removes [first, last) and shifts the tail down, like std::vector::erase
+    T* erase(T* first, T* last) {
+        T* newEnd = std::copy(last, end(), first);
+        count = static_cast<std::size_t>(newEnd - items);
+        return first;
+    }
+
+    void resize(std::size_t newSize) { count = newSize; } // New elements are left as-is
+    void clear() { count = 0; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == maxCount; }
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return maxCount; }
+
+    T* begin() { return items; }
+    T* end() { return items + count; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+
+private:
+    T* items = nullptr;
+    std::size_t count = 0;
+    std::size_t maxCount = 0;
+};
+
+// Row-major 2D grid carved out of a LevelArena; grid[y][x] indexing matches
+// the std::vector<std::vector<char>> it replaces.
+template <typename T>
+class ArenaGrid {
+public:
+    void bind(LevelArena& arena, int gridWidth, int gridHeight, const T& fill) {
+        cols = gridWidth;
+        rows = gridHeight;
+        cells = static_cast<T*>(arena.allocate(sizeof(T) * size(), alignof(T)));
+        std::fill(cells, cells + size(), fill);
+    }
+
+    // Point the grid at memory it does not own, e.g. a memory-mapped maze file
+    void view(T* external, int gridWidth, int gridHeight) {
+        cols = gridWidth;
+        rows = gridHeight;
+        cells = external;
+    }
+
+    // In std::size_t, as a side past 46340 overflows an int product
+    T* operator[](int row) { return cells + static_cast<std::size_t>(row) * cols; }
+    const T* operator[](int row) const { return cells + static_cast<std::size_t>(row) * cols; }
+
+    T* data() { return cells; }
+    const T* data() const { return cells; }
+    int width() const { return cols; }
+    int height() const { return rows; }
+    std::size_t size() const { return static_cast<std::size_t>(cols) * rows; }
+
+private:
+    T* cells = nullptr;
+    int cols = 0;
+    int rows = 0;
+};
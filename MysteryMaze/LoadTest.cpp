@@ -0,0 +1,167 @@
+#include "LoadTest.h"
+#include "Histogram.h"
+#include "RaceBot.h"
+#include "RaceClient.h"
+#include "RoomServer.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    // One simulated player, racing again and again
+    struct LoadBot {
+        std::unique_ptr<World> world;
+        std::unique_ptr<RaceClient> client; // Destroyed before world, which it points into
+        std::vector<std::uint32_t> toExit;
+        Rng input;
+        bool connected = false;
+
+        // Gathered from every client this bot has had since the step began
+        Histogram latencyUs;
+        std::uint64_t snapshots = 0;
+        std::uint64_t skipped = 0;
+        std::uint32_t clientSnapshots = 0; // Already counted from the current client
+        std::uint32_t clientSkipped = 0;
+    };
+
+    void gather(LoadBot& bot) {
+        if (!bot.client) {
+            return;
+        }
+        bot.latencyUs.merge(bot.client->moveLatency());
+        bot.client->clearMoveLatency();
+        bot.snapshots += bot.client->snapshotsReceived() - bot.clientSnapshots;
+        bot.skipped += bot.client->snapshotsSkipped() - bot.clientSkipped;
+        bot.clientSnapshots = bot.client->snapshotsReceived();
+        bot.clientSkipped = bot.client->snapshotsSkipped();
+    }
+
+    void joinRace(LoadBot& bot, unsigned short port) {
+        gather(bot);
+        if (bot.client) {
+            bot.client->leave();
+        }
+        bot.client.reset();
+        bot.world.reset(new World());
+        bot.client.reset(new RaceClient(*bot.world));
+        bot.toExit.clear();
+        bot.clientSnapshots = 0;
+        bot.clientSkipped = 0;
+        bot.connected = bot.client->connect(sf::IpAddress::LocalHost, port);
+    }
+}
+
+bool runLoadTest(std::ostream& out, int maxClients, int clientsPerStep, double secondsPerStep, int racersPerRoom,
+    unsigned threads) {
+    maxClients = std::max(1, maxClients);
+    clientsPerStep = std::max(1, std::min(clientsPerStep, maxClients));
+    racersPerRoom = std::max(1, std::min(racersPerRoom, maxRacers));
+    threads = std::max(1u, threads);
+
+    // Twice the rooms the bots can fill, as finished rooms stay shut for a while before opening again
+    int rooms = 2 * ((maxClients + racersPerRoom - 1) / racersPerRoom) + 1;
+    RoomServer server(rooms, racersPerRoom, threads - 1, firstLevelSize);
+    if (!server.listen(0)) {
+        out << "Unable to open a UDP socket" << std::endl;
+        return false;
+    }
+    unsigned short port = server.port();
+    std::thread serverThread([&server, &out] { server.run(out, 0.0, 0.0); });
+
+    out << "Load test: " << rooms << " rooms of " << racersPerRoom << " on port " << port << ", server and bots "
+        << threads << " threads each, " << secondsPerStep << " s a step" << std::endl;
+    out << "clients  in race  snaps/s  lost %   latency ms p50    p95    p99    max   server tick us avg    p99    max  late  bot tick us" << std::endl;
+
+    std::vector<std::unique_ptr<LoadBot>> bots;
+    WorkerPool pool(threads - 1);
+    std::uint32_t tick = 0;
+    std::function<void(std::size_t)> tickBot = [&bots, &tick, port](std::size_t index) {
+        LoadBot& bot = *bots[index];
+        if (!bot.connected || bot.client->over() || bot.client->timedOut()) {
+            joinRace(bot, port);
+            return;
+        }
+        // A step every few ticks, the way a player holding keys down would, spread across the bots
+        char move = 0;
+        if (bot.client->started() && (tick + index) % 4 == 0) {
+            move = botMove(*bot.world, bot.toExit, bot.input);
+        }
+        bot.client->tick(&move, move ? 1 : 0);
+    };
+
+    const Clock::duration tickPeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tickSeconds));
+    const std::uint32_t ticksPerStep = static_cast<std::uint32_t>(std::max(1.0, secondsPerStep * ticksPerSecond));
+    bool anySnapshots = false;
+    for (int clients = clientsPerStep;; clients = std::min(maxClients, clients + clientsPerStep)) {
+        while (static_cast<int>(bots.size()) < clients) {
+            bots.emplace_back(new LoadBot());
+            bots.back()->input.reseed(bots.size());
+            joinRace(*bots.back(), port);
+        }
+        for (std::unique_ptr<LoadBot>& bot : bots) {
+            gather(*bot);
+            bot->latencyUs.clear();
+            bot->snapshots = 0;
+            bot->skipped = 0;
+        }
+        server.takeLoad();
+
+        Histogram botTickUs;
+        Clock::time_point stepStart = Clock::now();
+        Clock::time_point nextTick = stepStart;
+        for (std::uint32_t i = 0; i < ticksPerStep; ++i, ++tick) {
+            Clock::time_point start = Clock::now();
+            pool.forEach(bots.size(), tickBot);
+            Clock::time_point end = Clock::now();
+            botTickUs.record(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()));
+
+            // Bots that fall behind skip ahead rather than tick back to back
+            nextTick = std::max(nextTick + tickPeriod, end);
+            std::this_thread::sleep_until(nextTick);
+        }
+        double stepSeconds = std::chrono::duration<double>(Clock::now() - stepStart).count();
+
+        ServerLoad load = server.takeLoad();
+        Histogram latencyUs;
+        std::uint64_t snapshots = 0;
+        std::uint64_t skipped = 0;
+        int racing = 0;
+        for (std::unique_ptr<LoadBot>& bot : bots) {
+            gather(*bot);
+            latencyUs.merge(bot->latencyUs);
+            snapshots += bot->snapshots;
+            skipped += bot->skipped;
+            racing += bot->client->started() && !bot->client->over() ? 1 : 0;
+        }
+        anySnapshots = anySnapshots || snapshots > 0;
+
+        char line[192];
+        std::snprintf(line, sizeof(line),
+            "%7d  %7d  %7.1f  %6.2f   %14.1f %6.1f %6.1f %6.1f   %17.0f %6u %6u  %4u  %11.0f",
+            clients, racing, snapshots / stepSeconds / clients, 100.0 * skipped / std::max<std::uint64_t>(1, snapshots + skipped),
+            latencyUs.percentile(0.5) / 1000.0, latencyUs.percentile(0.95) / 1000.0, latencyUs.percentile(0.99) / 1000.0,
+            latencyUs.max() / 1000.0, load.tickUs.mean(), load.tickUs.percentile(0.99), load.tickUs.max(), load.lateTicks,
+            botTickUs.mean());
+        out << line << std::endl;
+
+        if (clients >= maxClients) {
+            break;
+        }
+    }
+
+    for (std::unique_ptr<LoadBot>& bot : bots) {
+        if (bot->client) {
+            bot->client->leave();
+        }
+    }
+    server.stop();
+    serverThread.join();
+    return anySnapshots;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <ostream>
+
+// Look for the dedicated server's limit without real players. A RoomServer
+// runs in this process on a loopback port, and bot clients join it
+// clientsPerStep at a time, up to maxClients, holding each count for
+// secondsPerStep. Each bot is a normal RaceClient whose moves come from
+// botMove, so they go through movePlayer and isWalkable like a player's keys.
+// A bot whose race is over joins another.
+//
+// For each step it prints the snapshots each bot received a second and the
+// share that never arrived, the time from a move being made to the server
+// acknowledging it, and the server's tick time. Bots tick on a pool of
+// threads of their own; the time they take is shown too, as bots that fall
+// behind make latency look worse than the server is. Returns false if the
+// server could not start or no bot ever got a snapshot.
+bool runLoadTest(std::ostream& out, int maxClients, int clientsPerStep, double secondsPerStep, int racersPerRoom,
+    unsigned threads);
@@ -0,0 +1,517 @@
+#include "Lockstep.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <cstring>
+
+static const int joinRetryTicks = ticksPerSecond / 2;
+static const std::size_t maxHeldMoves = 16;
+static const std::uint32_t hashResends = 3; // Ticks the newest hash rides along, in case a datagram is lost
+
+LockstepPeer::LockstepPeer(World& localWorld) : localWorld(localWorld) {
+    previousAnswerer = localWorld.answerPuzzle;
+    localWorld.answerPuzzle = openPurpleBlock;
+    heldMoves.reserve(maxHeldMoves);
+    players.reserve(maxRacers);
+    states.reserve(maxRacers);
+    remotes.reserve(maxRacers);
+}
+
+LockstepPeer::~LockstepPeer() {
+    localWorld.answerPuzzle = previousAnswerer;
+}
+
+bool LockstepPeer::host(unsigned short port, int peers) {
+    if (!socket.bind(port)) {
+        return false;
+    }
+    hosting = true;
+    localId = 0;
+    expectedPeers = std::max(1, std::min(peers, maxRacers));
+    setUpWorlds(localWorld.seed, localWorld.width, localWorld.height, localWorld.level, expectedPeers);
+    return true;
+}
+
+bool LockstepPeer::join(const sf::IpAddress& address, unsigned short port) {
+    if (!socket.bind(sf::Socket::AnyPort)) {
+        return false;
+    }
+    hostAddress = address;
+    hostPort = port;
+    ticks = 0;
+    lastHeard = 0;
+    return true;
+}
+
+void LockstepPeer::setUpWorlds(std::uint32_t seed, int width, int height, int level, int peerCount) {
+    players.clear();
+    players.resize(peerCount);
+    states.resize(peerCount);
+    for (int id = 0; id < peerCount; ++id) {
+        Player& player = players[id];
+        if (id == localId) {
+            player.world = &localWorld;
+        }
+        else {
+            player.ownWorld.reset(new World());
+            player.world = player.ownWorld.get();
+            player.world->showMessages = false;
+            player.world->answerPuzzle = openPurpleBlock;
+        }
+
+        // Everyone builds every world the same way, the host's own included
+        World& world = *player.world;
+        world.seed = seed;
+        world.width = width;
+        world.height = height;
+        world.level = level;
+        world.tick = 0;
+        startLevel(world);
+    }
+    levelBlocks.assign(localWorld.purpleBlocks.begin(), localWorld.purpleBlocks.end());
+    for (int id = 0; id < peerCount; ++id) {
+        states[id] = racerStateOf(*players[id].world, levelBlocks, RacerStatus::Racing, 0);
+    }
+}
+
+void LockstepPeer::tick(const char* moves, std::size_t count) {
+    MemoryTagScope memoryTag(MemoryTag::Network);
+    ++ticks;
+    socket.setTime(static_cast<std::uint32_t>(ticks * 1000ull / ticksPerSecond));
+    receive();
+
+    if (!hosting && !welcomed()) {
+        if (ticks % joinRetryTicks == 1) {
+            outgoing.clear();
+            outgoing << static_cast<sf::Uint8>(LockstepMessage::Join) << lockstepProtocolVersion;
+            send(outgoing, hostAddress, hostPort);
+        }
+        return;
+    }
+
+    // A peer that goes quiet is dropped, and from then on moves nowhere
+    for (Remote& remote : remotes) {
+        if (!remote.gone && ticks - remote.lastHeard > static_cast<std::uint32_t>(raceTimeoutTicks)) {
+            remote.gone = true;
+        }
+    }
+
+    // Moves made while waiting for the others would all land on the first tick
+    scheduleLocalMoves(moves, started() ? count : 0);
+
+    std::uint32_t before = simTick;
+    advance();
+    if (started() && simTick == before) {
+        ++stalls;
+    }
+
+    if (hosting) {
+        for (Remote& remote : remotes) {
+            if (remote.welcomed && !remote.gone) {
+                sendFrames(remote);
+            }
+        }
+    }
+    else {
+        sendInputs();
+    }
+    if (hashSends > 0) {
+        --hashSends;
+    }
+}
+
+void LockstepPeer::leave() {
+    if (!hosting && welcomed()) {
+        outgoing.clear();
+        outgoing << static_cast<sf::Uint8>(LockstepMessage::Leave);
+        socket.sendNow(outgoing, hostAddress, hostPort); // Now, as there are no more ticks to send it on
+    }
+}
+
+void LockstepPeer::setNetworkConditions(const NetworkConditions& sending, const NetworkConditions& receiving, std::uint64_t seed) {
+    socket.setConditions(sending, receiving, seed);
+}
+
+bool LockstepPeer::over() const {
+    if (!started()) {
+        return false;
+    }
+    for (const Player& player : players) {
+        if (player.status == RacerStatus::Racing) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LockstepPeer::timedOut() const {
+    return !hosting && ticks - lastHeard > static_cast<std::uint32_t>(raceTimeoutTicks);
+}
+
+int LockstepPeer::joined() const {
+    return hosting ? 1 + static_cast<int>(remotes.size()) : peers();
+}
+
+LockstepPeer::Frame& LockstepPeer::frameFor(std::uint32_t tick, Frame* ring) {
+    Frame& frame = ring[tick % lockstepWindow];
+    if (frame.tick != tick) {
+        frame = Frame(); // Whatever was here before is long acknowledged
+        frame.tick = tick;
+    }
+    return frame;
+}
+
+void LockstepPeer::scheduleLocalMoves(const char* moves, std::size_t count) {
+    if (count > 0) {
+        heldMoves.append(moves, std::min(count, maxHeldMoves - heldMoves.size()));
+    }
+
+    // One input a tick, never more than the delay ahead of the simulation;
+    // while it is held up the moves wait here
+    if (nextInputTick > simTick + lockstepInputDelayTicks) {
+        return;
+    }
+    Frame& slot = frameFor(nextInputTick, hosting ? frames : localInputs);
+    std::uint8_t taken = static_cast<std::uint8_t>(std::min<std::size_t>(heldMoves.size(), maxMovesPerTick));
+    slot.counts[localId] = taken;
+    std::memcpy(slot.moves[localId], heldMoves.data(), taken);
+    heldMoves.erase(0, taken);
+    ++nextInputTick;
+}
+
+void LockstepPeer::advance() {
+    if (hosting) {
+        while (joined() == expectedPeers && frameComplete(simTick)) {
+            step(frameFor(simTick, frames));
+        }
+    }
+    else {
+        while (simTick < framesReceived) {
+            step(frames[simTick % lockstepWindow]);
+        }
+    }
+}
+
+bool LockstepPeer::frameComplete(std::uint32_t tick) const {
+    if (nextInputTick <= tick) {
+        return false;
+    }
+    for (const Remote& remote : remotes) {
+        if (!remote.gone && remote.inputsReceived <= tick) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LockstepPeer::step(const Frame& frame) {
+    for (std::size_t id = 0; id < players.size(); ++id) {
+        Player& player = players[id];
+        if (player.status != RacerStatus::Racing) {
+            continue;
+        }
+        TickResult result = stepWorld(*player.world, frame.moves[id], frame.counts[id]);
+        if (result == TickResult::ExitReached) {
+            player.status = RacerStatus::Finished;
+            player.finishTicks = simTick + 1;
+        }
+        else if (result != TickResult::Playing) {
+            player.status = RacerStatus::Out;
+        }
+        states[id] = racerStateOf(*player.world, levelBlocks, player.status, player.finishTicks);
+    }
+    ++simTick;
+
+    if (simTick % lockstepHashTicks == 0) {
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (const Player& player : players) {
+            hash = (hash ^ hashWorld(*player.world) ^ static_cast<std::uint64_t>(player.status)) * 1099511628211ULL;
+        }
+        StateHash& latest = hashes[(simTick / lockstepHashTicks) % 4];
+        latest.tick = simTick;
+        latest.hash = hash;
+        hashSends = hashResends;
+        if (awaitedHash.tick == simTick) {
+            compareHash(awaitedHash.tick, awaitedHash.hash, hostHashChecked);
+            awaitedHash.tick = noTick;
+        }
+    }
+}
+
+void LockstepPeer::compareHash(std::uint32_t tick, std::uint64_t hash, std::uint32_t& checkedTick) {
+    // The same hash arrives a few times over
+    if (tick <= checkedTick) {
+        return;
+    }
+    const StateHash& own = hashes[(tick / lockstepHashTicks) % 4];
+    if (own.tick == tick) {
+        checkedTick = tick;
+        ++hashChecks;
+        if (own.hash != hash && desyncTick == noTick) {
+            desyncTick = tick;
+        }
+    }
+    else if (tick > simTick) {
+        awaitedHash.tick = tick;
+        awaitedHash.hash = hash;
+    }
+}
+
+void LockstepPeer::receive() {
+    sf::IpAddress address;
+    unsigned short port;
+    while (WireBuffer* datagram = socket.receive(address, port)) {
+        incoming.clear();
+        incoming.append(datagram->data(), datagram->size());
+        socket.release(datagram);
+        stats.bytesReceived += incoming.getDataSize();
+        ++stats.packetsReceived;
+        sf::Uint8 typeByte = 0;
+        if (!(incoming >> typeByte)) {
+            continue;
+        }
+        LockstepMessage type = static_cast<LockstepMessage>(typeByte);
+
+        if (hosting) {
+            Remote* remote = findRemote(address, port);
+            if (type == LockstepMessage::Join) {
+                handleJoin(address, port, incoming);
+            }
+            else if (remote && !remote->gone) {
+                remote->lastHeard = ticks;
+                if (type == LockstepMessage::Inputs) {
+                    handleInputs(*remote, incoming);
+                }
+                else if (type == LockstepMessage::Leave) {
+                    remote->gone = true;
+                }
+            }
+        }
+        else if (address == hostAddress && port == hostPort) {
+            lastHeard = ticks;
+            if (type == LockstepMessage::Welcome) {
+                handleWelcome(incoming);
+            }
+            else if (type == LockstepMessage::Frames && welcomed()) {
+                handleFrames(incoming);
+            }
+        }
+    }
+}
+
+void LockstepPeer::handleJoin(const sf::IpAddress& address, unsigned short port, sf::Packet& packet) {
+    sf::Uint16 version = 0;
+    if (!(packet >> version) || version != lockstepProtocolVersion) {
+        return;
+    }
+
+    // A repeated Join means our Welcome was lost
+    if (Remote* known = findRemote(address, port)) {
+        known->lastHeard = ticks;
+        sendWelcome(*known);
+        return;
+    }
+    if (joined() >= expectedPeers) {
+        return;
+    }
+    Remote remote;
+    remote.address = address;
+    remote.port = port;
+    remote.id = joined();
+    remote.lastHeard = ticks;
+    remotes.push_back(remote);
+    sendWelcome(remotes.back());
+}
+
+void LockstepPeer::handleWelcome(sf::Packet& packet) {
+    sf::Uint16 version = 0;
+    sf::Uint8 id = 0, peerCount = 0;
+    sf::Uint32 seed = 0;
+    sf::Int32 width = 0, height = 0, level = 0;
+    if (welcomed() || !(packet >> version >> id >> peerCount >> seed >> width >> height >> level)
+        || version != lockstepProtocolVersion || peerCount > maxRacers || id >= peerCount || !validRaceMazeSize(width, height)) {
+        return;
+    }
+    localId = id;
+    expectedPeers = peerCount;
+    setUpWorlds(seed, width, height, level, peerCount);
+}
+
+void LockstepPeer::handleInputs(Remote& remote, sf::Packet& packet) {
+    sf::Uint32 acked = 0, first = 0;
+    sf::Uint8 count = 0;
+    if (!(packet >> acked >> first >> count)) {
+        return;
+    }
+    remote.welcomed = true;
+    if (acked > remote.framesAcked && acked <= simTick) {
+        remote.framesAcked = acked;
+    }
+
+    // Inputs already received are resent until acknowledged; skip those
+    for (sf::Uint32 i = 0; i < count; ++i) {
+        std::uint8_t moveCount = 0;
+        char moves[maxMovesPerTick];
+        if (!readMoves(packet, moveCount, moves)) {
+            return;
+        }
+        std::uint32_t tick = first + i;
+        if (tick == remote.inputsReceived && tick < simTick + lockstepWindow / 2) {
+            Frame& frame = frameFor(tick, frames);
+            frame.counts[remote.id] = moveCount;
+            std::memcpy(frame.moves[remote.id], moves, moveCount);
+            ++remote.inputsReceived;
+        }
+    }
+
+    StateHash hash;
+    if (readHash(packet, hash) && hash.tick != noTick) {
+        compareHash(hash.tick, hash.hash, remote.hashChecked);
+    }
+}
+
+void LockstepPeer::handleFrames(sf::Packet& packet) {
+    sf::Uint32 inputsReceived = 0, first = 0;
+    sf::Uint8 count = 0;
+    if (!(packet >> inputsReceived >> first >> count)) {
+        return;
+    }
+    if (inputsReceived > inputsAcked && inputsReceived <= nextInputTick) {
+        inputsAcked = inputsReceived;
+    }
+
+    for (sf::Uint32 i = 0; i < count; ++i) {
+        Frame frame;
+        frame.tick = first + i;
+        sf::Uint8 mask = 0;
+        if (!(packet >> mask)) {
+            return;
+        }
+        for (std::size_t id = 0; id < players.size(); ++id) {
+            if ((mask & (1u << id)) && !readMoves(packet, frame.counts[id], frame.moves[id])) {
+                return;
+            }
+        }
+        if (frame.tick == framesReceived) {
+            frames[frame.tick % lockstepWindow] = frame;
+            ++framesReceived;
+        }
+    }
+
+    StateHash hash;
+    if (readHash(packet, hash) && hash.tick != noTick) {
+        compareHash(hash.tick, hash.hash, hostHashChecked);
+    }
+}
+
+bool LockstepPeer::readMoves(sf::Packet& packet, std::uint8_t& count, char* moves) {
+    sf::Uint8 moveCount = 0;
+    if (!(packet >> moveCount) || moveCount > maxMovesPerTick) {
+        return false;
+    }
+    for (sf::Uint8 i = 0; i < moveCount; ++i) {
+        sf::Uint8 move = 0;
+        if (!(packet >> move)) {
+            return false;
+        }
+        moves[i] = static_cast<char>(move);
+    }
+    count = moveCount;
+    return true;
+}
+
+void LockstepPeer::writeHash(sf::Packet& packet) {
+    const StateHash& latest = hashes[(simTick / lockstepHashTicks) % 4];
+    if (hashSends > 0 && latest.tick != noTick) {
+        packet << latest.tick << static_cast<sf::Uint64>(latest.hash);
+    }
+    else {
+        packet << noTick;
+    }
+}
+
+bool LockstepPeer::readHash(sf::Packet& packet, StateHash& hash) {
+    sf::Uint32 tick = noTick;
+    sf::Uint64 value = 0;
+    if (!(packet >> tick) || (tick != noTick && !(packet >> value))) {
+        return false;
+    }
+    hash.tick = tick;
+    hash.hash = value;
+    return true;
+}
+
+void LockstepPeer::sendWelcome(const Remote& remote) {
+    outgoing.clear();
+    outgoing << static_cast<sf::Uint8>(LockstepMessage::Welcome) << lockstepProtocolVersion
+        << static_cast<sf::Uint8>(remote.id) << static_cast<sf::Uint8>(expectedPeers) << localWorld.seed
+        << static_cast<sf::Int32>(localWorld.width) << static_cast<sf::Int32>(localWorld.height)
+        << static_cast<sf::Int32>(localWorld.level);
+    send(outgoing, remote.address, remote.port);
+}
+
+void LockstepPeer::sendFrames(Remote& remote) {
+    // Every tick while frames are unacknowledged, otherwise only to keep
+    // the client from timing us out
+    if (remote.framesAcked >= simTick && ticks - remote.lastSent < static_cast<std::uint32_t>(joinRetryTicks)) {
+        return;
+    }
+    std::uint32_t first = remote.framesAcked;
+    std::uint32_t count = std::min<std::uint32_t>(simTick - first, maxTicksPerDatagram);
+    outgoing.clear();
+    outgoing << static_cast<sf::Uint8>(LockstepMessage::Frames) << remote.inputsReceived << first
+        << static_cast<sf::Uint8>(count);
+    for (std::uint32_t tick = first; tick < first + count; ++tick) {
+        const Frame& frame = frames[tick % lockstepWindow];
+        sf::Uint8 mask = 0;
+        for (std::size_t id = 0; id < players.size(); ++id) {
+            mask |= frame.counts[id] > 0 ? static_cast<sf::Uint8>(1u << id) : 0;
+        }
+        outgoing << mask;
+        for (std::size_t id = 0; id < players.size(); ++id) {
+            if (frame.counts[id] > 0) {
+                outgoing << frame.counts[id];
+                for (std::uint8_t i = 0; i < frame.counts[id]; ++i) {
+                    outgoing << static_cast<sf::Uint8>(frame.moves[id][i]);
+                }
+            }
+        }
+    }
+    writeHash(outgoing);
+    send(outgoing, remote.address, remote.port);
+    remote.lastSent = ticks;
+}
+
+void LockstepPeer::sendInputs() {
+    if (nextInputTick <= inputsAcked && ticks - lastSent < static_cast<std::uint32_t>(snapshotIntervalTicks)) {
+        return;
+    }
+    std::uint32_t count = std::min<std::uint32_t>(nextInputTick - inputsAcked, maxTicksPerDatagram);
+    outgoing.clear();
+    outgoing << static_cast<sf::Uint8>(LockstepMessage::Inputs) << framesReceived << inputsAcked
+        << static_cast<sf::Uint8>(count);
+    for (std::uint32_t tick = inputsAcked; tick < inputsAcked + count; ++tick) {
+        const Frame& input = localInputs[tick % lockstepWindow];
+        outgoing << input.counts[localId];
+        for (std::uint8_t i = 0; i < input.counts[localId]; ++i) {
+            outgoing << static_cast<sf::Uint8>(input.moves[localId][i]);
+        }
+    }
+    writeHash(outgoing);
+    send(outgoing, hostAddress, hostPort);
+    lastSent = ticks;
+}
+
+void LockstepPeer::send(sf::Packet& packet, const sf::IpAddress& address, unsigned short port) {
+    stats.bytesSent += packet.getDataSize();
+    ++stats.packetsSent;
+    socket.send(packet, address, port);
+}
+
+LockstepPeer::Remote* LockstepPeer::findRemote(const sf::IpAddress& address, unsigned short port) {
+    for (Remote& remote : remotes) {
+        if (remote.address == address && remote.port == port) {
+            return &remote;
+        }
+    }
+    return nullptr;
+}
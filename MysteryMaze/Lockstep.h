@@ -0,0 +1,190 @@
+#pragma once
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/Packet.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "NetworkEmulator.h"
+#include "RaceProtocol.h"
+#include "World.h"
+
+// Lockstep races: the same race as RaceHost runs, but only inputs cross the
+// network. The maze, blocks, enemy and power-ups all follow from the seed
+// and the fixed tick, so every peer simulates every racer's world itself
+// and stays in step as long as all of them apply the same moves on the same
+// ticks. That makes the traffic a few bytes per tick whatever the maze size.
+//
+// The host collects each peer's moves for a tick into a frame and only steps
+// once the frame is complete; clients step as the host's frames arrive. A
+// move is scheduled lockstepInputDelayTicks ahead, which hides that much
+// latency before anyone has to wait. Every lockstepHashTicks each side hashes
+// all its worlds and compares with the other end to catch a desync.
+//
+// Every datagram is an sf::Packet that starts with a uint8 LockstepMessage:
+//   Join     client -> host  uint16 protocol version
+//   Welcome  host -> client  uint16 version, uint8 peer id, uint8 peers, uint32 seed,
+//                            int32 width, height, level
+//   Inputs   client -> host  uint32 frames received, uint32 first tick, uint8 count,
+//                            count x (uint8 moves, moves), then the hash
+//   Frames   host -> client  uint32 client's inputs received, uint32 first tick,
+//                            uint8 count, count x (uint8 mask of peers that moved,
+//                            for each of them uint8 moves, moves), then the hash
+//   Leave    client -> host  (none)
+// The hash is a uint32 tick, or noTick, followed by the uint64 state hash
+// after that tick if there is one. Inputs and frames are resent until the
+// other end has them, so a lost datagram costs latency rather than a desync.
+const std::uint16_t lockstepProtocolVersion = 1;
+const int lockstepInputDelayTicks = 4;
+const int lockstepHashTicks = ticksPerSecond / 2;
+const int lockstepWindow = 128; // Ticks of inputs and frames kept for resending
+const int maxMovesPerTick = 4;
+const int maxTicksPerDatagram = 32;
+const std::uint32_t noTick = 0xffffffff;
+
+enum class LockstepMessage : std::uint8_t {
+    Join = 1,
+    Welcome = 2,
+    Inputs = 3,
+    Frames = 4,
+    Leave = 5,
+};
+
+class LockstepPeer {
+public:
+    // The local world is this peer's racer. The host's must already hold the
+    // level; a client's is built from the seed in the Welcome.
+    explicit LockstepPeer(World& localWorld);
+    ~LockstepPeer();
+
+    LockstepPeer(const LockstepPeer&) = delete;
+    LockstepPeer& operator=(const LockstepPeer&) = delete;
+
+    bool host(unsigned short port, int peers);
+    bool join(const sf::IpAddress& address, unsigned short port);
+    unsigned short port() const { return socket.localPort(); }
+
+    // Called once per fixed tick with the local moves: read the network,
+    // schedule the moves, step every tick that is complete and send
+    void tick(const char* moves, std::size_t count);
+
+    // Tell the host we are gone rather than letting it time out
+    void leave();
+
+    // An emulated link between this peer's socket and the network, each way
+    void setNetworkConditions(const NetworkConditions& sending, const NetworkConditions& receiving, std::uint64_t seed);
+
+    bool welcomed() const { return localId >= 0; }
+    bool started() const { return simTick > 0; }
+    bool over() const;
+    bool timedOut() const;
+    bool desynced() const { return desyncTick != noTick; }
+    std::uint32_t desyncedAt() const { return desyncTick; }
+    int id() const { return localId; }
+    int joined() const; // Peers here so far, counting the host
+    int peers() const { return static_cast<int>(players.size()); }
+
+    const std::vector<RacerState>& racers() const { return states; }
+    const TrafficStats& traffic() const { return stats; }
+    std::uint32_t simulatedTicks() const { return simTick; }
+    std::uint32_t stalledTicks() const { return stalls; }     // Ticks since the start spent waiting for someone's inputs
+    std::uint32_t hashesCompared() const { return hashChecks; }
+    std::uint32_t ticksConnected() const { return ticks; }
+
+private:
+    // Every peer's moves for one tick
+    struct Frame {
+        std::uint32_t tick = noTick;
+        std::uint8_t counts[maxRacers] = {};
+        char moves[maxRacers][maxMovesPerTick] = {};
+    };
+
+    struct Player {
+        World* world = nullptr;
+        std::unique_ptr<World> ownWorld; // Everyone but the local peer
+        RacerStatus status = RacerStatus::Racing;
+        std::uint32_t finishTicks = 0;
+    };
+
+    // A client as the host sees it
+    struct Remote {
+        sf::IpAddress address;
+        unsigned short port = 0;
+        int id = 0;
+        bool welcomed = false;          // Its first Inputs arrived, so it has the Welcome
+        bool gone = false;              // Left or went silent; its moves are empty from then on
+        std::uint32_t inputsReceived = lockstepInputDelayTicks; // Ticks before the delay have no moves
+        std::uint32_t framesAcked = 0;
+        std::uint32_t lastHeard = 0;
+        std::uint32_t lastSent = 0;
+        std::uint32_t hashChecked = 0;  // Tick of its last hash we compared
+    };
+
+    struct StateHash {
+        std::uint32_t tick = noTick;
+        std::uint64_t hash = 0;
+    };
+
+    Frame& frameFor(std::uint32_t tick, Frame* ring);
+    void setUpWorlds(std::uint32_t seed, int width, int height, int level, int peerCount);
+    void scheduleLocalMoves(const char* moves, std::size_t count);
+    void advance();
+    bool frameComplete(std::uint32_t tick) const;
+    void step(const Frame& frame);
+    void compareHash(std::uint32_t tick, std::uint64_t hash, std::uint32_t& checkedTick);
+
+    void receive();
+    void handleJoin(const sf::IpAddress& address, unsigned short port, sf::Packet& packet);
+    void handleWelcome(sf::Packet& packet);
+    void handleInputs(Remote& remote, sf::Packet& packet);
+    void handleFrames(sf::Packet& packet);
+    bool readMoves(sf::Packet& packet, std::uint8_t& count, char* moves);
+    void writeHash(sf::Packet& packet);
+    bool readHash(sf::Packet& packet, StateHash& hash);
+    void sendWelcome(const Remote& remote);
+    void sendFrames(Remote& remote);
+    void sendInputs();
+    void send(sf::Packet& packet, const sf::IpAddress& address, unsigned short port);
+    Remote* findRemote(const sf::IpAddress& address, unsigned short port);
+
+    World& localWorld;
+    PuzzleAnswerer previousAnswerer;
+    EmulatedSocket socket;
+    bool hosting = false;
+    int localId = -1;
+    int expectedPeers = 1;
+
+    // Host only
+    std::vector<Remote> remotes;
+
+    // Client only
+    sf::IpAddress hostAddress;
+    unsigned short hostPort = 0;
+    std::uint32_t framesReceived = 0;                   // Frames before this tick are in frames
+    std::uint32_t inputsAcked = lockstepInputDelayTicks; // The host has our moves before this tick
+    Frame localInputs[lockstepWindow];
+
+    std::vector<Player> players;
+    std::vector<RacerState> states;
+    BlockList levelBlocks;
+    Frame frames[lockstepWindow];
+    std::string heldMoves;        // Made while the next input slot was still too far ahead
+    std::uint32_t nextInputTick = lockstepInputDelayTicks;
+    std::uint32_t simTick = 0;    // Next tick to simulate
+
+    StateHash hashes[4];           // Our own most recent hashes, by tick / lockstepHashTicks
+    StateHash awaitedHash;         // The host's hash for a tick we have yet to reach
+    std::uint32_t hostHashChecked = 0;
+    std::uint32_t hashSends = 0;   // Ticks left to send the newest hash
+    std::uint32_t hashChecks = 0;
+    std::uint32_t desyncTick = noTick;
+
+    std::uint32_t ticks = 0;
+    std::uint32_t lastHeard = 0;
+    std::uint32_t lastSent = 0;
+    std::uint32_t stalls = 0;
+    sf::Packet outgoing;
+    sf::Packet incoming;
+    TrafficStats stats;
+};
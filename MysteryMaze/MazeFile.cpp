@@ -0,0 +1,270 @@
+#include "MazeFile.h"
+#include "World.h"
+#include "SaveGame.h"
+#include "GridCodec.h"
+#include "Profiler.h"
+#include "AllocationCounter.h"
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(MazeFileHeader) == 72, "maze file header must not change size silently");
+static_assert(purpleBlockCount <= 2, "MazeFileHeader has room for two purple blocks");
+
+static std::uint64_t alignUp(std::uint64_t offset) {
+    return (offset + mazeFileAlignment - 1) & ~(mazeFileAlignment - 1);
+}
+
+// Checks shared by both variants; the sections are checked by the caller
+static bool validHeader(const MazeFileHeader& h, std::uint32_t magic) {
+    auto inside = [&](int x, int y) { return x >= 0 && y >= 0 && x < h.width && y < h.height; };
+    bool valid = h.magic == magic && h.version == mazeFileVersion && h.headerSize == sizeof(MazeFileHeader)
+        && h.width >= 3 && h.height >= 3 && inside(h.exitX, h.exitY) && h.purpleBlockCount <= purpleBlockCount
+        && (h.powerUpX < 0 || inside(h.powerUpX, h.powerUpY)) && h.tilesOffset >= sizeof(MazeFileHeader);
+    for (std::uint32_t i = 0; valid && i < h.purpleBlockCount; ++i) {
+        valid = inside(h.purpleBlocks[i][0], h.purpleBlocks[i][1]);
+    }
+    return valid;
+}
+
+// The game never bounds-checks a move; it relies on the outer wall. So a
+// maze is only usable if its whole border is wall and the player starts on
+// an open cell. Reads the border and nothing else.
+static bool validTiles(const char* tiles, std::size_t width, std::size_t height) {
+    for (std::size_t x = 0; x < width; ++x) {
+        if (tiles[x] != '#' || tiles[(height - 1) * width + x] != '#') {
+            return false;
+        }
+    }
+    for (std::size_t y = 1; y < height - 1; ++y) {
+        if (tiles[y * width] != '#' || tiles[y * width + width - 1] != '#') {
+            return false;
+        }
+    }
+    return tiles[width + 1] == ' ';
+}
+
+static MazeFileHeader makeHeader(const World& world, std::uint32_t magic) {
+    MazeFileHeader header = {};
+    header.magic = magic;
+    header.version = mazeFileVersion;
+    header.headerSize = sizeof(MazeFileHeader);
+    header.width = world.width;
+    header.height = world.height;
+    header.seed = world.seed;
+    header.exitX = world.exitX;
+    header.exitY = world.exitY;
+    header.powerUpX = world.powerUpActive ? world.powerUpX : -1;
+    header.powerUpY = world.powerUpActive ? world.powerUpY : -1;
+    header.purpleBlockCount = static_cast<std::uint32_t>(world.purpleBlocks.size());
+    for (std::size_t i = 0; i < world.purpleBlocks.size(); ++i) {
+        header.purpleBlocks[i][0] = world.purpleBlocks[i].first;
+        header.purpleBlocks[i][1] = world.purpleBlocks[i].second;
+    }
+    return header;
+}
+
+// Everything startLevel does after the maze exists, driven by the file header.
+// False if the enemy has nowhere to start.
+static bool startLevelFromHeader(World& world, const MazeFileHeader& header) {
+    world.seed = header.seed;
+    world.rng.reseed(world.seed);
+    world.gameRng.reseed(~static_cast<std::uint64_t>(world.seed));
+
+    world.playerX = 1;
+    world.playerY = 1;
+    world.exitX = header.exitX;
+    world.exitY = header.exitY;
+
+    world.purpleBlocks.bind(world.arena, purpleBlockCount);
+    for (std::uint32_t i = 0; i < header.purpleBlockCount; ++i) {
+        world.purpleBlocks.push_back({ header.purpleBlocks[i][0], header.purpleBlocks[i][1] });
+    }
+    world.powerUpX = header.powerUpX;
+    world.powerUpY = header.powerUpY;
+    world.powerUpActive = header.powerUpX >= 0;
+
+    if (!placeEnemy(world)) {
+        return false;
+    }
+    world.levelTicks = 0;
+    world.timeLimit = levelTimeLimit;
+    world.puzzleFailed = false;
+    return true;
+}
+
+MappedMazeFile::~MappedMazeFile() {
+    close();
+}
+
+bool MappedMazeFile::open(const std::string& filename) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(MazeFileHeader))) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    base = view;
+    length = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(MazeFileHeader))) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    base = view;
+    length = static_cast<std::size_t>(info.st_size);
+#endif
+
+    // Only the header page and the maze's border are touched here
+    const MazeFileHeader& h = header();
+    std::uint64_t cells = static_cast<std::uint64_t>(h.width) * static_cast<std::uint64_t>(h.height);
+    // Offsets come from the file, so no sum here may wrap
+    bool valid = validHeader(h, mazeFileMagic) && h.tilesOffset <= length && cells <= length - h.tilesOffset
+        && (h.distancesOffset == 0 || (h.distancesOffset % sizeof(std::uint32_t) == 0 && h.distancesOffset <= length
+            && cells <= (length - h.distancesOffset) / sizeof(std::uint32_t)))
+        && validTiles(tiles(), h.width, h.height);
+    if (!valid) {
+        close();
+    }
+    return valid;
+}
+
+void MappedMazeFile::close() {
+    if (!base) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+    mappingHandle = fileHandle = nullptr;
+#else
+    munmap(base, length);
+#endif
+    base = nullptr;
+    length = 0;
+}
+
+const std::uint32_t* MappedMazeFile::distances() const {
+    if (header().distancesOffset == 0) {
+        return nullptr;
+    }
+    return reinterpret_cast<const std::uint32_t*>(static_cast<const char*>(base) + header().distancesOffset);
+}
+
+bool writeMazeFile(const World& world, const std::string& filename, bool withDistanceField) {
+    std::uint64_t cells = world.maze.size();
+
+    MazeFileHeader header = makeHeader(world, mazeFileMagic);
+    header.tilesOffset = alignUp(sizeof(MazeFileHeader));
+    std::uint64_t end = header.tilesOffset + cells;
+    if (withDistanceField) {
+        header.distancesOffset = alignUp(end);
+        end = header.distancesOffset + cells * sizeof(std::uint32_t);
+    }
+
+    std::vector<char> buffer(static_cast<std::size_t>(end), 0);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    std::memcpy(buffer.data() + header.tilesOffset, world.maze.data(), static_cast<std::size_t>(cells));
+    if (withDistanceField) {
+        buildDistanceField(world, world.exitX, world.exitY, reinterpret_cast<std::uint32_t*>(buffer.data() + header.distancesOffset));
+    }
+    return writeFileAtomically(filename, buffer.data(), buffer.size());
+}
+
+bool writeCompressedMazeFile(const World& world, const std::string& filename) {
+    MazeFileHeader header = makeHeader(world, compressedMazeFileMagic);
+    header.tilesOffset = sizeof(MazeFileHeader);
+
+    std::vector<char> buffer(sizeof(MazeFileHeader));
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    compressGrid(world.maze.data(), world.maze.size(), '#', ' ', buffer);
+    return writeFileAtomically(filename, buffer.data(), buffer.size());
+}
+
+static bool loadCompressedMazeFile(World& world, const std::string& filename) {
+    std::ifstream infile(filename, std::ios::binary | std::ios::ate);
+    std::streamsize size = infile ? static_cast<std::streamsize>(infile.tellg()) : 0;
+    if (size < static_cast<std::streamsize>(sizeof(MazeFileHeader))) {
+        return false;
+    }
+    std::vector<char> buffer(static_cast<std::size_t>(size));
+    infile.seekg(0);
+    if (!infile.read(buffer.data(), size)) {
+        return false;
+    }
+    MazeFileHeader header;
+    std::memcpy(&header, buffer.data(), sizeof(header));
+    if (!validHeader(header, compressedMazeFileMagic) || header.tilesOffset >= buffer.size()) {
+        return false;
+    }
+
+    world.width = header.width;
+    world.height = header.height;
+    resetLevelArena(world);
+    std::size_t tileBytes = buffer.size() - static_cast<std::size_t>(header.tilesOffset);
+    if (decompressGrid(buffer.data() + header.tilesOffset, tileBytes, world.maze.data(), world.maze.size(), '#', ' ') == 0
+        || !validTiles(world.maze.data(), world.width, world.height)) {
+        return false;
+    }
+    return startLevelFromHeader(world, header);
+}
+
+bool loadMazeFile(World& world, const std::string& filename) {
+    PROFILE_ZONE("loadMazeFile");
+    MemoryTagScope memoryTag(MemoryTag::Maze);
+    auto file = std::make_shared<MappedMazeFile>();
+    if (!file->open(filename)) {
+        return loadCompressedMazeFile(world, filename);
+    }
+    const MazeFileHeader& header = file->header();
+
+    // Like startLevel, except the maze is the mapped tile section instead of a generated one
+    world.arena.reset();
+    ++world.arenaEpoch;
+    world.maze.view(file->tiles(), header.width, header.height);
+    world.mazeMapping = file;
+    world.width = header.width;
+    world.height = header.height;
+    return startLevelFromHeader(world, header);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct World;
+
+// Prebuilt maze file ("MZMF"), laid out so it can be memory-mapped and used
+// in place: the tile section is byte-for-byte the in-memory maze grid and
+// the optional distance section is a row-major uint32 walking distance to
+// the exit. Both sections start on a page boundary.
+//
+// The compressed variant ("MZMZ") shares the header, but its tile section
+// is compressGrid output running to the end of the file and it has no
+// distance field. It is much smaller but has to be decoded on load.
+const std::uint32_t mazeFileMagic = 0x464d5a4d;           // "MZMF"
+const std::uint32_t compressedMazeFileMagic = 0x5a4d5a4d; // "MZMZ"
+const std::uint16_t mazeFileVersion = 1;
+const std::uint64_t mazeFileAlignment = 4096;
+
+struct MazeFileHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t headerSize;
+    std::int32_t width, height;
+    std::uint32_t seed;
+    std::int32_t exitX, exitY;
+    std::int32_t powerUpX, powerUpY;
+    std::uint32_t purpleBlockCount;
+    std::int32_t purpleBlocks[2][2];
+    std::uint64_t tilesOffset;
+    std::uint64_t distancesOffset; // 0 when the file has no distance field
+};
+
+// Read-only file mapped copy-on-write: writes through tiles() (e.g. a solved
+// purple block) stay private to this process and never reach the file.
+class MappedMazeFile {
+public:
+    MappedMazeFile() = default;
+    ~MappedMazeFile();
+
+    MappedMazeFile(const MappedMazeFile&) = delete;
+    MappedMazeFile& operator=(const MappedMazeFile&) = delete;
+
+    // Maps the file and validates its header; no tile data is read
+    bool open(const std::string& filename);
+    void close();
+
+    const MazeFileHeader& header() const { return *static_cast<const MazeFileHeader*>(base); }
+    char* tiles() { return static_cast<char*>(base) + header().tilesOffset; }
+    const std::uint32_t* distances() const;
+
+private:
+    void* base = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+// Write the world's current level as a maze file, optionally with a distance field to the exit
+bool writeMazeFile(const World& world, const std::string& filename, bool withDistanceField);
+bool writeCompressedMazeFile(const World& world, const std::string& filename);
+
+// Start a level on a maze file. A plain file is mapped and its tiles are
+// paged in on first access, so apart from reading the border this costs the
+// same for a 21x21 maze as for a 20000x20000 one; a compressed file is
+// decoded into the level arena. False if the file is unreadable, its border
+// is not all wall, the start (1, 1) is not open or the enemy has no room.
+bool loadMazeFile(World& world, const std::string& filename);
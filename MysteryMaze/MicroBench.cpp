@@ -0,0 +1,424 @@
+// Microbenchmarks of the simulation's hot functions, as a program of their
+// own so they run without a window or SFML. Results are JSON, one entry per
+// benchmark, for tracking over time:
+//
+//   { "min_ms": ..., "repeats": ..., "benchmarks": [
+//     { "name": "generateMaze/101", "iterations": ..., "ns_per_op": ...,
+//       "cells_per_second": ..., "allocs_per_op": ..., "p99_ns": ...,
+//       "samples_ns_per_op": [...], "samples_p99_ns": [...] } ] }
+//
+// Each benchmark is run repeats times for at least min_ms of timed work;
+// ns_per_op, cells_per_second and p99_ns are the median repeat, and every
+// repeat's ns_per_op and p99_ns are listed so the spread can be judged.
+// p99_ns is of one run of the benchmark: one maze, one frame, one save.
+// cells_per_second is 0 for benchmarks that do not work on the grid. Setup
+// such as building a level is left out of the timing and of the
+// allocation count.
+//
+// With --baseline the results are held against an earlier run instead of
+// printed (see BenchGate.h), and the exit code is 1 if anything tracked
+// regressed. The checked-in baseline is bench_baseline.json; after a change
+// that is meant to move the numbers, record a new one on the release build
+// machine with --out bench_baseline.json.
+//
+// Windows: the MysteryMazeBench project in the solution. Linux, from this folder:
+//   g++ -std=c++14 -O2 -pthread MicroBench.cpp BenchGate.cpp World.cpp LevelArena.cpp SaveGame.cpp
+//       GridCodec.cpp MazeFile.cpp Profiler.cpp AllocationCounter.cpp HudText.cpp Histogram.cpp
+//       RaceBot.cpp -o microbench
+//
+//   microbench [--filter <text>] [--min-ms <n>] [--repeats <n>] [--out <file>]
+//              [--baseline <file> [--tolerance <percent>]]
+#include "World.h"
+#include "SaveGame.h"
+#include "HudText.h"
+#include "AllocationCounter.h"
+#include "BenchGate.h"
+#include "Histogram.h"
+#include "RaceBot.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Keeps results the optimizer would otherwise throw away
+    volatile std::uint64_t sink = 0;
+
+    // Brackets the part of a benchmark being measured; it may be started and
+    // stopped several times per run
+    class Stopwatch {
+    public:
+        void start() {
+            allocationsAtStart = allocationCount();
+            began = Clock::now();
+        }
+
+        void stop() {
+            elapsed += Clock::now() - began;
+            allocations += allocationCount() - allocationsAtStart;
+        }
+
+        Clock::duration elapsed = Clock::duration::zero();
+        std::uint64_t allocations = 0;
+
+    private:
+        Clock::time_point began;
+        std::uint64_t allocationsAtStart = 0;
+    };
+
+    // What one run of a benchmark did: the operations it timed, and the maze cells they covered
+    struct Work {
+        std::uint64_t ops = 0;
+        std::uint64_t cells = 0;
+    };
+
+    struct Benchmark {
+        std::string name;
+        std::function<Work(Stopwatch&)> run;
+    };
+
+    const std::uint32_t benchSeed = 12345;
+
+    // A level of size x size from benchSeed, built as startLevel builds it
+    // up to but not including step; Done builds all of it
+    void buildLevelBefore(World& world, int size, LevelStep step) {
+        world.width = size;
+        world.height = size;
+        world.seed = benchSeed;
+        if (step == LevelStep::Done) {
+            startLevel(world);
+        }
+        else {
+            buildLevel(world, step);
+        }
+    }
+
+    // Each benchmark has worlds of its own, kept for the whole program so
+    // their arenas are warm and no run pays for building one
+    std::vector<std::unique_ptr<World>> worlds;
+
+    World* newWorld() {
+        worlds.emplace_back(new World());
+        worlds.back()->showMessages = false;
+        return worlds.back().get();
+    }
+
+    std::uint64_t cellsOf(const World& world) {
+        return static_cast<std::uint64_t>(world.width) * world.height;
+    }
+
+    std::vector<Benchmark> allBenchmarks() {
+        std::vector<Benchmark> benchmarks;
+
+        for (int size : { 21, 101, 401, 1001 }) {
+            World* w = newWorld();
+            benchmarks.push_back({ "generateMaze/" + std::to_string(size), [w, size](Stopwatch& watch) {
+                buildLevelBefore(*w, size, LevelStep::Generate);
+                watch.start();
+                generateMaze(*w, 1, 1);
+                watch.stop();
+                return Work{ 1, cellsOf(*w) };
+            } });
+        }
+
+        const int placeSize = 101;
+        struct Placement {
+            const char* name;
+            LevelStep step;
+            void (*place)(World&);
+        };
+        const Placement placements[] = {
+            { "placePurpleBlocks", LevelStep::PurpleBlocks, placePurpleBlocks },
+            { "placePowerUp", LevelStep::PowerUp, placePowerUp },
+            { "placeEnemy", LevelStep::Enemy, [](World& world) { placeEnemy(world); } },
+        };
+        for (const Placement& placement : placements) {
+            World* w = newWorld();
+            benchmarks.push_back({ placement.name + std::string("/") + std::to_string(placeSize), [w, placement, placeSize](Stopwatch& watch) {
+                buildLevelBefore(*w, placeSize, placement.step);
+                watch.start();
+                placement.place(*w);
+                watch.stop();
+                return Work{ 1, 0 };
+            } });
+        }
+
+        // The enemy's whole search of a level, from its start until it has
+        // backtracked all the way; the op is one move
+        for (int size : { 21, 101 }) {
+            World* w = newWorld();
+            benchmarks.push_back({ "Enemy::move/" + std::to_string(size), [w, size](Stopwatch& watch) {
+                buildLevelBefore(*w, size, LevelStep::Done);
+                std::uint64_t moves = 0;
+                watch.start();
+                while (!w->enemy.backtrackStack.empty()) {
+                    w->enemy.move(*w, w->gameRng);
+                    ++moves;
+                }
+                watch.stop();
+                sink = sink + static_cast<std::uint64_t>(w->enemy.x);
+                return Work{ moves, 0 };
+            } });
+        }
+
+        // Every cell of the grid asked in turn; the op is one isWalkable call
+        for (int size : { 101, 401 }) {
+            World* w = newWorld();
+            buildLevelBefore(*w, size, LevelStep::Done);
+            benchmarks.push_back({ "isWalkable/" + std::to_string(size), [w](Stopwatch& watch) {
+                std::uint64_t walkable = 0;
+                watch.start();
+                for (int y = 0; y < w->height; ++y) {
+                    for (int x = 0; x < w->width; ++x) {
+                        walkable += isWalkable(*w, x, y) ? 1 : 0;
+                    }
+                }
+                watch.stop();
+                sink = sink + walkable;
+                return Work{ cellsOf(*w), cellsOf(*w) };
+            } });
+        }
+
+        for (int size : { 101, 401, 1001 }) {
+            World* w = newWorld();
+            buildLevelBefore(*w, size, LevelStep::Done);
+            auto distances = std::make_shared<std::vector<std::uint32_t>>(cellsOf(*w));
+            benchmarks.push_back({ "buildDistanceField/" + std::to_string(size), [w, distances](Stopwatch& watch) {
+                watch.start();
+                buildDistanceField(*w, w->exitX, w->exitY, distances->data());
+                watch.stop();
+                sink = sink + (*distances)[w->width + 1];
+                return Work{ 1, cellsOf(*w) };
+            } });
+        }
+
+        // Saving and loading back again, in memory for each format, and
+        // through a file as a save from the menu does
+        const int saveSize = 101;
+        struct Format {
+            const char* name;
+            SaveMode mode;
+        };
+        const Format formats[] = { { "FullGrid", SaveMode::FullGrid }, { "SeedDelta", SaveMode::SeedDelta } };
+        for (const Format& format : formats) {
+            World* from = newWorld();
+            World* to = newWorld();
+            buildLevelBefore(*from, saveSize, LevelStep::Done);
+            auto buffer = std::make_shared<std::vector<char>>();
+            SaveMode mode = format.mode;
+            benchmarks.push_back({ "saveRoundTrip" + std::string(format.name) + "/" + std::to_string(saveSize), [from, to, buffer, mode](Stopwatch& watch) {
+                watch.start();
+                serializeWorld(*from, *buffer, mode);
+                bool loaded = deserializeWorld(*to, buffer->data(), buffer->size());
+                watch.stop();
+                sink = sink + (loaded ? 1 : 0);
+                return Work{ 1, cellsOf(*from) };
+            } });
+        }
+        {
+            World* from = newWorld();
+            World* to = newWorld();
+            buildLevelBefore(*from, saveSize, LevelStep::Done);
+            benchmarks.push_back({ "saveLoadFile/" + std::to_string(saveSize), [from, to](Stopwatch& watch) {
+                watch.start();
+                bool loaded = saveWorld(*from, "microbench_save.dat") && loadWorld(*to, "microbench_save.dat");
+                watch.stop();
+                sink = sink + (loaded ? 1 : 0);
+                return Work{ 1, cellsOf(*from) };
+            } });
+        }
+
+        // A frame of play without the drawing: a bot's move through stepWorld,
+        // then the timer text brought up to date as updateTimerText does. The
+        // op is a frame, so p99_ns is the 99th percentile frame.
+        {
+            const int frameSize = 101;
+            World* w = newWorld();
+            buildLevelBefore(*w, frameSize, LevelStep::Done);
+            w->answerPuzzle = [](const AdditionQuestion& question) { return question.correctAnswer; };
+            struct Player {
+                std::vector<std::uint32_t> toExit;
+                Rng input{ benchSeed };
+                int shownSeconds = -1;
+                std::string timer;
+            };
+            auto player = std::make_shared<Player>();
+            benchmarks.push_back({ "frame/" + std::to_string(frameSize), [w, player, frameSize](Stopwatch& watch) {
+                watch.start();
+                char move = botMove(*w, player->toExit, player->input);
+                TickResult result = stepWorld(*w, &move, move ? 1 : 0);
+                float timeLeft = remainingTime(*w);
+                if (static_cast<int>(timeLeft) != player->shownSeconds) {
+                    player->shownSeconds = static_cast<int>(timeLeft);
+                    player->timer = timerString(timeLeft);
+                }
+                watch.stop();
+                if (result != TickResult::Playing) {
+                    buildLevelBefore(*w, frameSize, LevelStep::Done);
+                    player->toExit.clear();
+                    player->shownSeconds = -1;
+                }
+                return Work{ 1, 0 };
+            } });
+        }
+
+        // The level timer's text for every value it shows, as updateTimerText builds it
+        benchmarks.push_back({ "timerString", [](Stopwatch& watch) {
+            std::uint64_t length = 0;
+            watch.start();
+            for (int seconds = 0; seconds <= static_cast<int>(levelTimeLimit); ++seconds) {
+                length += timerString(static_cast<float>(seconds)).size();
+            }
+            watch.stop();
+            sink = sink + length;
+            return Work{ static_cast<std::uint64_t>(levelTimeLimit) + 1, 0 };
+        } });
+
+        return benchmarks;
+    }
+
+    double median(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        std::size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+    }
+
+    // Runs until minMs of timed work, or until four times that has gone by
+    // when setup dwarfs the timed part, and at least once either way
+    BenchResult measure(const Benchmark& benchmark, int minMs, int repeats) {
+        BenchResult result;
+        result.name = benchmark.name;
+        std::vector<double> cellRates;
+        std::uint64_t allOps = 0;
+        std::uint64_t allAllocations = 0;
+        Histogram runs;
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            Stopwatch watch;
+            Work total;
+            runs.clear();
+            Clock::time_point began = Clock::now();
+            do {
+                Clock::duration before = watch.elapsed;
+                Work work = benchmark.run(watch);
+                auto runNs = std::chrono::duration_cast<std::chrono::nanoseconds>(watch.elapsed - before).count();
+                runs.record(static_cast<std::uint32_t>(std::min<long long>(runNs, UINT32_MAX)));
+                total.ops += work.ops;
+                total.cells += work.cells;
+                ++result.iterations;
+            } while (watch.elapsed < std::chrono::milliseconds(minMs) && Clock::now() - began < std::chrono::milliseconds(4 * minMs));
+
+            double ns = std::chrono::duration<double, std::nano>(watch.elapsed).count();
+            result.nsPerOpSamples.push_back(total.ops ? ns / total.ops : 0.0);
+            result.p99Samples.push_back(runs.percentile(0.99));
+            cellRates.push_back(ns > 0.0 ? total.cells / (ns / 1e9) : 0.0);
+            allOps += total.ops;
+            allAllocations += watch.allocations;
+        }
+        result.nsPerOp = median(result.nsPerOpSamples);
+        result.p99Ns = median(result.p99Samples);
+        result.cellsPerSecond = median(cellRates);
+        result.allocsPerOp = allOps ? static_cast<double>(allAllocations) / allOps : 0.0;
+        return result;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::string outFile;
+    std::string baselineFile;
+    double tolerance = gateMinimumChange;
+    int minMs = 200;
+    int repeats = 5;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        }
+        else if (arg == "--min-ms" && hasValue) {
+            minMs = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--repeats" && hasValue) {
+            repeats = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--out" && hasValue) {
+            outFile = argv[++i];
+        }
+        else if (arg == "--baseline" && hasValue) {
+            baselineFile = argv[++i];
+        }
+        else if (arg == "--tolerance" && hasValue) {
+            tolerance = std::max(0.0, std::atof(argv[++i]) / 100.0);
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--filter <text>] [--min-ms <n>] [--repeats <n>] [--out <file>]"
+                " [--baseline <file> [--tolerance <percent>]]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::vector<Benchmark> benchmarks = allBenchmarks();
+    std::vector<BenchResult> results;
+    for (const Benchmark& benchmark : benchmarks) {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        std::cerr << benchmark.name << "..." << std::endl;
+        results.push_back(measure(benchmark, minMs, repeats));
+    }
+
+    bool regressed = false;
+    if (!baselineFile.empty()) {
+        std::vector<BenchResult> baseline;
+        if (!readBenchResults(baselineFile, baseline)) {
+            std::cerr << "Could not read baseline " << baselineFile << std::endl;
+            return 2;
+        }
+        std::vector<GateRow> rows = compareBenchResults(baseline, results, tolerance);
+
+        // A regression has to show up twice, so one bad moment on a busy
+        // machine does not fail the gate
+        if (anyRegressed(rows)) {
+            for (BenchResult& result : results) {
+                bool again = std::any_of(rows.begin(), rows.end(), [&result](const GateRow& row) {
+                    return row.name == result.name && row.status == GateStatus::Regressed;
+                });
+                for (const Benchmark& benchmark : benchmarks) {
+                    if (again && benchmark.name == result.name) {
+                        std::cerr << benchmark.name << " again..." << std::endl;
+                        result = measure(benchmark, minMs, repeats);
+                    }
+                }
+            }
+            rows = compareBenchResults(baseline, results, tolerance);
+        }
+        printGateTable(std::cout, rows);
+        regressed = anyRegressed(rows);
+        std::cout << (regressed ? "Regressed against " : "No regressions against ") << baselineFile << std::endl;
+    }
+    std::remove("microbench_save.dat");
+
+    if (outFile.empty()) {
+        if (baselineFile.empty()) {
+            writeBenchResults(std::cout, results, minMs, repeats);
+        }
+    }
+    else {
+        std::ofstream out(outFile);
+        writeBenchResults(out, results, minMs, repeats);
+        if (!out) {
+            std::cerr << "Could not write " << outFile << std::endl;
+            return 2;
+        }
+    }
+    return regressed ? 1 : 0;
+}
@@ -11,6 +11,30 @@
 #include <fstream>
 #include <filesystem>
 #include <iostream>
+#include <array>
+#include <memory>
+#include <thread>
+#include "AllocationCounter.h"
+#include "World.h"
+#include "SaveGame.h"
+#include "AutoSave.h"
+#include "SaveCatalog.h"
+#include "Replay.h"
+#include "Ghost.h"
+#include "RaceHost.h"
+#include "RaceClient.h"
+#include "LoadTest.h"
+#include "RoomServer.h"
+#include "Lockstep.h"
+#include "NetworkEmulator.h"
+#include "Spectator.h"
+#include "Profiler.h"
+#include "MazeFile.h"
+#include "Benchmarks.h"
+#include "FileChecks.h"
+#include "HudText.h"
+#include "PerfOverlay.h"
+#include "SessionStats.h"
 
 //#define DEFINE_FIELD(fieldname, value_t, obis, field_t, field_args) \
 //  struct fieldname : field_t<fieldname, ##field_args> { \
@@ -26,132 +50,400 @@
 //  }
 
 
-// Global game timer
-sf::Clock gameTimer;
-float timeLimit = 120.0f;  // 2 minutes in seconds
+// Tile size in pixels
+int tile_size = 32;
+const int minTileSize = 8; // Below this the camera follows the player instead of shrinking tiles further
 
-// Constants for maze dimensions and tile size
-int height = 21;     // Maze width
-int width = 21;    // Maze height
-int tile_size = 32; // Tile size in pixels
-int level = 1;
-//GameState loadedState;
+// The running game: maze, player, enemy, timer
+World world;
 
-// Directions for maze carving (up, right, down, left)
-const std::vector<std::pair<int, int>> DIRECTIONS = {
-    {0, -1},  // Up
-    {1, 0},   // Right
-    {0, 1},   // Down
-    {-1, 0}   // Left
-};
+// Draw calls made so far this frame, for the performance overlay
+DrawCounts frameDraws;
 
-// Maze grid represented as a 2D character array
-std::vector<std::vector<char>> maze(height, std::vector<char>(width, '#'));
 
+// Function declarations
+void drawCounted(sf::RenderWindow& window, const sf::Shape& shape);
+void drawMaze(sf::RenderWindow& window, sf::RectangleShape& wall, sf::RectangleShape& emptySpace, sf::RectangleShape& playerShape, sf::RectangleShape& enemyShape, sf::RectangleShape& exitShape, sf::RectangleShape& purpleBlockShape, sf::RectangleShape& powerUpShape, sf::RectangleShape& ghostShape, const std::vector<sf::Vector2i>& rivals, Enemy& enemy, sf::Text& timerText);
+void showMenu();
+bool startGame();
+void updateTimerText(sf::Text& timerText);
+void showPostLevelMenu();
+void prepareNextLevel();
+void readLevelAndTimer(std::ifstream& infile);
+void writeLevelAndTimer(std::ofstream& outfile);
+int firstFreeSlot(SaveCatalog& catalog);
+int loadGame(SaveCatalog& catalog);
+void fitTileSize();
+void announceRace(bool started, int countdown, const std::vector<RacerState>& racers, int localId, bool over);
+bool levelCompleted = false;
 
-// Player and exit positions
-int playerX = 1, playerY = 1;
-int exitX = width - 2, exitY = height - 2;
+int main(int argc, char* argv[]) {
+    nameProfilerThread("main");
 
-// Obstacle positions (purple blocks)
-std::vector<std::pair<int, int>> purpleBlocks;
+    // Developer benchmarks run headless and skip the game entirely
+    if (argc > 1 && std::string(argv[1]) == "--bench-saves") {
+        runSaveBenchmark(std::cout);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-compression") {
+        runCompressionBenchmark(std::cout);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-rollback") {
+        return runRollbackBenchmark(std::cout) ? 0 : 1;
+    }
 
-// Power-up position
-int powerUpX = -1, powerUpY = -1;
-bool powerUpActive = false;  // Whether the power-up is active
-sf::Clock powerUpClock;      // Timer for power-up effects
+    // Race bandwidth on loopback: --bench-race [clients] [seconds] [lag ms] [maze size]
+    if (argc > 1 && std::string(argv[1]) == "--bench-race") {
+        int clients = argc > 2 ? std::atoi(argv[2]) : 3;
+        int seconds = argc > 3 ? std::max(1, std::atoi(argv[3])) : 30;
+        std::uint32_t lagMs = argc > 4 ? static_cast<std::uint32_t>(std::max(0, std::atoi(argv[4]))) : 0;
+        int mazeSize = argc > 5 ? std::atoi(argv[5]) : firstLevelSize;
+        return runRaceBenchmark(std::cout, clients, seconds, lagMs, mazeSize) ? 0 : 1;
+    }
 
+    // Race and lockstep behind each network profile, reproducibly: --bench-netcode [clients] [seconds] [seed]
+    if (argc > 1 && std::string(argv[1]) == "--bench-netcode") {
+        int clients = argc > 2 ? std::atoi(argv[2]) : 3;
+        int seconds = argc > 3 ? std::max(1, std::atoi(argv[3])) : 30;
+        std::uint64_t seed = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1;
+        return runNetcodeBenchmark(std::cout, clients, seconds, seed) ? 0 : 1;
+    }
 
-class Enemy {
-public:
-    int x, y;
-    sf::Clock moveClock; // Controls movement speed
-    sf::Clock powerUpClock; // Tracks power-up freeze duration
-    std::set<std::pair<int, int>> visited; // Tracks visited cells
-    std::stack<std::pair<int, int>> backtrackStack; // For DFS backtracking
+    // Broadcast to growing numbers of spectators on loopback: --bench-spectators [max] [per step] [seconds]
+    if (argc > 1 && std::string(argv[1]) == "--bench-spectators") {
+        int spectators = argc > 2 ? std::atoi(argv[2]) : 4000;
+        int step = argc > 3 ? std::atoi(argv[3]) : 1000;
+        int seconds = argc > 4 ? std::max(1, std::atoi(argv[4])) : 5;
+        return runSpectatorBenchmark(std::cout, spectators, step, seconds) ? 0 : 1;
+    }
 
-    Enemy(int startX, int startY) : x(startX), y(startY) {
-        visited.insert({ x, y });
-        backtrackStack.push({ x, y });
-        srand(static_cast<unsigned>(time(0))); // Seed random number generator
+    // Lockstep traffic on loopback at several maze sizes: --bench-lockstep [peers] [seconds]
+    if (argc > 1 && std::string(argv[1]) == "--bench-lockstep") {
+        int peers = argc > 2 ? std::atoi(argv[2]) : 4;
+        int seconds = argc > 3 ? std::max(1, std::atoi(argv[3])) : 30;
+        return runLockstepBenchmark(std::cout, peers, seconds) ? 0 : 1;
     }
 
-    void move();
-};
-struct AdditionQuestion {
-    int num1;
-    int num2;
-    int correctAnswer;
+    // Damaged and hostile save and maze files the loaders must turn away: --check-files
+    if (argc > 1 && std::string(argv[1]) == "--check-files") {
+        return runFileChecks(std::cout) ? 0 : 1;
+    }
 
-    std::string toString() const {
-        return "What is " + std::to_string(num1) + " + " + std::to_string(num2) + "? ";
+    // Live heap bytes per memory tag over many level changes: --soak-memory [levels] [repeats]
+    if (argc > 1 && std::string(argv[1]) == "--soak-memory") {
+        int levels = argc > 2 ? std::atoi(argv[2]) : 50;
+        int repeats = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+        return runMemorySoak(std::cout, levels, repeats) ? 0 : 1;
     }
-};
-struct GameState {
-    int playerX;
-    int playerY;
-    int level;
-    // Add other relevant game state variables
-};
 
+    // Headless dedicated server: --server <port> [rooms] [racers per room] [threads] [seconds]
+    if (argc > 2 && std::string(argv[1]) == "--server") {
+        unsigned short port = static_cast<unsigned short>(std::atoi(argv[2]));
+        int rooms = argc > 3 ? std::max(1, std::atoi(argv[3])) : 100;
+        int racers = argc > 4 ? std::atoi(argv[4]) : 4;
+        unsigned threads = argc > 5 ? static_cast<unsigned>(std::max(1, std::atoi(argv[5]))) : std::max(1u, std::thread::hardware_concurrency());
+        double seconds = argc > 6 ? std::atof(argv[6]) : 0.0;
+        RoomServer server(rooms, racers, threads - 1, firstLevelSize);
+        if (!server.listen(port)) {
+            std::cout << "Unable to listen on port " << port << std::endl;
+            return 1;
+        }
+        std::cout << "Serving " << rooms << " rooms of " << racers << " on port " << server.port()
+                  << " with " << server.threads() << " threads" << std::endl;
+        server.run(std::cout, seconds);
+        return 0;
+    }
 
+    // Bot clients against an in-process server, ramping up:
+    // --load-test [max clients] [clients per step] [seconds per step] [racers per room] [threads]
+    if (argc > 1 && std::string(argv[1]) == "--load-test") {
+        int clients = argc > 2 ? std::max(1, std::atoi(argv[2])) : 400;
+        int step = argc > 3 ? std::max(1, std::atoi(argv[3])) : 50;
+        double seconds = argc > 4 ? std::max(1.0, std::atof(argv[4])) : 5.0;
+        int racers = argc > 5 ? std::atoi(argv[5]) : 4;
+        unsigned threads = argc > 6 ? static_cast<unsigned>(std::max(1, std::atoi(argv[6]))) : std::max(1u, std::thread::hardware_concurrency() / 2);
+        return runLoadTest(std::cout, clients, step, seconds, racers, threads) ? 0 : 1;
+    }
 
+    // Re-run a recorded game headlessly: --replay <file> [repeats]
+    if (argc > 2 && std::string(argv[1]) == "--replay") {
+        return runReplayBenchmark(std::cout, argv[2], argc > 3 ? std::max(1, std::atoi(argv[3])) : 1) ? 0 : 1;
+    }
 
-// Function declarations
-void initializeMaze();
-void generateMaze(int startX, int startY);
-void placePurpleBlocks();
-void drawMaze(sf::RenderWindow& window, sf::RectangleShape& wall, sf::RectangleShape& emptySpace, sf::RectangleShape& playerShape, sf::RectangleShape& enemyShape, sf::RectangleShape& exitShape, sf::RectangleShape& purpleBlockShape, Enemy& enemy, sf::Text& timerText);
-void movePlayer(char direction);
-bool isExitReached();
-bool isWalkable(int x, int y);
-void showMenu();
-bool startGame();
-bool isTooCloseToPlayer(int enemyX, int enemyY);
-bool checkPurpleBlockInteraction(int x, int y);
-void updateTimerText(sf::Text& timerText);
-void placePowerUp();
-void collectPowerUp();
-void showPostLevelMenu();
-void prepareNextLevel();
-AdditionQuestion generateRandomAdditionQuestion();
-void readLevelAndTimer(std::ifstream& infile);
-void writeLevelAndTimer(std::ofstream& outfile);
-void saveGame(const GameState& gameState, const std::string& filename);
-bool loadGame(GameState& gameState, const std::string& filename);
-void saveGame();
-void loadGame();
-bool levelCompleted = false;
+    // Write a generated level as a prebuilt maze file: --export-maze <file> <size> [seed]
+    // A file name ending in .mzz gets the compressed format
+    if (argc > 3 && std::string(argv[1]) == "--export-maze") {
+        // generateMaze carves from odd cells, so an even size would open the outer wall
+        char* sizeEnd = nullptr;
+        long size = std::strtol(argv[3], &sizeEnd, 10);
+        if (sizeEnd == argv[3] || *sizeEnd != '\0' || size < 5 || size > 65535) {
+            std::cerr << "Maze size must be a number from 5 to 65535, not " << argv[3] << std::endl;
+            return 1;
+        }
+        world.width = world.height = static_cast<int>(size | 1);
+        world.seed = argc > 4 ? static_cast<std::uint32_t>(std::strtoul(argv[4], nullptr, 10)) : static_cast<std::uint32_t>(time(0));
+        startLevel(world);
+        std::string exportName = argv[2];
+        bool compressed = exportName.size() > 4 && exportName.compare(exportName.size() - 4, 4, ".mzz") == 0;
+        bool written = compressed ? writeCompressedMazeFile(world, exportName) : writeMazeFile(world, exportName, true);
+        std::cout << (written ? "Maze written to " : "Unable to write maze to ") << argv[2] << std::endl;
+        return written ? 0 : 1;
+    }
+
+    // --maze <file> plays a prebuilt maze, --record <file> records the game for --replay,
+    // --time-attack <seed> races the first level of a seed against the best run on it,
+    // --race-host <racers> hosts a race over the network, --race-join <address> joins one,
+    // --race-port <port> picks the port for either, and --race-lag <ms> adds that much
+    // round trip time to a joined race for trying it out on one machine.
+    // --net-profile <name> puts a whole emulated link (lan, broadband, wifi, mobile,
+    // satellite or congested) under either kind of joined race, drawn from --net-seed <n>.
+    // --lockstep-host <racers> and --lockstep-join <address> do the same for a lockstep race,
+    // where only inputs go over the network, also on --race-port.
+    // --broadcast <spectators> streams a single player game to that many spectators, and
+    // --spectate <address> watches one, both on --race-port as well.
+    // --profile <file> times the profiler's zones from the start and writes them there as
+    // a Chrome trace on exit; P starts or stops that at any time, into profile.json by default
+    std::string mazeFile;
+    std::string recordFile;
+    bool timeAttack = false;
+    std::uint32_t timeAttackSeed = 0;
+    int raceRacers = 0;
+    std::string raceAddress;
+    unsigned short racePort = defaultRacePort;
+    std::uint32_t raceLagMs = 0;
+    std::string netProfile;
+    std::uint64_t netSeed = 1;
+    int lockstepPeers = 0;
+    std::string lockstepAddress;
+    int broadcastSpectators = 0;
+    std::string spectateAddress;
+    std::string profileFile = "profile.json";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--maze") {
+            mazeFile = argv[i + 1];
+        }
+        else if (std::string(argv[i]) == "--record") {
+            recordFile = argv[i + 1];
+        }
+        else if (std::string(argv[i]) == "--time-attack") {
+            timeAttack = true;
+            timeAttackSeed = static_cast<std::uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        }
+        else if (std::string(argv[i]) == "--race-host") {
+            raceRacers = std::max(1, std::min(std::atoi(argv[i + 1]), maxRacers));
+        }
+        else if (std::string(argv[i]) == "--race-join") {
+            raceAddress = argv[i + 1];
+        }
+        else if (std::string(argv[i]) == "--race-port") {
+            racePort = static_cast<unsigned short>(std::atoi(argv[i + 1]));
+        }
+        else if (std::string(argv[i]) == "--race-lag") {
+            raceLagMs = static_cast<std::uint32_t>(std::max(0, std::atoi(argv[i + 1])));
+        }
+        else if (std::string(argv[i]) == "--net-profile") {
+            netProfile = argv[i + 1];
+        }
+        else if (std::string(argv[i]) == "--net-seed") {
+            netSeed = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (std::string(argv[i]) == "--lockstep-host") {
+            lockstepPeers = std::max(1, std::min(std::atoi(argv[i + 1]), maxRacers));
+        }
+        else if (std::string(argv[i]) == "--lockstep-join") {
+            lockstepAddress = argv[i + 1];
+        }
+        else if (std::string(argv[i]) == "--broadcast") {
+            broadcastSpectators = std::max(1, std::atoi(argv[i + 1]));
+        }
+        else if (std::string(argv[i]) == "--spectate") {
+            spectateAddress = argv[i + 1];
+        }
+        else if (std::string(argv[i]) == "--profile") {
+            profileFile = argv[i + 1];
+            enableProfiler(true);
+        }
+    }
+
+    NetworkConditions netConditions;
+    if (!netProfile.empty() && !findNetworkProfile(netProfile, netConditions)) {
+        std::cerr << "No network profile called " << netProfile << std::endl;
+        return 1;
+    }
+
+    // Racers and spectators share the maze by seed, and only the host's simulation of a race counts
+    bool racing = raceRacers > 0 || !raceAddress.empty() || lockstepPeers > 0 || !lockstepAddress.empty();
+    bool spectating = !racing && !spectateAddress.empty();
+    bool broadcasting = !racing && !spectating && broadcastSpectators > 0;
+    if (racing || spectating) {
+        mazeFile.clear();
+        recordFile.clear();
+        timeAttack = false;
+    }
+    if (broadcasting) {
+        mazeFile.clear();
+    }
 
-int main() {
     if (!startGame()) {
         return 0;
     }
 
 
-    srand(static_cast<unsigned int>(time(0))); // Initialize random seed for maze generation
-    initializeMaze();
-    generateMaze(1, 1); // Start maze generation from position (1, 1)
-
-    // Place purple blocks
-    placePurpleBlocks();
+    world.seed = static_cast<std::uint32_t>(time(0)); // Seed for the maze and everything random after it
+    if (timeAttack) {
+        world.seed = timeAttackSeed;
+        startLevel(world);
+    }
+    else if (!mazeFile.empty() && loadMazeFile(world, mazeFile)) {
+        fitTileSize();
+    }
+    else {
+        if (!mazeFile.empty()) {
+            std::cerr << "Unable to open maze file " << mazeFile << ", generating a maze instead" << std::endl;
+            world.width = world.height = firstLevelSize; // A rejected file may have left its size behind
+        }
+        startLevel(world); // Maze, purple blocks, power-up and enemy for level 1
+    }
 
-    placePowerUp();
+    // Saves on a background thread every few seconds and when J is pressed.
+    // Autosaves go to slot 0; J saves to this session's own slot.
+    SaveCatalog saveCatalog;
+    AutoSaver autoSaver(saveCatalog, SaveMode::SeedDelta, 5.0f);
+    int currentSlot = firstFreeSlot(saveCatalog);
+
+    // Time attack always records, and the run replaces the ghost if it is faster
+    Ghost ghost;
+    std::string ghostFile = "ghost_" + std::to_string(timeAttackSeed) + ".rpl";
+    std::uint32_t bestTicks = 0;
+    bool hasBest = false;
+    bool raceFinished = false;
+    if (timeAttack) {
+        recordFile = ghostFile + ".new";
+        hasBest = replayDuration(ghostFile, bestTicks) && ghost.open(ghostFile);
+        if (hasBest) {
+            std::cout << "Racing your best time of " << bestTicks * tickSeconds << " seconds" << std::endl;
+        }
+    }
 
+    // Frame and tick times for the report at the end
+    SessionStats session;
 
-    // Set initial enemy position
-    int enemyStartX = width - 3;
-    int enemyStartY = height - 3;
-    while (maze[enemyStartY][enemyStartX] == '#' || (enemyStartX == playerX && enemyStartY == playerY) || isTooCloseToPlayer(enemyStartX, enemyStartY)) {
-        enemyStartX = rand() % width;
-        enemyStartY = rand() % height;
+    // Records the starting world and every input, tick by tick
+    ReplayRecorder recorder;
+    if (!recordFile.empty()) {
+        if (recorder.open(recordFile)) {
+            recorder.recordSnapshot(world);
+        }
+        else {
+            std::cerr << "Unable to record to " << recordFile << std::endl;
+        }
+    }
+    world.answerPuzzle = [&recorder, &session](const AdditionQuestion& question) {
+        session.pause();
+        int answer = askPuzzleOnConsole(question);
+        recorder.recordAnswer(world.tick, answer);
+        return answer;
+    };
+
+    // The host simulates every racer; a client only mirrors what the host sends.
+    // In a lockstep race every peer simulates every racer.
+    MemoryTag untagged = setMemoryTag(MemoryTag::Network);
+    std::unique_ptr<RaceHost> raceHost;
+    std::unique_ptr<RaceClient> raceClient;
+    std::unique_ptr<LockstepPeer> lockstep;
+    if (lockstepPeers > 0) {
+        lockstep.reset(new LockstepPeer(world));
+        if (!lockstep->host(racePort, lockstepPeers)) {
+            std::cerr << "Unable to listen on port " << racePort << std::endl;
+            return 1;
+        }
+        std::cout << "Hosting a lockstep race for " << lockstepPeers << " racers on port " << racePort << std::endl;
+    }
+    else if (!lockstepAddress.empty()) {
+        lockstep.reset(new LockstepPeer(world));
+        if (!lockstep->join(lockstepAddress, racePort)) {
+            std::cerr << "Unable to open a network socket" << std::endl;
+            return 1;
+        }
+        lockstep->setNetworkConditions(netConditions, netConditions, netSeed);
+        std::cout << "Joining the lockstep race at " << lockstepAddress << ":" << racePort << "..." << std::endl;
+        while (!lockstep->welcomed() && !lockstep->timedOut()) {
+            lockstep->tick(nullptr, 0);
+            sf::sleep(sf::seconds(tickSeconds));
+        }
+        if (!lockstep->welcomed()) {
+            std::cerr << "No answer from the race host" << std::endl;
+            return 1;
+        }
+        fitTileSize();
+    }
+    else if (raceRacers > 0) {
+        raceHost.reset(new RaceHost(world, raceRacers));
+        if (!raceHost->listen(racePort)) {
+            std::cerr << "Unable to listen on port " << racePort << std::endl;
+            return 1;
+        }
+        std::cout << "Hosting a race for " << raceRacers << " racers on port " << racePort << std::endl;
+    }
+    else if (racing) {
+        raceClient.reset(new RaceClient(world));
+        if (!raceClient->connect(raceAddress, racePort)) {
+            std::cerr << "Unable to open a network socket" << std::endl;
+            return 1;
+        }
+        if (!netProfile.empty()) {
+            raceClient->setNetworkConditions(netConditions, netConditions, netSeed);
+        }
+        else {
+            raceClient->setLag(raceLagMs);
+        }
+        std::cout << "Joining the race at " << raceAddress << ":" << racePort << "..." << std::endl;
+        while (!raceClient->welcomed() && !raceClient->timedOut()) {
+            raceClient->tick(nullptr, 0);
+            sf::sleep(sf::seconds(tickSeconds));
+        }
+        if (!raceClient->welcomed()) {
+            std::cerr << "No answer from the race host" << std::endl;
+            return 1;
+        }
+        fitTileSize();
     }
-    Enemy enemy(enemyStartX, enemyStartY);
 
-    enemy.moveClock.restart(); // Reset move clock as soon as the enemy is created
+    // A spectator only mirrors the game it watches, which streams every tick it plays
+    std::unique_ptr<SpectatorBroadcaster> broadcaster;
+    std::unique_ptr<SpectatorClient> spectator;
+    if (broadcasting) {
+        broadcaster.reset(new SpectatorBroadcaster(broadcastSpectators));
+        if (!broadcaster->listen(racePort)) {
+            std::cerr << "Unable to listen on port " << racePort << std::endl;
+            return 1;
+        }
+        std::cout << "Broadcasting to up to " << broadcastSpectators << " spectators on port " << racePort << std::endl;
+    }
+    else if (spectating) {
+        spectator.reset(new SpectatorClient(world));
+        if (!spectator->connect(spectateAddress, racePort)) {
+            std::cerr << "Unable to open a network socket" << std::endl;
+            return 1;
+        }
+        std::cout << "Watching the game at " << spectateAddress << ":" << racePort << "..." << std::endl;
+        while (!spectator->watching() && !spectator->timedOut()) {
+            spectator->tick();
+            sf::sleep(sf::seconds(tickSeconds));
+        }
+        if (!spectator->watching()) {
+            std::cerr << "No answer from the game" << std::endl;
+            return 1;
+        }
+        fitTileSize();
+    }
+    int announcedRacers = 0;
+    bool spectatorQuiet = false;
 
     // SFML window setup
-    sf::RenderWindow window(sf::VideoMode(width * tile_size, height * tile_size), "Mystery Maze Game");
+    setMemoryTag(MemoryTag::Rendering);
+    sf::RenderWindow window(sf::VideoMode(std::min(world.width * tile_size, 850), std::min(world.height * tile_size, 650)), "Mystery Maze Game");
 
     // Rectangle shapes for drawing maze tiles, player, enemy, exit, and purple blocks
     sf::RectangleShape wall(sf::Vector2f(tile_size, tile_size));
@@ -172,6 +464,12 @@ int main() {
     sf::RectangleShape purpleBlockShape(sf::Vector2f(tile_size, tile_size));
     purpleBlockShape.setFillColor(sf::Color::Magenta);
 
+    sf::RectangleShape powerUpShape(sf::Vector2f(tile_size, tile_size));
+    powerUpShape.setFillColor(sf::Color::Cyan);  // Cyan for power-up
+
+    sf::RectangleShape ghostShape(playerShape);
+    ghostShape.setFillColor(sf::Color(0, 255, 0, 96));  // Translucent player green for the ghost and other racers
+
     // Load font
     sf::Font font;
 
@@ -200,25 +498,60 @@ int main() {
     // Calculate position for the top-right corner of the window
     // Calculate text bounds to prevent cutoff
     // Position the timer text slightly from the top-right corner
-    timerText.setPosition(width * tile_size - 200, 12); // Initial placement
+    timerText.setPosition(window.getSize().x - 200.0f, 12); // Initial placement
+
+    // Frame statistics, toggled with F3
+    PerfOverlay overlay(font);
+    FrameStats frameStats;
+    setMemoryTag(untagged);
+
+    // Moves pressed since the last tick, and real time not yet simulated
+    std::vector<char> pendingMoves;
+    pendingMoves.reserve(16);
+    sf::Clock frameClock;
+    float unsimulatedTime = 0.0f;
+
+    // Where to draw the ghost and the other racers
+    std::vector<sf::Vector2i> rivals;
+    rivals.reserve(maxRacers);
 
     // Main game loop
     while (window.isOpen()) {
         sf::Event event;
         while (window.pollEvent(event)) {
             if (event.type == sf::Event::KeyPressed) {
-                if (event.key.code == sf::Keyboard::J) {
-                    saveGame();
-                    std::cout << "Game saved!" << std::endl;
+                if (event.key.code == sf::Keyboard::J && !racing && !spectating) {
+                    autoSaver.saveNow(world, currentSlot);
+                    std::cout << "Game saved to slot " << currentSlot << "!" << std::endl;
                 }
-                else if (event.key.code == sf::Keyboard::L) {
-                    loadGame();
-                    std::cout << "Game loaded." << std::endl;
+                else if (event.key.code == sf::Keyboard::L && !racing && !spectating) {
+                    session.pause();
+                    int loadedSlot = loadGame(saveCatalog);
+                    if (loadedSlot >= autosaveSlot) {
+                        recorder.recordSnapshot(world);
+                    }
+                    if (loadedSlot > autosaveSlot) {
+                        currentSlot = loadedSlot; // Keep saving over the game that was loaded
+                    }
+                }
+                else if (event.key.code == sf::Keyboard::F3) {
+                    overlay.toggle();
+                }
+                else if (event.key.code == sf::Keyboard::P) {
+                    if (!profilerEnabled()) {
+                        enableProfiler(true);
+                        std::cout << "Profiling; press P again to write " << profileFile << std::endl;
+                    }
+                    else {
+                        enableProfiler(false);
+                        std::cout << (writeProfileTrace(profileFile) ? "Profile written to " : "Unable to write profile to ")
+                            << profileFile << std::endl;
+                    }
                 }
             }
             if (event.type == sf::Event::Closed) {
                 // Calculate and display elapsed time when the user closes the window
-                float elapsedTime = gameTimer.getElapsedTime().asSeconds();
+                float elapsedTime = elapsedLevelTime(world);
                 int minutes = static_cast<int>(elapsedTime) / 60;
                 int seconds = static_cast<int>(elapsedTime) % 60;
                 std::cout << "Game exited! Elapsed time: " << minutes << " minutes and "
@@ -230,89 +563,213 @@ int main() {
             if (event.type == sf::Event::KeyPressed) {
                 if (event.key.code == sf::Keyboard::Num3) {
                     // User pressed '3' to exit the game
-                    float elapsedTime = gameTimer.getElapsedTime().asSeconds();
+                    float elapsedTime = elapsedLevelTime(world);
                     int minutes = static_cast<int>(elapsedTime) / 60;
                     int seconds = static_cast<int>(elapsedTime) % 60;
                     std::cout << "Game exited! Elapsed time: " << minutes << " minutes and "
-                        << seconds << " seconds." << std::endl << "You reached level " << level << '\n' << "Your player position is: " << playerX << ' ' << playerY; //player x is across (width)
+                        << seconds << " seconds." << std::endl << "You reached level " << world.level << '\n' << "Your player position is: " << world.playerX << ' ' << world.playerY; //player x is across (width)
                     // player y position is down (rows)
 
                     window.close();
                 }
 
                 if (event.key.code == sf::Keyboard::W) {
-                    movePlayer('W'); // Move player up
+                    pendingMoves.push_back('W'); // Move player up
                 }
                 else if (event.key.code == sf::Keyboard::S) {
-                    movePlayer('S'); // Move player down
+                    pendingMoves.push_back('S'); // Move player down
                 }
                 else if (event.key.code == sf::Keyboard::A) {
-                    movePlayer('A'); // Move player left
+                    pendingMoves.push_back('A'); // Move player left
                 }
                 else if (event.key.code == sf::Keyboard::D) {
-                    movePlayer('D'); // Move player right
+                    pendingMoves.push_back('D'); // Move player right
                 }
             }
         }
 
-        // Check if the player reached the exit
-        if (isExitReached()) {
-            std::cout << "Congratulations! You've reached the exit!" << std::endl;
-            showPostLevelMenu();
-            prepareNextLevel();
-        }
-
-        // Check if the enemy caught the player
-        if (enemy.x == playerX && enemy.y == playerY) {
-            std::cout << "Game Over! The enemy caught you!" << std::endl;
-
-            // Display elapsed time before exiting
-            float elapsedTime = gameTimer.getElapsedTime().asSeconds();
-            int minutes = static_cast<int>(elapsedTime) / 60;
-            int seconds = static_cast<int>(elapsedTime) % 60;
-            std::cout << "Elapsed time: " << minutes << " minutes and "
-                << seconds << " seconds." << std::endl;
+        // Run as many fixed ticks as real time allows. After a long stall
+        // (e.g. a console prompt) the game resumes instead of catching up.
+        frameStats.seconds = frameClock.restart().asSeconds();
+        frameStats.ticks = 0;
+        session.recordFrame(frameStats.seconds, world.level, world.tick);
+        unsimulatedTime = std::min(unsimulatedTime + frameStats.seconds, 0.25f);
+        while (unsimulatedTime >= tickSeconds && window.isOpen()) {
+            unsimulatedTime -= tickSeconds;
+            ++frameStats.ticks;
+            SessionTickTimer tickTimer(session);
+            if (raceHost) {
+                raceHost->tick(pendingMoves.data(), pendingMoves.size());
+                pendingMoves.clear();
+                if (raceHost->joined() != announcedRacers) {
+                    announcedRacers = raceHost->joined();
+                    std::cout << announcedRacers << " of " << raceRacers << " racers here" << std::endl;
+                }
+                announceRace(raceHost->started(), raceHost->countdownSeconds(), raceHost->racers(), 0, raceHost->over());
+                continue;
+            }
+            if (lockstep) {
+                lockstep->tick(pendingMoves.data(), pendingMoves.size());
+                pendingMoves.clear();
+                if (lockstep->joined() != announcedRacers) {
+                    announcedRacers = lockstep->joined();
+                    std::cout << announcedRacers << " of " << lockstep->peers() << " racers here" << std::endl;
+                }
+                announceRace(lockstep->started(), 0, lockstep->racers(), lockstep->id(), lockstep->over());
+                if (lockstep->desynced()) {
+                    std::cout << "Out of step with the other racers at tick " << lockstep->desyncedAt() << std::endl;
+                    window.close();
+                }
+                else if (lockstep->timedOut()) {
+                    std::cout << "Lost contact with the race host" << std::endl;
+                    window.close();
+                }
+                continue;
+            }
+            if (raceClient) {
+                raceClient->tick(pendingMoves.data(), pendingMoves.size());
+                pendingMoves.clear();
+                announceRace(raceClient->started(), raceClient->countdownSeconds(), raceClient->racers(), raceClient->id(), raceClient->over());
+                if (raceClient->timedOut()) {
+                    std::cout << "Lost contact with the race host" << std::endl;
+                    window.close();
+                }
+                continue;
+            }
 
-            window.close();
-        }
+            if (spectator) {
+                spectator->tick();
+                pendingMoves.clear();
+                if (spectator->ended()) {
+                    std::cout << "The game you were watching is over" << std::endl;
+                    window.close();
+                }
+                else if (spectator->timedOut() != spectatorQuiet) {
+                    // Console prompts pause the game being watched, so silence is not the end of it
+                    spectatorQuiet = spectator->timedOut();
+                    std::cout << (spectatorQuiet ? "The game has gone quiet; press 3 to stop watching" : "The game is back") << std::endl;
+                }
+                continue;
+            }
 
-        // Slow down enemy movement
-        if (enemy.moveClock.getElapsedTime().asSeconds() > 0.5f) {
-            enemy.move();
-            enemy.moveClock.restart();
-        }
+            recorder.recordMoves(world.tick, pendingMoves.data(), pendingMoves.size());
+            TickResult result = stepWorld(world, pendingMoves.data(), pendingMoves.size());
+            pendingMoves.clear();
+            ghost.step();
+            if (broadcaster) {
+                broadcaster->tick(world);
+            }
 
-        sf::Time elapsedTime = gameTimer.getElapsedTime();
-        float remainingTime = timeLimit - elapsedTime.asSeconds();
+            if (result == TickResult::ExitReached && timeAttack) {
+                std::cout << "Finished in " << world.tick * tickSeconds << " seconds!" << std::endl;
+                raceFinished = true;
+                window.close();
+            }
+            // Check if the player reached the exit
+            else if (result == TickResult::ExitReached) {
+                std::cout << "Congratulations! You've reached the exit!" << std::endl;
+                session.pause();
+                showPostLevelMenu();
+                recorder.recordLevelAdvance(world.tick);
+                prepareNextLevel();
+                frameClock.restart();
+            }
+            else if (result != TickResult::Playing) {
+                if (result == TickResult::Caught) {
+                    std::cout << "Game Over! The enemy caught you!" << std::endl;
+                }
+                else if (result == TickResult::TimeUp) {
+                    std::cout << "Time's up! Game Over!" << std::endl;
+                }
 
-        if (remainingTime <= 0.0f) {
-            std::cout << "Time's up! Game Over!" << std::endl;
+                // Display elapsed time before exiting
+                float elapsedTime = elapsedLevelTime(world);
+                int minutes = static_cast<int>(elapsedTime) / 60;
+                int seconds = static_cast<int>(elapsedTime) % 60;
+                std::cout << "Elapsed time: " << minutes << " minutes and "
+                    << seconds << " seconds." << std::endl;
 
-            // Display elapsed time before exiting
-            float elapsedTime = gameTimer.getElapsedTime().asSeconds();
-            int minutes = static_cast<int>(elapsedTime) / 60;
-            int seconds = static_cast<int>(elapsedTime) % 60;
-            std::cout << "Elapsed time: " << minutes << " minutes and "
-                << seconds << " seconds." << std::endl;
+                window.close();
+            }
+        }
 
-            window.close();
+        if (!racing && !spectating) {
+            autoSaver.update(world);
         }
 
         // Update the timer and display it
         updateTimerText(timerText);
 
         // Clear window and redraw maze
-        window.clear(sf::Color::Black);
-        drawMaze(window, wall, emptySpace, playerShape, enemyShape, exitShape, purpleBlockShape, enemy, timerText);
-        window.display();
+        {
+            MemoryTagScope memoryTag(MemoryTag::Rendering);
+            window.clear(sf::Color::Black);
+            rivals.clear();
+            if (ghost.visible()) {
+                rivals.push_back(sf::Vector2i(ghost.x(), ghost.y()));
+            }
+            const std::vector<RacerState>* racers = raceHost ? &raceHost->racers() : raceClient ? &raceClient->racers()
+                : lockstep ? &lockstep->racers() : nullptr;
+            int localId = raceClient ? raceClient->id() : lockstep ? lockstep->id() : 0;
+            for (std::size_t id = 0; racers && id < racers->size(); ++id) {
+                const RacerState& racer = (*racers)[id];
+                bool inView = !raceClient || raceClient->inView(static_cast<int>(id));
+                if (static_cast<int>(id) != localId && racer.status != RacerStatus::Out && inView) {
+                    rivals.push_back(sf::Vector2i(racer.x, racer.y));
+                }
+            }
+            frameDraws = DrawCounts();
+            drawMaze(window, wall, emptySpace, playerShape, enemyShape, exitShape, purpleBlockShape, powerUpShape, ghostShape, rivals, world.enemy, timerText);
+            overlay.draw(window, frameDraws);
+            {
+                PROFILE_ZONE("display"); // Includes waiting for vsync, if the driver does
+                window.display();
+            }
+        }
+        frameStats.draws = frameDraws;
+        frameStats.enemies = 1;
+        frameStats.rivals = static_cast<int>(rivals.size());
+        overlay.update(frameStats, world);
 
         if (levelCompleted) {
             // Handle post-level menu here
+            session.pause();
             showPostLevelMenu();
             levelCompleted = false;
         }
     }
 
+    session.writeReport(std::cout);
+    recorder.finish(world);
+    if (profilerEnabled()) {
+        enableProfiler(false);
+        std::cout << (writeProfileTrace(profileFile) ? "Profile written to " : "Unable to write profile to ") << profileFile << std::endl;
+    }
+    if (lockstep) {
+        lockstep->leave();
+    }
+    if (raceClient) {
+        raceClient->leave();
+        raceClient->printPrediction(std::cout);
+    }
+    if (raceHost) {
+        raceHost->printTraffic(std::cout);
+    }
+    if (spectator) {
+        spectator->leave();
+    }
+    if (broadcaster) {
+        broadcaster->finish();
+    }
+    if (timeAttack) {
+        if (raceFinished && (!hasBest || world.tick < bestTicks) && replaceFile(recordFile, ghostFile)) {
+            std::cout << "New best time! Your ghost is saved in " << ghostFile << std::endl;
+        }
+        else {
+            std::remove(recordFile.c_str());
+        }
+    }
+
     // Reading from file
     //std::ifstream infile("game_data.txt");
 
@@ -340,175 +797,97 @@ int main() {
     return 0;
 }
 
-// Initialize the maze with walls ('#')
-void initializeMaze() {
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            maze[i][j] = '#'; // Initialize all cells as walls
-        }
-    }
-}
-
-void generateMaze(int startX, int startY) {
-    std::stack<std::pair<int, int>> cellStack;
-    maze[startY][startX] = ' ';
-    cellStack.push({ startX, startY });
-
-    while (!cellStack.empty()) {
-        int x = cellStack.top().first;
-        int y = cellStack.top().second;
-        std::vector<int> directions = { 0, 1, 2, 3 };
-        std::random_shuffle(directions.begin(), directions.end());
-
-        bool moved = false;
-        for (int dir : directions) {
-            int nx = x + DIRECTIONS[dir].first * 2;
-            int ny = y + DIRECTIONS[dir].second * 2;
-
-            if (nx >= 0 && nx < width && ny >= 0 && ny < height && maze[ny][nx] == '#') {
-                maze[ny][nx] = ' ';
-                maze[y + DIRECTIONS[dir].second][x + DIRECTIONS[dir].first] = ' ';
-                cellStack.push({ nx, ny });
-                moved = true;
-                break;
-            }
-        }
-
-        if (!moved) {
-            cellStack.pop();
-        }
-    }
-
-    maze[exitY][exitX] = 'E';
-}
-
-// Function to place exactly two purple blocks randomly on the maze
-void placePurpleBlocks() {
-    while (purpleBlocks.size() < 2) { // Limit to 2 blocks
-        int x = rand() % width;
-        int y = rand() % height;
-
-        // Ensure the block is placed on a walkable cell and not overlapping existing blocks
-        if (maze[y][x] == ' ' && std::find(purpleBlocks.begin(), purpleBlocks.end(), std::make_pair(x, y)) == purpleBlocks.end()) {
-            purpleBlocks.push_back({ x, y });
-            maze[y][x] = 'P'; // Mark the block in the maze
-        }
+// Function to draw the maze and game objects on the screen
+void drawMaze(sf::RenderWindow& window, sf::RectangleShape& wall, sf::RectangleShape& emptySpace, sf::RectangleShape& playerShape, sf::RectangleShape& enemyShape, sf::RectangleShape& exitShape, sf::RectangleShape& purpleBlockShape, sf::RectangleShape& powerUpShape, sf::RectangleShape& ghostShape, const std::vector<sf::Vector2i>& rivals, Enemy& enemy, sf::Text& timerText) {
+    PROFILE_ZONE("drawMaze");
+    // Follow the player when the maze is bigger than the window
+    sf::View camera = window.getDefaultView();
+    sf::Vector2f viewSize = camera.getSize();
+    sf::Vector2f center = camera.getCenter();
+    float mazeWidth = static_cast<float>(world.width * tile_size);
+    float mazeHeight = static_cast<float>(world.height * tile_size);
+    if (mazeWidth > viewSize.x) {
+        center.x = std::max(viewSize.x / 2, std::min(mazeWidth - viewSize.x / 2, (world.playerX + 0.5f) * tile_size));
     }
-}
-
-// Function to place the power-up in the maze at a random walkable position
-void placePowerUp() {
-    while (true) {
-        int x = rand() % width;
-        int y = rand() % height;
-
-        // Ensure the power-up is on a walkable tile, not overlapping purple blocks, exit, or the player
-        if (maze[y][x] == ' ' && !(x == playerX && y == playerY) &&
-            !(x == exitX && y == exitY) &&
-            std::find(purpleBlocks.begin(), purpleBlocks.end(), std::make_pair(x, y)) == purpleBlocks.end()) {
-            powerUpX = x;
-            powerUpY = y;
-            powerUpActive = true;  // Activate the power-up
-            break;
-        }
+    if (mazeHeight > viewSize.y) {
+        center.y = std::max(viewSize.y / 2, std::min(mazeHeight - viewSize.y / 2, (world.playerY + 0.5f) * tile_size));
     }
-}
-
-// Function to draw the maze and game objects on the screen
-void drawMaze(sf::RenderWindow& window, sf::RectangleShape& wall, sf::RectangleShape& emptySpace, sf::RectangleShape& playerShape, sf::RectangleShape& enemyShape, sf::RectangleShape& exitShape, sf::RectangleShape& purpleBlockShape, Enemy& enemy, sf::Text& timerText) {
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
+    camera.setCenter(center);
+    window.setView(camera);
+
+    // Only visit the cells in view, so a memory-mapped maze is paged in around the camera
+    int firstColumn = std::max(0, static_cast<int>((center.x - viewSize.x / 2) / tile_size));
+    int lastColumn = std::min(world.width - 1, static_cast<int>((center.x + viewSize.x / 2) / tile_size));
+    int firstRow = std::max(0, static_cast<int>((center.y - viewSize.y / 2) / tile_size));
+    int lastRow = std::min(world.height - 1, static_cast<int>((center.y + viewSize.y / 2) / tile_size));
+
+    const auto& maze = world.maze;
+    for (int i = firstRow; i <= lastRow; ++i) {
+        for (int j = firstColumn; j <= lastColumn; ++j) {
             if (maze[i][j] == '#') {
                 wall.setPosition(j * tile_size, i * tile_size);
-                window.draw(wall);
+                drawCounted(window, wall);
             }
             else if (maze[i][j] == ' ') {
                 emptySpace.setPosition(j * tile_size, i * tile_size);
-                window.draw(emptySpace);
+                drawCounted(window, emptySpace);
             }
             else if (maze[i][j] == 'E') {
                 exitShape.setPosition(j * tile_size, i * tile_size);
-                window.draw(exitShape);
+                drawCounted(window, exitShape);
             }
         }
     }
 
-    // Draw the player and enemy
-    playerShape.setPosition(playerX * tile_size, playerY * tile_size);
-    window.draw(playerShape);
+    // Draw the ghost and other racers underneath the player, then the player and enemy
+    for (const sf::Vector2i& rival : rivals) {
+        ghostShape.setPosition(rival.x * tile_size, rival.y * tile_size);
+        drawCounted(window, ghostShape);
+    }
+
+    playerShape.setPosition(world.playerX * tile_size, world.playerY * tile_size);
+    drawCounted(window, playerShape);
 
     enemyShape.setPosition(enemy.x * tile_size, enemy.y * tile_size);
-    window.draw(enemyShape);
+    drawCounted(window, enemyShape);
 
     // Draw purple blocks
-    for (const auto& block : purpleBlocks) {
+    for (const auto& block : world.purpleBlocks) {
         purpleBlockShape.setPosition(block.first * tile_size, block.second * tile_size);
-        window.draw(purpleBlockShape);
+        drawCounted(window, purpleBlockShape);
     }
 
-    if (powerUpActive) {
-        sf::RectangleShape powerUpShape(sf::Vector2f(tile_size, tile_size));
-        powerUpShape.setFillColor(sf::Color::Cyan);  // Cyan for power-up
-        powerUpShape.setPosition(powerUpX * tile_size, powerUpY * tile_size);
-        window.draw(powerUpShape);
+    if (world.powerUpActive) {
+        powerUpShape.setPosition(world.powerUpX * tile_size, world.powerUpY * tile_size);
+        drawCounted(window, powerUpShape);
     }
 
 
     // Draw timer text
+    window.setView(window.getDefaultView());
     window.draw(timerText);
+    frameDraws.add(6 * timerText.getString().getSize()); // Two triangles a character, as sf::Text builds them
 }
 
-// Function to update the timer text
-void updateTimerText(sf::Text& timerText) {
-    float elapsedTime = gameTimer.getElapsedTime().asSeconds();
-    float remainingTime = timeLimit - elapsedTime;  // Use variable time limit
-    if (remainingTime < 0) {
-        remainingTime = 0;
-    }
-    int minutes = static_cast<int>(remainingTime) / 60;
-    int seconds = static_cast<int>(remainingTime) % 60;
-
-    timerText.setString("Time Remaining: " + std::to_string(minutes) + ":" +
-        (seconds < 10 ? "0" : "") + std::to_string(seconds));
+void drawCounted(sf::RenderWindow& window, const sf::Shape& shape) {
+    window.draw(shape);
+    frameDraws.add(shape.getPointCount() + 2); // A fan around the centre, back to the first point
 }
 
-// Function to move the player based on key input
-void movePlayer(char direction) {
-    int newX = playerX;
-    int newY = playerY;
-
-    if (direction == 'W') newY -= 1;  // Move up
-    else if (direction == 'S') newY += 1;  // Move down
-    else if (direction == 'A') newX -= 1;  // Move left
-    else if (direction == 'D') newX += 1;  // Move right
-
-    // Check for purple block interaction before moving
-    if (maze[newY][newX] == 'P') {
-        if (checkPurpleBlockInteraction(newX, newY)) {
-            return; // Stop movement if the block interaction fails
-        }
-    }
-
-    if (isWalkable(newX, newY)) {
-        playerX = newX;
-        playerY = newY;
-    }
+// Function to update the timer text
+void updateTimerText(sf::Text& timerText) {
+    float timeLeft = remainingTime(world);  // Use variable time limit
 
-    // Check if the player collected the power-up
-    if (powerUpActive && newX == powerUpX && newY == powerUpY) {
-        collectPowerUp();
+    // Only rebuild the string when the displayed value changes, not every frame
+    static int shownSeconds = -1;
+    int totalSeconds = static_cast<int>(timeLeft);
+    if (totalSeconds == shownSeconds) {
+        return;
     }
+    shownSeconds = totalSeconds;
 
-}
-
-// Check if a cell is walkable (empty or exit)
-bool isWalkable(int x, int y) {
-    return maze[y][x] == ' ' || maze[y][x] == 'E';
-}
-
-// Check if the player has reached the exit
-bool isExitReached() {
-    return playerX == exitX && playerY == exitY;
+    MemoryTagScope memoryTag(MemoryTag::Text);
+    timerText.setString(timerString(timeLeft));
 }
 
 // Show the game menu
@@ -519,6 +898,7 @@ void showMenu() {
     std::cout << "Press 3 to Exit." << '\n';
     std::cout << "Press j to save game state" << '\n';
     std::cout << "Press l to load game" << '\n';
+    std::cout << "Press F3 in game to show frame statistics" << '\n';
 }
 
 // Function to start the game or exit based on user input
@@ -572,131 +952,6 @@ bool startGame() {
     }
 }
 
-// Check if the enemy is too close to the player
-bool isTooCloseToPlayer(int enemyX, int enemyY) {
-    return std::abs(enemyX - playerX) < 2 && std::abs(enemyY - playerY) < 2;
-}
-
-// Function to check purple block interaction
-bool checkPurpleBlockInteraction(int x, int y) {
-    for (const auto& block : purpleBlocks) {
-        if (block.first == x && block.second == y) {
-            AdditionQuestion question = generateRandomAdditionQuestion();
-
-            int attempts = 3; // Player gets three attempts
-            bool passed = false;
-
-            while (attempts > 0) {
-                std::cout << "Solve the puzzle to pass: " << question.toString() << std::endl;
-                int answer;
-                std::cin >> answer;
-
-                if (answer == question.correctAnswer) {
-                    std::cout << "Correct! The purple block disappears." << std::endl;
-                    maze[y][x] = ' ';
-                    purpleBlocks.erase(std::remove(purpleBlocks.begin(), purpleBlocks.end(), block), purpleBlocks.end());
-                    passed = true;
-                    break;
-                }
-                else {
-                    attempts--;
-                    if (attempts > 0) {
-                        std::cout << "Incorrect! You have " << attempts << " attempt(s) remaining." << std::endl;
-                    }
-                    else {
-                        std::cout << "Incorrect! You have no attempts left. Game Over!" << std::endl;
-                        exit(0); // End the game
-                    }
-                }
-            }
-            return !passed; // Return true if the block is still blocking
-        }
-    }
-    return false; // No interaction with a purple block
-}
-
-// Function to collect the power-up and apply a random effect
-void collectPowerUp() {
-    // Randomize the effect
-    int effect = rand() % 3;  // 0 = freeze enemy, 1 = extra time, 2 = teleport player
-
-    // Declare validTeleport before the switch statement
-    bool validTeleport = false;
-
-    switch (effect) {
-
-    case 0:  // Extra time
-        std::cout << "Power-Up: Time extended by 30 seconds!" << std::endl;
-        gameTimer.restart();  // Restart the game timer with adjusted remaining time
-        timeLimit += 30;     // Add 30 seconds to the time limit
-        break;
-
-    case 1:  // Teleport player
-        std::cout << "Power-Up: Teleporting to a new position!" << std::endl;
-
-        while (!validTeleport) {
-            int newX = rand() % width;
-            int newY = rand() % height;
-
-            // Ensure the teleport position is walkable and not near the enemy
-            if (isWalkable(newX, newY) && !isTooCloseToPlayer(newX, newY)) {
-                playerX = newX;
-                playerY = newY;
-                validTeleport = true;
-            }
-        }
-        break;
-
-    default:
-        std::cerr << "Unknown power-up effect!" << std::endl;
-        break;
-    }
-
-    // Deactivate the power-up
-    powerUpActive = false;
-    powerUpX = -1;
-    powerUpY = -1;
-}
-
-void Enemy::move() {
-
-    std::vector<std::pair<int, int>> neighbors;
-
-    // Check all possible neighbors
-    for (const auto& dir : DIRECTIONS) {
-        int nx = x + dir.first;
-        int ny = y + dir.second;
-
-        // Add valid, unvisited neighbors
-        if (isWalkable(nx, ny) && visited.find({ nx, ny }) == visited.end()) {
-            neighbors.push_back({ nx, ny });
-        }
-    }
-
-    if (!neighbors.empty()) {
-        // Pick a random unvisited neighbor
-        int randomIndex = rand() % neighbors.size();
-        int nextX = neighbors[randomIndex].first;
-        int nextY = neighbors[randomIndex].second;
-
-        // Move to the chosen neighbor
-        x = nextX;
-        y = nextY;
-
-        // Mark it as visited and push it to the backtrack stack
-        visited.insert({ x, y });
-        backtrackStack.push({ x, y });
-    }
-    else if (!backtrackStack.empty()) {
-        // Backtrack if no unvisited neighbors are found
-        backtrackStack.pop(); // Remove the current position
-        if (!backtrackStack.empty()) {
-            x = backtrackStack.top().first;
-            y = backtrackStack.top().second;
-        }
-    }
-}
-
 void showPostLevelMenu() {
     std::cout << "Congratulations! You've completed Level 1.\n \n" << std::endl;
     char choice;
@@ -719,76 +974,11 @@ void showPostLevelMenu() {
 }
 
 void prepareNextLevel() {
-    // Increment the level
-    level++;
-
-    // Increase maze dimensions proportionally
-    int increaseAmount = 4;
-    height += increaseAmount;
-    width += increaseAmount;
+    // Bigger maze, new player/exit/enemy positions, fresh timer
+    advanceLevel(world);
 
     // Recalculate tile size based on the new dimensions
-    tile_size = std::min(850 / width, 650 / height);  // Adjust these values as needed
-
-    // Resize the window
-    sf::RenderWindow window(sf::VideoMode(width * tile_size, height * tile_size), "Mystery Maze Game");
-
-    // Reset maze
-    maze = std::vector<std::vector<char>>(height, std::vector<char>(width, '#'));
-
-    // Reset player position to top-left corner
-    playerX = 1;
-    playerY = 1;
-
-    // Reset exit position to bottom-right corner of the new maze
-    exitX = width - 2;
-    exitY = height - 2;
-
-    // Reinitialize and regenerate the maze
-    initializeMaze();
-    generateMaze(1, 1);
-
-    // Place purple blocks for the new level
-    purpleBlocks.clear();  // Clear old blocks
-    placePurpleBlocks();
-
-    // Place power-up in a valid location
-    placePowerUp();
-
-    // Reset enemy position
-    int enemyStartX = width - 3;
-    int enemyStartY = height - 3;
-
-    while (maze[enemyStartY][enemyStartX] == '#' || (enemyStartX == playerX && enemyStartY == playerY) || isTooCloseToPlayer(enemyStartX, enemyStartY)) {
-        enemyStartX = rand() % width;
-        enemyStartY = rand() % height;
-    }
-    // Create a new enemy at the new position
-    Enemy enemy(enemyStartX, enemyStartY);
-
-    // Reset the game timer for the new level
-    gameTimer.restart();
-    timeLimit = 120.0f;  // Reset time limit if desired
-}
-
-AdditionQuestion generateRandomAdditionQuestion() {
-    static const std::vector<int> numbers = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
-    static const std::vector<int> maxSum = { 5, 10, 15, 20 };
-
-    int num1 = numbers[rand() % numbers.size()];
-    int num2 = numbers[rand() % numbers.size()];
-
-    // Ensure the sum doesn't exceed the maximum possible value (e.g., 100)
-    if (num1 + num2 > 100) {
-        return generateRandomAdditionQuestion();
-    }
-
-    AdditionQuestion question;
-    question.num1 = num1;
-    question.num2 = num2;
-    question.correctAnswer = num1 + num2;
-
-    return question;
+    fitTileSize();
 }
 
 //idk if these do anything bruh
@@ -809,58 +999,123 @@ void writeLevelAndTimer(std::ofstream& outfile) {
     outfile << "You are on level" << level << " " << std::endl;
 }
 
-void saveGame(const GameState& gameState, const std::string& filename) {
-    std::ofstream outfile(filename);
-    if (outfile.is_open()) {
-        outfile << gameState.playerX << " ";
-        outfile << gameState.playerY << " ";
-        outfile << gameState.level << " ";
-        // Save other relevant data here
-        outfile.close();
+// Shrink tiles so the whole maze fits the window, down to minTileSize
+void fitTileSize() {
+    tile_size = std::max(minTileSize, std::min(850 / world.width, 650 / world.height));  // Adjust these values as needed
+}
+
+// Console commentary for a race: the countdown, how the local racer did,
+// and the standings once nobody is still racing
+void announceRace(bool started, int countdown, const std::vector<RacerState>& racers, int localId, bool over) {
+    static int shownCountdown = -1;
+    static bool shownStart = false;
+    static bool shownResult = false;
+    static bool shownStandings = false;
+
+    if (countdown > 0 && countdown != shownCountdown) {
+        shownCountdown = countdown;
+        std::cout << "Race starts in " << countdown << "..." << std::endl;
     }
-    else {
-        std::cerr << "Unable to open file for writing" << std::endl;
+    if (started && !shownStart) {
+        shownStart = true;
+        std::cout << "Go!" << std::endl;
+    }
+    if (!shownResult && localId >= 0 && localId < static_cast<int>(racers.size())
+        && racers[localId].status != RacerStatus::Racing) {
+        shownResult = true;
+        if (racers[localId].status == RacerStatus::Finished) {
+            std::cout << "You finished in " << racers[localId].finishTicks * tickSeconds << " seconds!" << std::endl;
+        }
+        else {
+            std::cout << "You're out of the race!" << std::endl;
+        }
+    }
+    if (over && !shownStandings) {
+        shownStandings = true;
+        std::vector<int> order;
+        for (int id = 0; id < static_cast<int>(racers.size()); ++id) {
+            order.push_back(id);
+        }
+        std::stable_sort(order.begin(), order.end(), [&racers](int a, int b) {
+            bool aFinished = racers[a].status == RacerStatus::Finished;
+            bool bFinished = racers[b].status == RacerStatus::Finished;
+            return aFinished != bFinished ? aFinished : aFinished && racers[a].finishTicks < racers[b].finishTicks;
+        });
+        std::cout << "Race over!" << std::endl;
+        for (std::size_t place = 0; place < order.size(); ++place) {
+            const RacerState& racer = racers[order[place]];
+            std::cout << place + 1 << ". Racer " << order[place] << (order[place] == localId ? " (you)" : "") << ": ";
+            if (racer.status == RacerStatus::Finished) {
+                std::cout << racer.finishTicks * tickSeconds << " seconds" << std::endl;
+            }
+            else {
+                std::cout << "did not finish" << std::endl;
+            }
+        }
     }
 }
-void saveGame() {
-    GameState gameState;
-    gameState.playerX = playerX;
-    gameState.playerY = playerY;
-    gameState.level = level;
 
-    // Save other relevant game state variables
-
-    saveGame(gameState, "game_state.dat");
+// First slot after the autosave that has nothing in it yet
+int firstFreeSlot(SaveCatalog& catalog) {
+    std::vector<SaveSlotEntry> slots;
+    if (catalog.list(slots)) {
+        for (int slot = autosaveSlot + 1; slot < maxSaveSlots; ++slot) {
+            if (!slots[slot].used) {
+                return slot;
+            }
+        }
+    }
+    return autosaveSlot + 1;
 }
 
-
-bool loadGame(GameState& gameState, const std::string& filename) {
-    std::ifstream infile(filename);
-    if (!infile) {
-        return false; // Unable to open file
+// List the saves from the catalog and load the one the player picks; returns its slot or -1
+int loadGame(SaveCatalog& catalog) {
+    std::vector<SaveSlotEntry> slots;
+    if (!catalog.list(slots)) {
+        std::cout << "Failed to read the save catalog" << std::endl;
+        return -1;
     }
 
-    infile >> gameState.playerX >> gameState.playerY >> gameState.level;
-    // Load other relevant data here
-    infile.close();
-    return true;
-}
-
-void loadGame() {
-    GameState gameState;
-    if (loadGame(gameState, "game_state.dat")) {
-        playerX = gameState.playerX;
-        playerY = gameState.playerY;
-        level = gameState.level;
+    std::cout << "Slot  Level  Maze       Time left  Saved" << std::endl;
+    bool anySaves = false;
+    for (int slot = 0; slot < maxSaveSlots; ++slot) {
+        const SaveSlotEntry& entry = slots[slot];
+        if (!entry.used) {
+            continue;
+        }
+        char saved[32] = "unknown";
+        std::time_t timestamp = static_cast<std::time_t>(entry.timestamp);
+        if (entry.timestamp != 0) {
+            std::strftime(saved, sizeof(saved), "%Y-%m-%d %H:%M", std::localtime(&timestamp));
+        }
+        char line[96];
+        std::snprintf(line, sizeof(line), "%-5d %-6d %4dx%-5d %6.0fs    %s%s", slot, entry.level, entry.width, entry.height,
+            entry.remainingTime, saved, slot == autosaveSlot ? " (autosave)" : "");
+        std::cout << line << std::endl;
+        anySaves = true;
+    }
+    if (!anySaves) {
+        std::cout << "No saved games" << std::endl;
+        return -1;
+    }
 
-        // Load other relevant game state variables
+    std::cout << "Enter a slot number to load: ";
+    int slot;
+    if (!(std::cin >> slot)) {
+        std::cin.clear();
+        std::cin.ignore(1024, '\n');
+        return -1;
     }
-    else {
+    if (slot < 0 || slot >= maxSaveSlots || !slots[slot].used || !catalog.loadSlot(world, slot)) {
         std::cout << "Failed to load game state" << std::endl;
+        return -1;
     }
+    // The saved level may be a different size from the current one
+    fitTileSize();
+    std::cout << "Game loaded." << std::endl;
+    return slot;
 }
 
 
 
-//TODO - add scoring system, add save and load game
-//Fix bug of when saving game state and then re-playing the game, if the saved game position of the player is not in the new maze's path, the player will be spawed outside of the maze path
+//TODO - add scoring system
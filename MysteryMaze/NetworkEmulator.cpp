@@ -0,0 +1,170 @@
+#include "NetworkEmulator.h"
+#include <algorithm>
+
+static const int udpHeaderBytes = 28;  // IPv4 and UDP, counted against the bandwidth cap
+static const std::uint32_t maxQueueMs = 1000; // Datagrams that would wait longer behind the cap are dropped
+
+const std::vector<NetworkProfile>& networkProfiles() {
+    auto make = [](const char* name, std::uint32_t latencyMs, std::uint32_t jitterMs, float lossPercent,
+        float reorderPercent, std::uint32_t bytesPerSecond) {
+        NetworkProfile profile;
+        profile.name = name;
+        profile.conditions.latencyMs = latencyMs;
+        profile.conditions.jitterMs = jitterMs;
+        profile.conditions.lossPercent = lossPercent;
+        profile.conditions.reorderPercent = reorderPercent;
+        profile.conditions.bytesPerSecond = bytesPerSecond;
+        return profile;
+    };
+    static const std::vector<NetworkProfile> profiles = {
+        make("lan", 1, 0, 0.0f, 0.0f, 0),
+        make("broadband", 15, 3, 0.2f, 0.0f, 0),
+        make("wifi", 25, 15, 1.0f, 1.0f, 0),
+        make("mobile", 60, 30, 3.0f, 2.0f, 32 * 1024),
+        make("satellite", 300, 20, 1.0f, 0.0f, 64 * 1024),
+        make("congested", 40, 60, 8.0f, 5.0f, 2 * 1024),
+    };
+    return profiles;
+}
+
+bool findNetworkProfile(const std::string& name, NetworkConditions& conditions) {
+    for (const NetworkProfile& profile : networkProfiles()) {
+        if (name == profile.name) {
+            conditions = profile.conditions;
+            return true;
+        }
+    }
+    return false;
+}
+
+NetworkEmulator::NetworkEmulator() {
+    queue.reserve(64);
+}
+
+void NetworkEmulator::setConditions(const NetworkConditions& conditions, std::uint64_t seed) {
+    link = conditions;
+    rng.reseed(seed);
+}
+
+bool NetworkEmulator::later(const Datagram& left, const Datagram& right) {
+    std::int32_t apart = static_cast<std::int32_t>(left.dueMs - right.dueMs);
+    return apart > 0 || (apart == 0 && left.order > right.order);
+}
+
+bool NetworkEmulator::chance(float percent) {
+    // Nothing drawn for a condition that is off, so turning one on leaves the others' draws alone
+    return percent > 0.0f && rng.below(1000000) < static_cast<int>(percent * 10000.0f);
+}
+
+void NetworkEmulator::push(WireBuffer* datagram, const sf::IpAddress& address, unsigned short port, std::uint32_t nowMs) {
+    if (chance(link.lossPercent)) {
+        ++counts.lost;
+        pool.release(datagram);
+        return;
+    }
+
+    // The link sends one datagram at a time at its speed, after those already queued
+    std::uint32_t sentMs = nowMs;
+    if (link.bytesPerSecond > 0) {
+        std::uint64_t nowUs = static_cast<std::uint64_t>(nowMs) * 1000;
+        linkFreeUs = std::max(linkFreeUs, nowUs);
+        if (linkFreeUs - nowUs > maxQueueMs * 1000ull) {
+            ++counts.overflowed;
+            pool.release(datagram);
+            return;
+        }
+        linkFreeUs += (datagram->size() + udpHeaderBytes) * 1000000ull / link.bytesPerSecond;
+        sentMs = static_cast<std::uint32_t>(linkFreeUs / 1000);
+    }
+
+    Datagram held;
+    held.dueMs = sentMs + link.latencyMs + (link.jitterMs > 0 ? static_cast<std::uint32_t>(rng.below(link.jitterMs + 1)) : 0);
+    if (chance(link.reorderPercent)) {
+        held.dueMs += link.reorderMs;
+        ++counts.reordered;
+    }
+    else {
+        // Jitter alone never reorders, as on a real link; only reorderPercent does
+        if (pushed > 0 && static_cast<std::int32_t>(lastDueMs - held.dueMs) > 0) {
+            held.dueMs = lastDueMs;
+        }
+        lastDueMs = held.dueMs;
+    }
+    held.order = pushed++;
+    held.buffer = datagram;
+    held.address = address;
+    held.port = port;
+    queue.push_back(held);
+    std::push_heap(queue.begin(), queue.end(), later);
+}
+
+WireBuffer* NetworkEmulator::pop(std::uint32_t nowMs, sf::IpAddress& address, unsigned short& port) {
+    if (queue.empty() || static_cast<std::int32_t>(nowMs - queue.front().dueMs) < 0) {
+        return nullptr;
+    }
+    std::pop_heap(queue.begin(), queue.end(), later);
+    Datagram& due = queue.back();
+    WireBuffer* datagram = due.buffer;
+    address = due.address;
+    port = due.port;
+    queue.pop_back();
+    ++counts.delivered;
+    return datagram;
+}
+
+bool EmulatedSocket::bind(unsigned short port) {
+    if (socket.bind(port) != sf::Socket::Done) {
+        return false;
+    }
+    socket.setBlocking(false);
+    return true;
+}
+
+void EmulatedSocket::setConditions(const NetworkConditions& outgoingLink, const NetworkConditions& incomingLink, std::uint64_t seed) {
+    outgoing.setConditions(outgoingLink, seed * 2);
+    incoming.setConditions(incomingLink, seed * 2 + 1);
+}
+
+void EmulatedSocket::setTime(std::uint32_t now) {
+    nowMs = now;
+    flush();
+}
+
+void EmulatedSocket::send(WireBuffer* datagram, const sf::IpAddress& address, unsigned short port) {
+    outgoing.push(datagram, address, port, nowMs);
+    flush();
+}
+
+void EmulatedSocket::send(const sf::Packet& packet, const sf::IpAddress& address, unsigned short port) {
+    WireBuffer* datagram = outgoing.acquire();
+    datagram->append(packet.getData(), packet.getDataSize());
+    send(datagram, address, port);
+}
+
+void EmulatedSocket::sendNow(const WireBuffer& datagram, const sf::IpAddress& address, unsigned short port) {
+    sendDatagram(socket, datagram, address, port);
+}
+
+void EmulatedSocket::sendNow(const sf::Packet& packet, const sf::IpAddress& address, unsigned short port) {
+    socket.send(packet.getData(), packet.getDataSize(), address, port);
+}
+
+void EmulatedSocket::flush() {
+    sf::IpAddress address;
+    unsigned short port = 0;
+    while (WireBuffer* datagram = outgoing.pop(nowMs, address, port)) {
+        sendDatagram(socket, *datagram, address, port);
+        outgoing.release(datagram);
+    }
+}
+
+WireBuffer* EmulatedSocket::receive(sf::IpAddress& address, unsigned short& port) {
+    // Everything waiting on the real socket goes across the incoming link first
+    WireBuffer* datagram = incoming.acquire();
+    while (receiveDatagram(socket, *datagram, address, port) == sf::Socket::Done) {
+        incoming.push(datagram, address, port, nowMs);
+        datagram = incoming.acquire();
+    }
+    incoming.release(datagram);
+    return incoming.pop(nowMs, address, port);
+}
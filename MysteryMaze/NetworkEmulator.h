@@ -0,0 +1,130 @@
+#pragma once
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/Packet.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Rng.h"
+#include "WireBuffer.h"
+
+// What one direction of a network link does to the datagrams crossing it
+struct NetworkConditions {
+    std::uint32_t latencyMs = 0;
+    std::uint32_t jitterMs = 0;       // Up to this much more on each datagram, at random
+    float lossPercent = 0.0f;
+    float reorderPercent = 0.0f;      // Held back a further reorderMs, so later ones overtake it
+    std::uint32_t reorderMs = 60;
+    std::uint32_t bytesPerSecond = 0; // Link speed, headers included; 0 for no cap
+
+    bool any() const {
+        return latencyMs > 0 || jitterMs > 0 || lossPercent > 0.0f || reorderPercent > 0.0f || bytesPerSecond > 0;
+    }
+};
+
+// Named sets of conditions, the same both ways, for trying netcode against
+// typical links: lan, broadband, wifi, mobile, satellite and congested
+struct NetworkProfile {
+    const char* name;
+    NetworkConditions conditions;
+};
+
+const std::vector<NetworkProfile>& networkProfiles();
+bool findNetworkProfile(const std::string& name, NetworkConditions& conditions);
+
+// What a NetworkEmulator did to the datagrams pushed through it
+struct EmulatorStats {
+    std::uint64_t delivered = 0;
+    std::uint64_t lost = 0;
+    std::uint64_t overflowed = 0; // Dropped by a full queue in front of the bandwidth cap
+    std::uint64_t reordered = 0;
+};
+
+// Puts one direction of a link in front of a socket: each datagram pushed
+// in comes out of pop() once the link would have delivered it, or never.
+// Time is whatever clock the caller passes in, in milliseconds; the race
+// client uses its fixed tick, which keeps runs that go faster than real time
+// (benchmarks) affected by the same number of ticks as a real game. All the
+// randomness comes from the seed, so the same seed, clock and traffic give
+// the same drops and delays every run.
+//
+// Datagrams are built or received straight into the emulator's pooled
+// buffers and handed over whole, so holding one back copies nothing. With
+// no conditions a datagram is due as soon as it is pushed.
+class NetworkEmulator {
+public:
+    NetworkEmulator();
+
+    void setConditions(const NetworkConditions& conditions, std::uint64_t seed);
+    const NetworkConditions& conditions() const { return link; }
+
+    // A buffer to put a datagram in, then either push or release
+    WireBuffer* acquire() { return pool.acquire(); }
+    void release(WireBuffer* buffer) { pool.release(buffer); }
+
+    // Send a datagram to address and port across the link; it may be released at once if lost
+    void push(WireBuffer* datagram, const sf::IpAddress& address, unsigned short port, std::uint32_t nowMs);
+
+    // The next datagram due by now, or nullptr; release it once done with
+    WireBuffer* pop(std::uint32_t nowMs, sf::IpAddress& address, unsigned short& port);
+
+    std::size_t pending() const { return queue.size(); }
+    const EmulatorStats& stats() const { return counts; }
+
+private:
+    struct Datagram {
+        std::uint32_t dueMs = 0;
+        std::uint64_t order = 0; // Ties on dueMs go out in the order they came in
+        WireBuffer* buffer = nullptr;
+        sf::IpAddress address;
+        unsigned short port = 0;
+    };
+    static bool later(const Datagram& left, const Datagram& right);
+    bool chance(float percent);
+
+    NetworkConditions link;
+    Rng rng;
+    WireBufferPool pool;
+    std::vector<Datagram> queue;   // A heap, soonest due on top
+    std::uint64_t pushed = 0;
+    std::uint32_t lastDueMs = 0;   // Of the last datagram not reordered, to keep the rest in order
+    std::uint64_t linkFreeUs = 0;  // When the bandwidth cap has sent everything queued so far
+    EmulatorStats counts;
+};
+
+// A UDP socket with a NetworkEmulator on the way out and another on the way
+// in, for netcode that should not care whether the network is real. Call
+// setTime() every tick; datagrams due by then are sent or handed out.
+class EmulatedSocket {
+public:
+    bool bind(unsigned short port); // And make it non-blocking
+    unsigned short localPort() const { return socket.getLocalPort(); }
+
+    void setConditions(const NetworkConditions& outgoing, const NetworkConditions& incoming, std::uint64_t seed);
+    void setTime(std::uint32_t nowMs);
+
+    // Build a datagram in acquire()'s buffer and send() it, which takes it back
+    WireBuffer* acquire() { return outgoing.acquire(); }
+    void send(WireBuffer* datagram, const sf::IpAddress& address, unsigned short port);
+    void send(const sf::Packet& packet, const sf::IpAddress& address, unsigned short port); // Copied in
+
+    // Straight to the socket, for a goodbye with no ticks left to carry it
+    void sendNow(const WireBuffer& datagram, const sf::IpAddress& address, unsigned short port);
+    void sendNow(const sf::Packet& packet, const sf::IpAddress& address, unsigned short port);
+
+    // The next datagram that has arrived, or nullptr; release it once done with
+    WireBuffer* receive(sf::IpAddress& address, unsigned short& port);
+    void release(WireBuffer* datagram) { incoming.release(datagram); }
+
+    const EmulatorStats& outgoingStats() const { return outgoing.stats(); }
+    const EmulatorStats& incomingStats() const { return incoming.stats(); }
+
+private:
+    void flush();
+
+    sf::UdpSocket socket;
+    NetworkEmulator outgoing;
+    NetworkEmulator incoming;
+    std::uint32_t nowMs = 0;
+};
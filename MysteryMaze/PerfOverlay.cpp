@@ -0,0 +1,152 @@
+#include "PerfOverlay.h"
+#include "World.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    const unsigned int overlayTextSize = 14;
+    const float overlayLeft = 8.0f;
+    const float overlayTop = 8.0f;
+    const float overlayPadding = 6.0f;
+    const float barWidth = 2.0f;
+    const float graphHeight = 50.0f;      // Pixels, one per millisecond
+    const float textRefreshSeconds = 0.25f;
+
+    double liveKB(MemoryTag tag) {
+        return memoryTagStats(tag).liveBytes / 1024.0;
+    }
+
+    // Two triangles, for vertex arrays of sf::Triangles
+    void appendQuad(sf::VertexArray& vertices, float left, float top, float width, float height, sf::Color color,
+        sf::FloatRect texture = sf::FloatRect()) {
+        sf::Vertex topLeft(sf::Vector2f(left, top), color, sf::Vector2f(texture.left, texture.top));
+        sf::Vertex topRight(sf::Vector2f(left + width, top), color, sf::Vector2f(texture.left + texture.width, texture.top));
+        sf::Vertex bottomLeft(sf::Vector2f(left, top + height), color, sf::Vector2f(texture.left, texture.top + texture.height));
+        sf::Vertex bottomRight(sf::Vector2f(left + width, top + height), color,
+            sf::Vector2f(texture.left + texture.width, texture.top + texture.height));
+        vertices.append(topLeft);
+        vertices.append(topRight);
+        vertices.append(bottomLeft);
+        vertices.append(bottomLeft);
+        vertices.append(topRight);
+        vertices.append(bottomRight);
+    }
+}
+
+PerfOverlay::PerfOverlay(const sf::Font& font) : font(font), glyphs(sf::Triangles), shapes(sf::Triangles) {
+    // Load every glyph the text can use now, so the font never grows while drawing
+    for (sf::Uint32 c = ' '; c <= '~'; ++c) {
+        font.getGlyph(c, overlayTextSize, false);
+    }
+    // And make the arrays as big as they will get, which they then stay
+    glyphs.resize(6 * sizeof(text));
+    glyphs.clear();
+    shapes.resize(6 * (overlayGraphFrames + 3));
+    shapes.clear();
+}
+
+void PerfOverlay::toggle() {
+    shown = !shown;
+    text[0] = '\0';
+    periodSeconds = 0.0f;
+    periodFrames = 0;
+    periodWorstMs = 0.0f;
+    periodTicks = 0;
+    allocationsSeen = allocationCount();
+    bytesSeen = allocatedBytes();
+}
+
+void PerfOverlay::update(const FrameStats& frame, const World& world) {
+    newest = (newest + 1) % overlayGraphFrames;
+    frameMs[newest] = frame.seconds * 1000.0f;
+    if (!shown) {
+        return;
+    }
+
+    periodSeconds += frame.seconds;
+    ++periodFrames;
+    periodWorstMs = std::max(periodWorstMs, frameMs[newest]);
+    periodTicks += frame.ticks;
+    if (text[0] == '\0' || periodSeconds >= textRefreshSeconds) {
+        std::uint64_t allocations = allocationCount();
+        std::uint64_t bytes = allocatedBytes();
+        float frames = static_cast<float>(periodFrames);
+        std::snprintf(text, sizeof(text),
+            "frame %.2f ms, worst %.2f ms (%.0f fps)\n"
+            "ticks/frame %.2f\n"
+            "draw calls %u, vertices %u\n"
+            "enemies %d, rivals %d\n"
+            "heap %.1f allocs, %.1f KB a frame\n"
+            "live KB: maze %.0f, ai %.0f, rendering %.0f\n"
+            "         save %.0f, network %.0f, text %.0f\n"
+            "generateMaze %.2f ms (%dx%d)",
+            periodSeconds * 1000.0f / frames, periodWorstMs, periodSeconds > 0.0f ? frames / periodSeconds : 0.0f,
+            periodTicks / frames,
+            static_cast<unsigned>(frame.draws.drawCalls), static_cast<unsigned>(frame.draws.vertices),
+            frame.enemies, frame.rivals,
+            (allocations - allocationsSeen) / frames, (bytes - bytesSeen) / 1024.0f / frames,
+            liveKB(MemoryTag::Maze), liveKB(MemoryTag::AI), liveKB(MemoryTag::Rendering),
+            liveKB(MemoryTag::Save), liveKB(MemoryTag::Network), liveKB(MemoryTag::Text),
+            world.generateNs / 1e6, world.width, world.height);
+        allocationsSeen = allocations;
+        bytesSeen = bytes;
+        periodSeconds = 0.0f;
+        periodFrames = 0;
+        periodWorstMs = 0.0f;
+        periodTicks = 0;
+        layoutText(text, overlayLeft + overlayPadding, overlayTop + overlayPadding);
+    }
+    buildGraph(overlayLeft + overlayPadding, overlayTop + overlayPadding + textHeight + overlayPadding);
+}
+
+void PerfOverlay::draw(sf::RenderTarget& target, DrawCounts& counts) const {
+    if (!shown) {
+        return;
+    }
+    target.draw(shapes);
+    counts.add(shapes.getVertexCount());
+    target.draw(glyphs, sf::RenderStates(&font.getTexture(overlayTextSize)));
+    counts.add(glyphs.getVertexCount());
+}
+
+// The glyphs of text as textured quads, as sf::Text would lay them out; '\n' starts a line
+void PerfOverlay::layoutText(const char* text, float x, float y) {
+    glyphs.clear();
+    float lineSpacing = font.getLineSpacing(overlayTextSize);
+    float penX = x;
+    float baseline = y + overlayTextSize;
+    int lines = 1;
+    for (const char* c = text; *c; ++c) {
+        if (*c == '\n') {
+            penX = x;
+            baseline += lineSpacing;
+            ++lines;
+            continue;
+        }
+        const sf::Glyph& glyph = font.getGlyph(static_cast<unsigned char>(*c), overlayTextSize, false);
+        sf::FloatRect texture(static_cast<float>(glyph.textureRect.left), static_cast<float>(glyph.textureRect.top),
+            static_cast<float>(glyph.textureRect.width), static_cast<float>(glyph.textureRect.height));
+        appendQuad(glyphs, penX + glyph.bounds.left, baseline + glyph.bounds.top, glyph.bounds.width, glyph.bounds.height,
+            sf::Color::White, texture);
+        penX += glyph.advance;
+    }
+    textHeight = lines * lineSpacing;
+}
+
+// A bar per frame, oldest on the left, over a backdrop for the whole overlay,
+// with lines at the frame times of 60 and 30 frames a second
+void PerfOverlay::buildGraph(float x, float y) {
+    shapes.clear();
+    float width = overlayGraphFrames * barWidth;
+    float bottom = y + graphHeight;
+    appendQuad(shapes, overlayLeft, overlayTop, width + 2 * overlayPadding, bottom + overlayPadding - overlayTop, sf::Color(0, 0, 0, 160));
+    for (std::size_t i = 0; i < overlayGraphFrames; ++i) {
+        float ms = frameMs[(newest + 1 + i) % overlayGraphFrames];
+        sf::Color color = ms > 1000.0f / 30 ? sf::Color::Red : ms > 1000.0f / 60 ? sf::Color::Yellow : sf::Color::Green;
+        float height = std::min(ms, graphHeight);
+        appendQuad(shapes, x + i * barWidth, bottom - height, barWidth, height, color);
+    }
+    appendQuad(shapes, x, bottom - 1000.0f / 60, width, 1.0f, sf::Color(255, 255, 255, 96));
+    appendQuad(shapes, x, bottom - 1000.0f / 30, width, 1.0f, sf::Color(255, 255, 255, 96));
+}
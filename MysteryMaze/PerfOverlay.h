@@ -0,0 +1,79 @@
+#pragma once
+#include <SFML/Graphics/Font.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/VertexArray.hpp>
+#include <cstddef>
+#include <cstdint>
+
+struct World;
+
+// Draw calls made this frame and the vertices they sent
+struct DrawCounts {
+    std::uint32_t drawCalls = 0;
+    std::uint32_t vertices = 0;
+
+    void add(std::size_t drawnVertices) {
+        ++drawCalls;
+        vertices += static_cast<std::uint32_t>(drawnVertices);
+    }
+};
+
+// What one frame cost and did, handed to the overlay once it is over
+struct FrameStats {
+    float seconds = 0.0f;
+    int ticks = 0;        // Simulation ticks run during the frame
+    DrawCounts draws;
+    int enemies = 0;
+    int rivals = 0;       // Ghost and other racers drawn
+};
+
+// Frame statistics drawn in the top-left corner, over the maze: frame time
+// with a graph of the last overlayGraphFrames frames, ticks per frame, draw
+// calls and vertices, what is on the board, heap traffic, live heap bytes
+// per memory tag, and how long the last generateMaze took.
+//
+// Hidden, a frame costs one store into the graph's ring. Shown, it still
+// allocates nothing: the text is laid out from the font's glyphs into
+// vertex arrays that keep their size from frame to frame, and every glyph
+// it can use is loaded up front.
+const std::size_t overlayGraphFrames = 120;
+
+class PerfOverlay {
+public:
+    explicit PerfOverlay(const sf::Font& font);
+
+    // Showing starts the averages afresh
+    void toggle();
+    bool visible() const { return shown; }
+
+    // Once a frame, after it is displayed; the next frame draws the result
+    void update(const FrameStats& frame, const World& world);
+
+    // In the window's default view; adds its own draw calls to counts
+    void draw(sf::RenderTarget& target, DrawCounts& counts) const;
+
+private:
+    void layoutText(const char* text, float x, float y);
+    void buildGraph(float x, float y);
+
+    const sf::Font& font;
+    bool shown = false;
+
+    float frameMs[overlayGraphFrames] = {};
+    std::size_t newest = 0;
+
+    // Averaged over the text's refresh period, so the numbers can be read
+    float periodSeconds = 0.0f;
+    int periodFrames = 0;
+    float periodWorstMs = 0.0f;
+    int periodTicks = 0;
+    std::uint64_t allocationsSeen = 0;
+    std::uint64_t bytesSeen = 0;
+    std::uint64_t periodAllocations = 0;
+    std::uint64_t periodBytes = 0;
+
+    char text[512] = {};
+    float textHeight = 0.0f;
+    sf::VertexArray glyphs;
+    sf::VertexArray shapes; // Backdrop, graph bars and the 60 and 30 fps lines
+};
@@ -0,0 +1,132 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> profilerOn(false);
+
+namespace {
+    struct ProfileEvent {
+        const char* name;
+        std::uint64_t startNs;
+        std::uint64_t endNs;
+    };
+
+    // A slot in a ring. Its fields are atomics only so that a trace being
+    // written may read one the owner is overwriting; such reads are thrown away.
+    struct RingSlot {
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<std::uint64_t> startNs{ 0 };
+        std::atomic<std::uint64_t> endNs{ 0 };
+    };
+
+    // Written only by its own thread. written counts every event ever
+    // recorded, so event i is at i % profileRingEvents until overwritten.
+    struct ThreadRing {
+        std::unique_ptr<RingSlot[]> events{ new RingSlot[profileRingEvents] };
+        std::atomic<std::uint64_t> written{ 0 };
+        std::atomic<const char*> name{ nullptr };
+        int id = 0;
+    };
+
+    // Rings outlive their threads, so a trace still has the zones of a thread that has finished
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    thread_local ThreadRing* threadRing = nullptr;
+    thread_local const char* threadName = nullptr;
+
+    const std::chrono::steady_clock::time_point programStart = std::chrono::steady_clock::now();
+
+    ThreadRing& ownRing() {
+        if (!threadRing) {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.emplace_back(new ThreadRing());
+            threadRing = rings.back().get();
+            threadRing->id = static_cast<int>(rings.size());
+            threadRing->name.store(threadName, std::memory_order_relaxed);
+        }
+        return *threadRing;
+    }
+
+    void writeEscaped(std::FILE* file, const char* text) {
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') {
+                std::fputc('\\', file);
+            }
+            std::fputc(*text, file);
+        }
+    }
+}
+
+void enableProfiler(bool enabled) {
+    profilerOn.store(enabled, std::memory_order_relaxed);
+}
+
+void nameProfilerThread(const char* name) {
+    // The ring itself waits for the thread's first zone, so naming costs nothing while off
+    threadName = name;
+    if (threadRing) {
+        threadRing->name.store(name, std::memory_order_relaxed);
+    }
+}
+
+std::uint64_t profileClockNs() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - programStart).count());
+}
+
+void recordProfileZone(const char* name, std::uint64_t startNs, std::uint64_t endNs) {
+    ThreadRing& ring = ownRing();
+    std::uint64_t index = ring.written.load(std::memory_order_relaxed);
+    RingSlot& slot = ring.events[index % profileRingEvents];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    ring.written.store(index + 1, std::memory_order_release);
+}
+
+bool writeProfileTrace(const std::string& filename) {
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    std::vector<ProfileEvent> copy;
+    copy.reserve(profileRingEvents);
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    bool first = true;
+    for (const std::unique_ptr<ThreadRing>& ring : rings) {
+        const char* name = ring->name.load(std::memory_order_relaxed);
+        std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", first ? "" : ",\n", ring->id);
+        writeEscaped(file, name ? name : "thread");
+        std::fputs("\"}}", file);
+        first = false;
+
+        // Copy the ring, then keep only what the owner cannot have overwritten
+        // while we did, counting the one it may be writing now
+        std::uint64_t end = ring->written.load(std::memory_order_acquire);
+        std::uint64_t begin = end > profileRingEvents ? end - profileRingEvents : 0;
+        copy.clear();
+        for (std::uint64_t i = begin; i < end; ++i) {
+            const RingSlot& slot = ring->events[i % profileRingEvents];
+            copy.push_back(ProfileEvent{ slot.name.load(std::memory_order_relaxed),
+                slot.startNs.load(std::memory_order_relaxed), slot.endNs.load(std::memory_order_relaxed) });
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::uint64_t after = ring->written.load(std::memory_order_acquire);
+        std::uint64_t overwritten = after + 1 > profileRingEvents ? after + 1 - profileRingEvents : 0;
+        for (std::uint64_t i = std::max(begin, overwritten); i < end; ++i) {
+            const ProfileEvent& event = copy[static_cast<std::size_t>(i - begin)];
+            std::fputs(",\n{\"name\":\"", file);
+            writeEscaped(file, event.name);
+            std::fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", ring->id,
+                event.startNs / 1000.0, (event.endNs - event.startNs) / 1000.0);
+        }
+    }
+    std::fputs("\n]}\n", file);
+    return std::fclose(file) == 0;
+}
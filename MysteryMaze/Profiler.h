@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped timers for finding where frame time goes. PROFILE_ZONE("name") at
+// the top of a block times the rest of it; zones nest, and each thread
+// records into a ring of its own, so recording takes no lock and never
+// allocates once the thread's ring exists. The newest profileRingEvents
+// zones of each thread are kept.
+//
+// Zones are always compiled in. While the profiler is off a zone costs one
+// relaxed atomic load and a branch, which is nothing next to the code it
+// wraps. The name must be a string literal, or live as long as the program.
+//
+// writeProfileTrace() writes what the rings hold as Chrome trace-event JSON,
+// for chrome://tracing or ui.perfetto.dev.
+const std::size_t profileRingEvents = 1 << 16;
+
+extern std::atomic<bool> profilerOn;
+
+inline bool profilerEnabled() { return profilerOn.load(std::memory_order_relaxed); }
+void enableProfiler(bool enabled);
+
+// Shown as the calling thread's name in the trace
+void nameProfilerThread(const char* name);
+
+std::uint64_t profileClockNs(); // Since the program started
+void recordProfileZone(const char* name, std::uint64_t startNs, std::uint64_t endNs);
+
+// Every zone still in the rings, oldest first per thread. Threads may keep
+// recording while this runs; zones they overwrite meanwhile are left out.
+bool writeProfileTrace(const std::string& filename);
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name(profilerEnabled() ? name : nullptr), startNs(this->name ? profileClockNs() : 0) {}
+    ~ProfileZone() {
+        if (name) {
+            recordProfileZone(name, startNs, profileClockNs());
+        }
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    std::uint64_t startNs;
+};
+
+#define PROFILE_ZONE_JOIN2(a, b) a##b
+#define PROFILE_ZONE_JOIN(a, b) PROFILE_ZONE_JOIN2(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_ZONE_JOIN(profileZone, __LINE__)(name)
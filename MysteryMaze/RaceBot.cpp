@@ -0,0 +1,23 @@
+#include "RaceBot.h"
+#include "AllocationCounter.h"
+
+char botMove(const World& view, std::vector<std::uint32_t>& toExit, Rng& input) {
+    MemoryTagScope memoryTag(MemoryTag::AI);
+    if (toExit.empty()) {
+        toExit.resize(view.maze.size());
+        buildDistanceField(view, view.exitX, view.exitY, toExit.data());
+    }
+    char move = 0;
+    std::uint32_t best = toExit[view.playerY * view.width + view.playerX];
+    bool wander = input.below(4) == 0;
+    for (const char* step = "WASD"; *step; ++step) {
+        int x = view.playerX + (*step == 'A' ? -1 : *step == 'D' ? 1 : 0);
+        int y = view.playerY + (*step == 'W' ? -1 : *step == 'S' ? 1 : 0);
+        bool open = isWalkable(view, x, y) || view.maze[y][x] == 'P';
+        if (open && (wander ? input.below(2) == 0 : toExit[y * view.width + x] < best)) {
+            move = *step;
+            best = toExit[y * view.width + x];
+        }
+    }
+    return move;
+}
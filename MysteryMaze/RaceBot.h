@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Rng.h"
+#include "World.h"
+
+// A bot player's next move in view, its own racer's world: toward the exit
+// by the distance field in toExit (built on first use), taking a random turn
+// now and then. 0 when it has nowhere better to go. Moves are only chosen
+// here; they still go through movePlayer like a player's keys.
+char botMove(const World& view, std::vector<std::uint32_t>& toExit, Rng& input);
@@ -0,0 +1,276 @@
+#include "RaceClient.h"
+#include "InterestGrid.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <cstdlib>
+
+static const int joinRetryTicks = ticksPerSecond / 2;
+static const std::size_t maxUnackedMoves = 4 * maxMovesPerInput;
+
+RaceClient::RaceClient(World& world) : world(world) {
+    unackedMoves.reserve(maxUnackedMoves);
+    unackedSince.reserve(maxUnackedMoves);
+    states.reserve(maxRacers);
+    decoded.reserve(maxRacers);
+    previousAnswerer = world.answerPuzzle;
+    world.answerPuzzle = openPurpleBlock;
+}
+
+RaceClient::~RaceClient() {
+    world.answerPuzzle = previousAnswerer;
+}
+
+bool RaceClient::connect(const sf::IpAddress& host, unsigned short port) {
+    if (!socket.bind(sf::Socket::AnyPort)) {
+        return false;
+    }
+    hostAddress = host;
+    hostPort = port;
+    ticks = 0;
+    lastHeard = 0;
+    return true;
+}
+
+void RaceClient::tick(const char* moves, std::size_t count) {
+    MemoryTagScope memoryTag(MemoryTag::Network);
+    ++ticks;
+    socket.setTime(nowMs());
+    receive();
+
+    if (!welcomed()) {
+        if (ticks % joinRetryTicks == 1) {
+            WireBuffer* join = socket.acquire();
+            join->putUint8(static_cast<std::uint8_t>(RaceMessage::Join));
+            join->emplace<JoinHeader>()->version = raceProtocolVersion;
+            send(join);
+        }
+        return;
+    }
+
+    // Moves before the start would only be thrown away by the host
+    if (started()) {
+        std::size_t taken = std::min(count, maxUnackedMoves - unackedMoves.size());
+        unackedMoves.append(moves, taken);
+        unackedSince.insert(unackedSince.end(), taken, std::chrono::steady_clock::now());
+        predict(moves, taken);
+    }
+
+    // Every tick while moves are in flight; otherwise just often enough to
+    // acknowledge snapshots and keep the host from timing us out
+    if (!unackedMoves.empty() || ticks - lastSent >= static_cast<std::uint32_t>(snapshotIntervalTicks)) {
+        sendInput();
+    }
+}
+
+void RaceClient::leave() {
+    if (welcomed()) {
+        WireBuffer leaving;
+        leaving.putUint8(static_cast<std::uint8_t>(RaceMessage::Leave));
+        socket.sendNow(leaving, hostAddress, hostPort); // Now, as there are no more ticks to send it on
+    }
+}
+
+void RaceClient::setLag(std::uint32_t roundTripMs) {
+    NetworkConditions toHost;
+    NetworkConditions fromHost;
+    toHost.latencyMs = roundTripMs / 2;
+    fromHost.latencyMs = roundTripMs - roundTripMs / 2;
+    setNetworkConditions(toHost, fromHost, 0);
+}
+
+void RaceClient::setNetworkConditions(const NetworkConditions& toHost, const NetworkConditions& fromHost, std::uint64_t seed) {
+    socket.setConditions(toHost, fromHost, seed);
+}
+
+void RaceClient::printPrediction(std::ostream& out) const {
+    const PredictionStats& p = predictionStats;
+    out << "Prediction: " << p.corrections << " corrections in " << p.reconciliations << " snapshots";
+    if (p.corrections > 0) {
+        out << ", " << static_cast<double>(p.correctedCells) / p.corrections << " cells on average, largest "
+            << p.largestCorrection;
+    }
+    out << std::endl;
+}
+
+bool RaceClient::over() const {
+    if (!started()) {
+        return false;
+    }
+    for (const RacerState& state : states) {
+        if (state.status == RacerStatus::Racing) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int RaceClient::countdownSeconds() const {
+    if (latestSnapshot == noBaseline || startTick == raceNotScheduled || started()) {
+        return 0;
+    }
+    return static_cast<int>((startTick - hostTick + ticksPerSecond - 1) / ticksPerSecond);
+}
+
+void RaceClient::receive() {
+    sf::IpAddress address;
+    unsigned short port;
+    while (WireBuffer* datagram = socket.receive(address, port)) {
+        if (address == hostAddress && port == hostPort) {
+            handleDatagram(*datagram);
+        }
+        socket.release(datagram);
+    }
+}
+
+void RaceClient::handleDatagram(const WireBuffer& datagram) {
+    stats.bytesReceived += datagram.size();
+    ++stats.packetsReceived;
+    lastHeard = ticks;
+
+    WireReader reader(datagram);
+    std::uint8_t type = 0;
+    if (!reader.getUint8(type)) {
+        return;
+    }
+    if (static_cast<RaceMessage>(type) == RaceMessage::Welcome) {
+        handleWelcome(reader);
+    }
+    else if (static_cast<RaceMessage>(type) == RaceMessage::Snapshot && welcomed()) {
+        handleSnapshot(reader);
+    }
+}
+
+void RaceClient::handleWelcome(WireReader& reader) {
+    const WelcomeHeader* welcome = reader.view<WelcomeHeader>();
+    if (welcomed() || !welcome || welcome->version != raceProtocolVersion || welcome->racerId >= maxRacers
+        || !validRaceMazeSize(welcome->width, welcome->height)) {
+        return;
+    }
+
+    // Same seed and size as the host, so the same maze, blocks, power-up and enemy
+    world.seed = welcome->seed;
+    world.width = welcome->width;
+    world.height = welcome->height;
+    world.level = welcome->level;
+    world.showMessages = false;
+    startLevel(world);
+    levelBlocks.assign(world.purpleBlocks.begin(), world.purpleBlocks.end());
+    racerId = welcome->racerId;
+}
+
+void RaceClient::handleSnapshot(WireReader& reader) {
+    const SnapshotHeader* header = reader.view<SnapshotHeader>();
+    if (!header) {
+        return;
+    }
+    std::uint32_t sequence = header->sequence;
+    std::uint32_t baselineSequence = header->baseline;
+    if (latestSnapshot != noBaseline && sequence <= latestSnapshot) {
+        return; // Late or duplicated
+    }
+
+    static const std::vector<RacerState> none;
+    const std::vector<RacerState>* baseline = baselineSequence == noBaseline ? &none : history.find(baselineSequence);
+    if (!baseline) {
+        return; // The host will fall back to a full snapshot once our ack is too old
+    }
+
+    // Everything is against the baseline: our own racer's fields, the roster
+    // if it changed and the racers near us. The others stay where they were
+    // last seen.
+    RacerState own = racerId < static_cast<int>(baseline->size()) ? (*baseline)[racerId] : RacerState();
+    std::uint8_t hasRoster = 0;
+    std::uint32_t view = 0;
+    decoded = baseline->empty() ? states : *baseline;
+    if (!readRacerFields(reader, own) || !reader.getUint8(hasRoster) || (hasRoster && !readRoster(reader, decoded))
+        || racerId >= static_cast<int>(decoded.size())) {
+        return;
+    }
+    decoded[racerId] = own;
+    if (!readNearbyRacers(reader, decoded, racerId, view)) {
+        return;
+    }
+    nearby = view;
+    history.store(sequence, decoded);
+    states.swap(decoded);
+    if (latestSnapshot != noBaseline) {
+        skippedCount += sequence - latestSnapshot - 1;
+    }
+    latestSnapshot = sequence;
+    ++snapshotCount;
+    hostTick = header->hostTick;
+    startTick = header->startTick;
+    std::uint32_t movesApplied = header->movesApplied;
+
+    // Moves the host has applied never need sending again
+    if (movesApplied > firstUnacked) {
+        std::size_t applied = std::min<std::size_t>(movesApplied - firstUnacked, unackedMoves.size());
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < applied; ++i) {
+            moveLatencyUs.record(static_cast<std::uint32_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(now - unackedSince[i]).count()));
+        }
+        unackedMoves.erase(0, applied);
+        unackedSince.erase(unackedSince.begin(), unackedSince.begin() + applied);
+        firstUnacked = movesApplied;
+    }
+
+    if (racerId < static_cast<int>(states.size())) {
+        reconcile();
+    }
+}
+
+void RaceClient::reconcile() {
+    int predictedX = world.playerX;
+    int predictedY = world.playerY;
+
+    // Rewind to the host's word, then replay the moves it has yet to apply.
+    // A state that would put us outside the maze is not the host's word.
+    if (!applyRacerState(world, levelBlocks, states[racerId])) {
+        return;
+    }
+    predict(unackedMoves.data(), unackedMoves.size());
+
+    std::uint32_t distance = static_cast<std::uint32_t>(std::abs(world.playerX - predictedX) + std::abs(world.playerY - predictedY));
+    ++predictionStats.reconciliations;
+    if (distance > 0) {
+        ++predictionStats.corrections;
+        predictionStats.correctedCells += distance;
+        predictionStats.largestCorrection = std::max(predictionStats.largestCorrection, distance);
+        predictionStats.lastCorrection = distance;
+    }
+}
+
+void RaceClient::predict(const char* moves, std::size_t count) {
+    // The host stops taking moves once a racer is out or home
+    if (racerId >= static_cast<int>(states.size()) || states[racerId].status != RacerStatus::Racing) {
+        return;
+    }
+    for (std::size_t i = 0; i < count && !isExitReached(world); ++i) {
+        movePlayer(world, moves[i]);
+    }
+}
+
+void RaceClient::sendInput() {
+    std::size_t count = std::min<std::size_t>(unackedMoves.size(), maxMovesPerInput);
+    WireBuffer* datagram = socket.acquire();
+    datagram->putUint8(static_cast<std::uint8_t>(RaceMessage::Input));
+    InputHeader* input = datagram->emplace<InputHeader>();
+    input->newestSnapshot = latestSnapshot;
+    input->firstMove = firstUnacked;
+    input->count = static_cast<std::uint8_t>(count);
+    datagram->append(unackedMoves.data(), count);
+    send(datagram);
+    lastSent = ticks;
+}
+
+void RaceClient::send(WireBuffer* datagram) {
+    // Counted as it leaves us, whatever the emulated link then does to it
+    stats.bytesSent += datagram->size();
+    ++stats.packetsSent;
+    socket.send(datagram, hostAddress, hostPort);
+}
+
+std::uint32_t RaceClient::nowMs() const {
+    return static_cast<std::uint32_t>(ticks * 1000ull / ticksPerSecond);
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <SFML/Network/IpAddress.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Histogram.h"
+#include "NetworkEmulator.h"
+#include "RaceProtocol.h"
+#include "WireBuffer.h"
+#include "World.h"
+
+// How far the host's word moved our own racer from where we had predicted
+struct PredictionStats {
+    std::uint32_t reconciliations = 0;   // Snapshots our racer was rewound to
+    std::uint32_t corrections = 0;       // Of those, the ones that moved the player
+    std::uint32_t correctedCells = 0;    // Total distance moved, in cells
+    std::uint32_t largestCorrection = 0;
+    std::uint32_t lastCorrection = 0;
+};
+
+// A player in someone else's race. The world passed in is a copy for
+// drawing: its maze comes from the seed in the Welcome, and its enemy,
+// blocks and timer from the host's snapshots. It is never stepped. Of the
+// other racers we only hear how they stand and, when near, where they are.
+//
+// The player is predicted rather than waited for: each move goes through
+// movePlayer the moment it is made and is kept until the host says it has
+// applied it. Every snapshot rewinds our racer to the host's state and
+// replays the moves still outstanding on top, so a misprediction (say the
+// enemy caught us first) is corrected without ever undoing a move the host
+// has yet to see.
+class RaceClient {
+public:
+    explicit RaceClient(World& world);
+    ~RaceClient();
+
+    RaceClient(const RaceClient&) = delete;
+    RaceClient& operator=(const RaceClient&) = delete;
+
+    // Start asking to join; the Welcome arrives during a later tick()
+    bool connect(const sf::IpAddress& host, unsigned short port);
+
+    // Called once per fixed tick: read what the host sent, then send the
+    // moves it has not acknowledged yet
+    void tick(const char* moves, std::size_t count);
+
+    // Tell the host we are gone rather than letting it time out
+    void leave();
+
+    // Hold back datagrams both ways to try the race on one machine as if the
+    // host were far away; half the round trip each way
+    void setLag(std::uint32_t roundTripMs);
+
+    // Or put a whole emulated link in between, each way, with its drops and
+    // delays drawn from the seed
+    void setNetworkConditions(const NetworkConditions& toHost, const NetworkConditions& fromHost, std::uint64_t seed);
+    const EmulatorStats& toHostStats() const { return socket.outgoingStats(); }
+    const EmulatorStats& fromHostStats() const { return socket.incomingStats(); }
+
+    bool welcomed() const { return racerId >= 0; }
+    bool timedOut() const { return ticks - lastHeard > static_cast<std::uint32_t>(raceTimeoutTicks); }
+    bool started() const { return latestSnapshot != noBaseline && hostTick >= startTick; }
+    bool over() const;
+    int countdownSeconds() const; // As of the last snapshot; 0 while racers are still joining
+    int id() const { return racerId; }
+
+    // Every racer's status, but only where the ones near us are: the rest
+    // keep the position they were last seen at
+    const std::vector<RacerState>& racers() const { return states; }
+    bool inView(int id) const { return id == racerId || (nearby & (1u << id)) != 0; }
+
+    const TrafficStats& traffic() const { return stats; }
+    std::uint32_t snapshotsReceived() const { return snapshotCount; }
+    std::uint32_t snapshotsSkipped() const { return skippedCount; } // Never arrived, or not before a newer one
+
+    // Wall time from a move being made to the snapshot saying the host has
+    // applied it, in microseconds: the delay a player feels on every key
+    const Histogram& moveLatency() const { return moveLatencyUs; }
+    void clearMoveLatency() { moveLatencyUs.clear(); }
+    std::uint32_t ticksConnected() const { return ticks; }
+    const PredictionStats& prediction() const { return predictionStats; }
+    void printPrediction(std::ostream& out) const;
+
+private:
+    void receive();
+    void handleDatagram(const WireBuffer& datagram);
+    void handleWelcome(WireReader& reader);
+    void handleSnapshot(WireReader& reader);
+    void reconcile();
+    void predict(const char* moves, std::size_t count);
+    void sendInput();
+    void send(WireBuffer* datagram); // Out across the emulated link once due
+    std::uint32_t nowMs() const;
+
+    World& world;
+    PuzzleAnswerer previousAnswerer;
+    EmulatedSocket socket; // Every datagram goes through its links, lag or not
+    sf::IpAddress hostAddress;
+    unsigned short hostPort = 0;
+    int racerId = -1;
+    BlockList levelBlocks;
+
+    SnapshotHistory history;
+    std::vector<RacerState> states;
+    std::vector<RacerState> decoded;
+    std::uint32_t nearby = 0; // Bit per racer in the last snapshot's interest chunks
+    std::uint32_t latestSnapshot = noBaseline;
+    std::uint32_t snapshotCount = 0;
+    std::uint32_t skippedCount = 0;
+    std::uint32_t hostTick = 0;
+    std::uint32_t startTick = raceNotScheduled;
+
+    std::string unackedMoves;    // Sent but not yet applied by the host, oldest first
+    std::uint32_t firstUnacked = 0; // Sequence of unackedMoves[0]
+    std::vector<std::chrono::steady_clock::time_point> unackedSince; // When each of unackedMoves was made
+    Histogram moveLatencyUs;
+
+    std::uint32_t ticks = 0;
+    std::uint32_t lastHeard = 0;
+    std::uint32_t lastSent = 0;
+    TrafficStats stats;
+    PredictionStats predictionStats;
+};
@@ -0,0 +1,34 @@
+#include "RaceHost.h"
+#include "AllocationCounter.h"
+
+RaceHost::RaceHost(World& localWorld, int expectedRacers) : localWorld(localWorld), room(socket) {
+    previousAnswerer = localWorld.answerPuzzle;
+    localWorld.answerPuzzle = openPurpleBlock;
+    room.open(localWorld.seed, localWorld.width, localWorld.height, expectedRacers, &localWorld);
+}
+
+RaceHost::~RaceHost() {
+    localWorld.answerPuzzle = previousAnswerer;
+}
+
+bool RaceHost::listen(unsigned short port) {
+    if (socket.bind(port) != sf::Socket::Done) {
+        return false;
+    }
+    socket.setBlocking(false);
+    return true;
+}
+
+void RaceHost::tick(const char* localMoves, std::size_t count) {
+    MemoryTagScope memoryTag(MemoryTag::Network);
+    sf::IpAddress address;
+    unsigned short port;
+    while (receiveDatagram(socket, incoming, address, port) == sf::Socket::Done) {
+        WireReader reader(incoming);
+        std::uint8_t type = 0;
+        if (reader.getUint8(type)) {
+            room.receive(static_cast<RaceMessage>(type), address, port, incoming.size(), reader);
+        }
+    }
+    room.tick(localMoves, count);
+}
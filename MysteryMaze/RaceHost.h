@@ -0,0 +1,43 @@
+#pragma once
+#include <SFML/Network/UdpSocket.hpp>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+#include "RaceRoom.h"
+#include "WireBuffer.h"
+#include "World.h"
+
+// A race hosted from inside the game: one room on its own socket, with the
+// host's own player as racer 0. Everyone else joins over the network.
+class RaceHost {
+public:
+    // localWorld must already hold the level to race on. Its purple blocks
+    // open without a puzzle until the host is destroyed.
+    RaceHost(World& localWorld, int expectedRacers);
+    ~RaceHost();
+
+    RaceHost(const RaceHost&) = delete;
+    RaceHost& operator=(const RaceHost&) = delete;
+
+    // Bind the socket; port 0 picks a free one
+    bool listen(unsigned short port);
+    unsigned short port() const { return socket.getLocalPort(); }
+
+    // One fixed tick: read every datagram waiting, then tick the room
+    void tick(const char* localMoves, std::size_t count);
+
+    const std::vector<RacerState>& racers() const { return room.racers(); }
+    int joined() const { return room.joined(); }
+    bool started() const { return room.started(); }
+    bool over() const { return room.over(); }
+    int countdownSeconds() const { return room.countdownSeconds(); }
+    const TrafficStats& traffic() const { return room.traffic(); }
+    void printTraffic(std::ostream& out) const { room.printTraffic(out); }
+
+private:
+    World& localWorld;
+    PuzzleAnswerer previousAnswerer;
+    sf::UdpSocket socket;
+    RaceRoom room;
+    WireBuffer incoming;
+};
@@ -0,0 +1,196 @@
+#include "RaceProtocol.h"
+#include <algorithm>
+#include <cmath>
+
+// Field bits of a racer's state in a snapshot, against its baseline
+enum RacerField : std::uint8_t {
+    StatusField = 1 << 0,
+    FlagsField = 1 << 1,
+    XField = 1 << 2,
+    YField = 1 << 3,
+    EnemyXField = 1 << 4,
+    EnemyYField = 1 << 5,
+    SecondsLeftField = 1 << 6,
+    FinishTicksField = 1 << 7,
+};
+
+int openPurpleBlock(const AdditionQuestion& question) {
+    return question.correctAnswer;
+}
+
+bool operator==(const RacerState& left, const RacerState& right) {
+    return left.status == right.status && left.flags == right.flags && left.x == right.x && left.y == right.y
+        && left.enemyX == right.enemyX && left.enemyY == right.enemyY && left.secondsLeft == right.secondsLeft
+        && left.finishTicks == right.finishTicks;
+}
+
+RacerState racerStateOf(const World& world, const BlockList& levelBlocks, RacerStatus status, std::uint32_t finishTicks) {
+    RacerState state;
+    state.status = status;
+    state.flags = world.powerUpActive ? racerPowerUpFlag : 0;
+    for (std::size_t i = 0; i < levelBlocks.size(); ++i) {
+        if (std::find(world.purpleBlocks.begin(), world.purpleBlocks.end(), levelBlocks[i]) != world.purpleBlocks.end()) {
+            state.flags |= static_cast<std::uint8_t>(1u << (racerFirstBlockBit + i));
+        }
+    }
+    state.x = static_cast<std::int16_t>(world.playerX);
+    state.y = static_cast<std::int16_t>(world.playerY);
+    state.enemyX = static_cast<std::int16_t>(world.enemy.x);
+    state.enemyY = static_cast<std::int16_t>(world.enemy.y);
+    state.secondsLeft = static_cast<std::uint16_t>(std::ceil(std::max(0.0f, remainingTime(world))));
+    state.finishTicks = finishTicks;
+    return state;
+}
+
+bool validRaceMazeSize(int width, int height) {
+    auto valid = [](int size) { return size >= 5 && size <= maxRaceMazeSize && size % 2 == 1; };
+    return valid(width) && valid(height);
+}
+
+bool applyRacerState(World& world, const BlockList& levelBlocks, const RacerState& state) {
+    auto inside = [&world](int x, int y) { return x > 0 && y > 0 && x < world.width - 1 && y < world.height - 1; };
+    if (!inside(state.x, state.y) || !inside(state.enemyX, state.enemyY)) {
+        return false;
+    }
+    world.playerX = state.x;
+    world.playerY = state.y;
+    world.enemy.x = state.enemyX;
+    world.enemy.y = state.enemyY;
+    world.powerUpActive = (state.flags & racerPowerUpFlag) != 0;
+    world.timeLimit = state.secondsLeft;
+    world.levelTicks = 0;
+
+    world.purpleBlocks.clear();
+    for (std::size_t i = 0; i < levelBlocks.size(); ++i) {
+        bool standing = (state.flags & (1u << (racerFirstBlockBit + i))) != 0;
+        world.maze[levelBlocks[i].second][levelBlocks[i].first] = standing ? 'P' : ' ';
+        if (standing) {
+            world.purpleBlocks.push_back(levelBlocks[i]);
+        }
+    }
+    return true;
+}
+
+void writeRacerFields(WireBuffer& buffer, const RacerState& before, const RacerState& now) {
+    std::uint8_t fields = (now.status != before.status ? StatusField : 0) | (now.flags != before.flags ? FlagsField : 0)
+        | (now.x != before.x ? XField : 0) | (now.y != before.y ? YField : 0)
+        | (now.enemyX != before.enemyX ? EnemyXField : 0) | (now.enemyY != before.enemyY ? EnemyYField : 0)
+        | (now.secondsLeft != before.secondsLeft ? SecondsLeftField : 0)
+        | (now.finishTicks != before.finishTicks ? FinishTicksField : 0);
+    buffer.putUint8(fields);
+    if (fields & StatusField) {
+        buffer.putUint8(static_cast<std::uint8_t>(now.status));
+    }
+    if (fields & FlagsField) {
+        buffer.putUint8(now.flags);
+    }
+    if (fields & XField) {
+        buffer.put(LittleInt16(now.x));
+    }
+    if (fields & YField) {
+        buffer.put(LittleInt16(now.y));
+    }
+    if (fields & EnemyXField) {
+        buffer.put(LittleInt16(now.enemyX));
+    }
+    if (fields & EnemyYField) {
+        buffer.put(LittleInt16(now.enemyY));
+    }
+    if (fields & SecondsLeftField) {
+        buffer.put(LittleUint16(now.secondsLeft));
+    }
+    if (fields & FinishTicksField) {
+        buffer.put(LittleUint32(now.finishTicks));
+    }
+}
+
+// One field of a racer, if its bit is set; false if the datagram ran out
+template <typename Wire, typename Field>
+static bool readField(WireReader& reader, std::uint8_t fields, std::uint8_t bit, Field& field) {
+    if (!(fields & bit)) {
+        return true;
+    }
+    Wire value;
+    if (!reader.get(value)) {
+        return false;
+    }
+    field = static_cast<Field>(value);
+    return true;
+}
+
+bool readRacerFields(WireReader& reader, RacerState& state) {
+    std::uint8_t fields = 0;
+    std::uint8_t status = static_cast<std::uint8_t>(state.status);
+    if (!reader.getUint8(fields) || !readField<std::uint8_t>(reader, fields, StatusField, status)
+        || !readField<std::uint8_t>(reader, fields, FlagsField, state.flags)
+        || !readField<LittleInt16>(reader, fields, XField, state.x)
+        || !readField<LittleInt16>(reader, fields, YField, state.y)
+        || !readField<LittleInt16>(reader, fields, EnemyXField, state.enemyX)
+        || !readField<LittleInt16>(reader, fields, EnemyYField, state.enemyY)
+        || !readField<LittleUint16>(reader, fields, SecondsLeftField, state.secondsLeft)
+        || !readField<LittleUint32>(reader, fields, FinishTicksField, state.finishTicks)
+        || status > static_cast<std::uint8_t>(RacerStatus::Out)) {
+        return false;
+    }
+    state.status = static_cast<RacerStatus>(status);
+    return true;
+}
+
+bool sameRoster(const std::vector<RacerState>& left, const std::vector<RacerState>& right) {
+    if (left.size() != right.size()) {
+        return false;
+    }
+    for (std::size_t id = 0; id < left.size(); ++id) {
+        if (left[id].status != right[id].status || left[id].finishTicks != right[id].finishTicks) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void writeRoster(WireBuffer& buffer, const std::vector<RacerState>& racers) {
+    buffer.putUint8(static_cast<std::uint8_t>(racers.size()));
+    for (const RacerState& racer : racers) {
+        buffer.putUint8(static_cast<std::uint8_t>(racer.status));
+        if (racer.status == RacerStatus::Finished) {
+            buffer.put(LittleUint32(racer.finishTicks));
+        }
+    }
+}
+
+bool readRoster(WireReader& reader, std::vector<RacerState>& racers) {
+    std::uint8_t count = 0;
+    if (!reader.getUint8(count) || count > maxRacers) {
+        return false;
+    }
+    racers.resize(count);
+    for (RacerState& racer : racers) {
+        std::uint8_t status = 0;
+        if (!reader.getUint8(status) || status > static_cast<std::uint8_t>(RacerStatus::Out)) {
+            return false;
+        }
+        racer.status = static_cast<RacerStatus>(status);
+        LittleUint32 finishTicks;
+        if (racer.status == RacerStatus::Finished) {
+            if (!reader.get(finishTicks)) {
+                return false;
+            }
+            racer.finishTicks = finishTicks;
+        }
+    }
+    return true;
+}
+
+void SnapshotHistory::store(std::uint32_t sequence, const std::vector<RacerState>& racers) {
+    Entry& entry = entries[sequence % entries.size()];
+    entry.sequence = sequence;
+    entry.racers = racers; // Reuses the entry's capacity once the ring has gone round
+}
+
+const std::vector<RacerState>* SnapshotHistory::find(std::uint32_t sequence) const {
+    if (sequence == noBaseline) {
+        return nullptr;
+    }
+    const Entry& entry = entries[sequence % entries.size()];
+    return entry.sequence == sequence ? &entry.racers : nullptr;
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "WireBuffer.h"
+#include "World.h"
+
+// Race mode: every player runs the same seed and the first to the exit wins.
+// The host simulates every racer's world and is the only one that does; the
+// clients generate the maze from the seed in the Welcome message and draw
+// what the snapshots tell them.
+//
+// Every datagram is a uint8 RaceMessage followed by that message's header,
+// a fixed-layout struct of little-endian fields (see WireBuffer.h):
+//   Join      client -> host  JoinHeader
+//   Welcome   host -> client  WelcomeHeader
+//   Input     client -> host  InputHeader, then count moves. Every move not yet acknowledged
+//                             is resent, so a lost datagram costs nothing but latency.
+//   Snapshot  host -> client  SnapshotHeader, the client's own racer as fields changed since
+//                             the baseline, uint8 1 and the roster if it changed since the
+//                             baseline (else 0), then the nearby racers' positions as
+//                             InterestGrid chunks, or sameNearbyChunks if none of them
+//                             changed since the baseline
+//   Leave     client -> host  (none)
+//
+// Snapshots go out at a fixed rate rather than every tick. A client needs
+// everything about its own racer, but of the others only where the ones near
+// it are and how the race stands, so that is all it gets: its own racer's
+// fields that changed since the newest snapshot it has acknowledged, every
+// status when one changes, and positions from the interest grid.
+const unsigned short defaultRacePort = 53001;
+const std::uint16_t raceProtocolVersion = 4;
+const int maxRacers = 8;
+const int snapshotIntervalTicks = ticksPerSecond / 20; // 20 snapshots a second
+const int raceCountdownTicks = 3 * ticksPerSecond;
+const int raceTimeoutTicks = 5 * ticksPerSecond; // Silence before a peer is given up on
+const std::size_t snapshotHistory = 32; // Snapshots kept to delta against
+const int maxMovesPerInput = 64;
+const std::uint32_t noBaseline = 0xffffffff;
+const std::uint32_t raceNotScheduled = 0xffffffff;
+const int maxRaceMazeSize = 32767; // Positions go over the wire as int16
+
+enum class RaceMessage : std::uint8_t {
+    Join = 1,
+    Welcome = 2,
+    Input = 3,
+    Snapshot = 4,
+    Leave = 5,
+};
+
+enum class RacerStatus : std::uint8_t {
+    Racing = 0,
+    Finished = 1,
+    Out = 2, // Caught, out of time, or disconnected
+};
+
+// Puzzles have nobody to answer them in a race, so purple blocks simply
+// open, on the host and in a client's prediction alike
+int openPurpleBlock(const AdditionQuestion& question);
+
+struct JoinHeader {
+    LittleUint16 version;
+};
+
+struct WelcomeHeader {
+    LittleUint16 version;
+    std::uint8_t racerId = 0;
+    LittleUint32 seed;
+    LittleInt32 width, height, level;
+};
+
+struct InputHeader {
+    LittleUint32 newestSnapshot; // Received, or noBaseline
+    LittleUint32 firstMove;      // Sequence of the first move that follows
+    std::uint8_t count = 0;
+};
+
+struct SnapshotHeader {
+    LittleUint32 sequence;
+    LittleUint32 baseline;       // Or noBaseline
+    LittleUint32 hostTick;
+    LittleUint32 startTick;      // Or raceNotScheduled while racers are still joining
+    LittleUint32 movesApplied;
+};
+
+// What the other end needs to draw one racer
+struct RacerState {
+    RacerStatus status = RacerStatus::Racing;
+    std::uint8_t flags = 0; // racerPowerUpFlag, then a bit per purple block still in place
+    std::int16_t x = 0, y = 0;
+    std::int16_t enemyX = 0, enemyY = 0;
+    std::uint16_t secondsLeft = 0;
+    std::uint32_t finishTicks = 0; // Ticks from the start to the exit
+};
+
+const std::uint8_t racerPowerUpFlag = 1;
+const int racerFirstBlockBit = 1;
+
+bool operator==(const RacerState& left, const RacerState& right);
+inline bool operator!=(const RacerState& left, const RacerState& right) { return !(left == right); }
+
+// Every racer starts with the same purple blocks, levelBlocks, so the state
+// only needs a bit for each one still standing
+using BlockList = std::vector<std::pair<int, int>>;
+RacerState racerStateOf(const World& world, const BlockList& levelBlocks, RacerStatus status, std::uint32_t finishTicks);
+
+// Whether a maze size from the network is one startLevel can build safely:
+// odd, at least 5 and small enough for int16 positions
+bool validRaceMazeSize(int width, int height);
+
+// Bring a client's copy of the level in line with its own racer's state.
+// False, with the world untouched, if the player or enemy would be outside
+// the maze's inner cells; the game relies on the outer wall to stop moves.
+bool applyRacerState(World& world, const BlockList& levelBlocks, const RacerState& state);
+
+// The fields of a racer's state that differ from before: a uint8 bit mask,
+// then those fields. Reading fails on an unknown status.
+void writeRacerFields(WireBuffer& buffer, const RacerState& before, const RacerState& now);
+bool readRacerFields(WireReader& reader, RacerState& state);
+
+// Every racer's status, and finish time once finished: uint8 count, then per
+// racer uint8 status and, if finished, uint32 finish ticks. Reading resizes
+// racers to the count and leaves their other fields alone.
+bool sameRoster(const std::vector<RacerState>& left, const std::vector<RacerState>& right);
+void writeRoster(WireBuffer& buffer, const std::vector<RacerState>& racers);
+bool readRoster(WireReader& reader, std::vector<RacerState>& racers);
+
+// Snapshots by sequence number, as either end keeps them for deltas
+class SnapshotHistory {
+public:
+    SnapshotHistory() : entries(snapshotHistory) {}
+
+    void store(std::uint32_t sequence, const std::vector<RacerState>& racers);
+    const std::vector<RacerState>* find(std::uint32_t sequence) const;
+
+private:
+    struct Entry {
+        std::uint32_t sequence = noBaseline;
+        std::vector<RacerState> racers;
+    };
+    std::vector<Entry> entries;
+};
+
+// Traffic through one socket or to one peer, payload bytes only
+struct TrafficStats {
+    std::uint64_t bytesSent = 0;
+    std::uint64_t bytesReceived = 0;
+    std::uint64_t packetsSent = 0;
+    std::uint64_t packetsReceived = 0;
+};
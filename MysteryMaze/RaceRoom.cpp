@@ -0,0 +1,313 @@
+#include "RaceRoom.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <cstdio>
+
+RaceRoom::RaceRoom(sf::UdpSocket& socket) : socket(socket) {
+    entrants.reserve(maxRacers);
+    states.reserve(maxRacers);
+    rosterStates.reserve(maxRacers);
+}
+
+void RaceRoom::open(std::uint32_t seed, int width, int height, int expectedRacers, World* localWorld) {
+    levelSeed = seed;
+    levelWidth = width;
+    levelHeight = height;
+    expected = std::max(1, std::min(expectedRacers, maxRacers));
+    entrants.clear();
+    states.clear();
+    rosterStates.clear();
+    levelBlocks.clear();
+    interest.reset(width, height);
+    everyoneJoined = false;
+    startTick = 0;
+    overTick = 0;
+
+    if (localWorld) {
+        entrants.emplace_back();
+        entrants[0].world = localWorld;
+        levelBlocks.assign(localWorld->purpleBlocks.begin(), localWorld->purpleBlocks.end());
+    }
+}
+
+void RaceRoom::tick(const char* localMoves, std::size_t count) {
+    MemoryTagScope memoryTag(MemoryTag::Network);
+    ++roomTick;
+    if (!everyoneJoined && joined() >= expected) {
+        everyoneJoined = true;
+        startTick = roomTick + raceCountdownTicks;
+    }
+
+    if (!entrants.empty() && !entrants[0].remote) {
+        entrants[0].pendingMoves.append(localMoves, count);
+    }
+    for (Racer& racer : entrants) {
+        if (!started()) {
+            racer.pendingMoves.clear(); // Nobody moves during the countdown
+            continue;
+        }
+        if (racer.remote && racer.status == RacerStatus::Racing && silent(racer)) {
+            racer.status = RacerStatus::Out;
+        }
+        stepRacer(racer);
+    }
+
+    states.resize(entrants.size());
+    for (std::size_t id = 0; id < entrants.size(); ++id) {
+        states[id] = racerStateOf(*entrants[id].world, levelBlocks, entrants[id].status, entrants[id].finishTicks);
+    }
+
+    if (overTick == 0 && over()) {
+        overTick = roomTick;
+    }
+    if (roomTick % snapshotIntervalTicks == 0) {
+        sendSnapshots();
+    }
+}
+
+void RaceRoom::stepRacer(Racer& racer) {
+    if (racer.status != RacerStatus::Racing) {
+        racer.pendingMoves.clear();
+        return;
+    }
+    std::size_t moveCount = racer.pendingMoves.empty() ? 0 : 1;
+    TickResult result = stepWorld(*racer.world, racer.pendingMoves.data(), moveCount);
+    racer.pendingMoves.erase(0, moveCount);
+
+    if (result == TickResult::ExitReached) {
+        racer.status = RacerStatus::Finished;
+        racer.finishTicks = roomTick - startTick;
+    }
+    else if (result != TickResult::Playing) {
+        racer.status = RacerStatus::Out;
+    }
+}
+
+bool RaceRoom::over() const {
+    if (!started()) {
+        return false;
+    }
+    for (const Racer& racer : entrants) {
+        if (racer.status == RacerStatus::Racing) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int RaceRoom::countdownSeconds() const {
+    if (!everyoneJoined || started()) {
+        return 0;
+    }
+    return static_cast<int>((startTick - roomTick + ticksPerSecond - 1) / ticksPerSecond);
+}
+
+bool RaceRoom::silent(const Racer& racer) const {
+    return roomTick - racer.lastHeard > static_cast<std::uint32_t>(raceTimeoutTicks);
+}
+
+RaceRoom::Racer* RaceRoom::findRacer(const sf::IpAddress& address, unsigned short port) {
+    for (Racer& racer : entrants) {
+        if (racer.remote && racer.address == address && racer.port == port) {
+            return &racer;
+        }
+    }
+    return nullptr;
+}
+
+bool RaceRoom::hasRacer(const sf::IpAddress& address, unsigned short port) const {
+    for (const Racer& racer : entrants) {
+        if (racer.remote && racer.address == address && racer.port == port) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RaceRoom::idle() const {
+    if (overTick != 0 && roomTick - overTick > static_cast<std::uint32_t>(raceTimeoutTicks)) {
+        return true;
+    }
+    bool anyRemote = false;
+    for (const Racer& racer : entrants) {
+        if (racer.remote && !silent(racer)) {
+            return false;
+        }
+        anyRemote = anyRemote || racer.remote;
+    }
+    return anyRemote;
+}
+
+void RaceRoom::receive(RaceMessage type, const sf::IpAddress& address, unsigned short port, std::size_t size, WireReader& reader) {
+    total.bytesReceived += size;
+    ++total.packetsReceived;
+    if (type == RaceMessage::Join) {
+        handleJoin(address, port, reader);
+        return;
+    }
+
+    Racer* racer = findRacer(address, port);
+    if (!racer) {
+        return;
+    }
+    racer->lastHeard = roomTick;
+    racer->traffic.bytesReceived += size;
+    ++racer->traffic.packetsReceived;
+    if (type == RaceMessage::Input) {
+        handleInput(*racer, reader);
+    }
+    else if (type == RaceMessage::Leave && racer->status == RacerStatus::Racing) {
+        racer->status = RacerStatus::Out;
+    }
+}
+
+void RaceRoom::handleJoin(const sf::IpAddress& address, unsigned short port, WireReader& reader) {
+    const JoinHeader* join = reader.view<JoinHeader>();
+    if (!join || join->version != raceProtocolVersion) {
+        return;
+    }
+
+    // A repeated Join means the Welcome went missing
+    for (std::size_t id = 0; id < entrants.size(); ++id) {
+        if (entrants[id].remote && entrants[id].address == address && entrants[id].port == port) {
+            entrants[id].lastHeard = roomTick;
+            sendWelcome(entrants[id], id);
+            return;
+        }
+    }
+    if (!accepting()) {
+        return; // Full, or already racing
+    }
+
+    Racer racer;
+    racer.ownWorld.reset(new World());
+    World& world = *racer.ownWorld;
+    world.width = levelWidth;
+    world.height = levelHeight;
+    world.seed = levelSeed;
+    world.showMessages = false;
+    world.answerPuzzle = openPurpleBlock;
+    startLevel(world);
+    if (entrants.empty()) {
+        levelBlocks.assign(world.purpleBlocks.begin(), world.purpleBlocks.end());
+    }
+
+    racer.world = racer.ownWorld.get();
+    racer.remote = true;
+    racer.address = address;
+    racer.port = port;
+    racer.lastHeard = roomTick;
+    racer.joinTick = roomTick;
+    entrants.push_back(std::move(racer));
+    sendWelcome(entrants.back(), entrants.size() - 1);
+}
+
+void RaceRoom::handleInput(Racer& racer, WireReader& reader) {
+    const InputHeader* input = reader.view<InputHeader>();
+    if (!input) {
+        return;
+    }
+    std::uint32_t ackedSnapshot = input->newestSnapshot;
+    std::uint32_t firstMove = input->firstMove;
+    if (racer.ackedSnapshot == noBaseline || (ackedSnapshot != noBaseline && ackedSnapshot > racer.ackedSnapshot)) {
+        racer.ackedSnapshot = ackedSnapshot;
+    }
+
+    // Moves already received are resent until they are acknowledged; skip those
+    for (std::uint32_t i = 0; i < input->count; ++i) {
+        std::uint8_t move = 0;
+        if (!reader.getUint8(move)) {
+            return;
+        }
+        if (firstMove + i == racer.movesReceived && racer.pendingMoves.size() < 2 * maxMovesPerInput) {
+            racer.pendingMoves.push_back(static_cast<char>(move));
+            ++racer.movesReceived;
+        }
+    }
+}
+
+void RaceRoom::sendWelcome(Racer& racer, std::size_t id) {
+    const World& world = *racer.world;
+    outgoing.clear();
+    outgoing.putUint8(static_cast<std::uint8_t>(RaceMessage::Welcome));
+    WelcomeHeader* welcome = outgoing.emplace<WelcomeHeader>();
+    welcome->version = raceProtocolVersion;
+    welcome->racerId = static_cast<std::uint8_t>(id);
+    welcome->seed = world.seed;
+    welcome->width = world.width;
+    welcome->height = world.height;
+    welcome->level = world.level;
+    send(racer, outgoing);
+}
+
+void RaceRoom::sendSnapshots() {
+    std::uint32_t sequence = snapshotSequence++;
+    history.store(sequence, states);
+
+    // What every client shares is written once: the roster when it changes,
+    // and the interest grid's chunks
+    if (rosterStates.empty() || !sameRoster(states, rosterStates)) {
+        rosterStates = states;
+        rosterSequence = sequence;
+        roster.clear();
+        writeRoster(roster, states);
+    }
+    interest.build(sequence, states);
+
+    static const RacerState none;
+    for (std::size_t id = 0; id < entrants.size(); ++id) {
+        Racer& racer = entrants[id];
+        if (!racer.remote || (racer.status == RacerStatus::Out && silent(racer))) {
+            continue;
+        }
+        // Delta against the newest snapshot the client has, or everything if it has none we still keep
+        const std::vector<RacerState>* baseline = history.find(racer.ackedSnapshot);
+        std::uint32_t baselineSequence = baseline ? racer.ackedSnapshot : noBaseline;
+        std::uint32_t movesApplied = racer.movesReceived - static_cast<std::uint32_t>(racer.pendingMoves.size());
+        const RacerState* baselineOwn = baseline && id < baseline->size() ? &(*baseline)[id] : nullptr;
+        bool rosterChanged = !baseline || baselineSequence < rosterSequence;
+
+        outgoing.clear();
+        outgoing.putUint8(static_cast<std::uint8_t>(RaceMessage::Snapshot));
+        SnapshotHeader* header = outgoing.emplace<SnapshotHeader>();
+        header->sequence = sequence;
+        header->baseline = baselineSequence;
+        header->hostTick = roomTick;
+        header->startTick = everyoneJoined ? startTick : raceNotScheduled;
+        header->movesApplied = movesApplied;
+        writeRacerFields(outgoing, baselineOwn ? *baselineOwn : none, states[id]);
+        outgoing.putUint8(rosterChanged ? 1 : 0);
+        if (rosterChanged) {
+            outgoing.append(roster.data(), roster.size());
+        }
+        interest.writeAround(outgoing, states[id], baselineSequence, baselineOwn);
+        send(racer, outgoing);
+    }
+}
+
+void RaceRoom::send(Racer& racer, const WireBuffer& buffer) {
+    if (sendDatagram(socket, buffer, racer.address, racer.port) != sf::Socket::Done) {
+        return;
+    }
+    racer.traffic.bytesSent += buffer.size();
+    ++racer.traffic.packetsSent;
+    total.bytesSent += buffer.size();
+    ++total.packetsSent;
+}
+
+void RaceRoom::printTraffic(std::ostream& out) const {
+    out << "Racer  Address                Down B/s   Up B/s   Packets down/up" << std::endl;
+    for (std::size_t id = 0; id < entrants.size(); ++id) {
+        const Racer& racer = entrants[id];
+        if (!racer.remote) {
+            continue;
+        }
+        double seconds = std::max(1u, roomTick - racer.joinTick) * static_cast<double>(tickSeconds);
+        char line[128];
+        std::snprintf(line, sizeof(line), "%-6u %-21s %9.0f %8.0f   %llu/%llu", static_cast<unsigned>(id),
+            (racer.address.toString() + ":" + std::to_string(racer.port)).c_str(), racer.traffic.bytesSent / seconds,
+            racer.traffic.bytesReceived / seconds, static_cast<unsigned long long>(racer.traffic.packetsSent),
+            static_cast<unsigned long long>(racer.traffic.packetsReceived));
+        out << line << std::endl;
+    }
+}
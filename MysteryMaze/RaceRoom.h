@@ -0,0 +1,106 @@
+#pragma once
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "InterestGrid.h"
+#include "RaceProtocol.h"
+#include "WireBuffer.h"
+#include "World.h"
+
+// One race, simulated authoritatively: a world per racer on the same seed,
+// stepped on the fixed tick, with snapshots sent out on schedule. Each
+// client hears about the other racers only through the interest grid. The
+// room never reads a socket itself; whoever owns the socket hands it the
+// datagrams from its racers, so one socket can serve many rooms. The race
+// starts a short countdown after the last expected racer joins.
+class RaceRoom {
+public:
+    explicit RaceRoom(sf::UdpSocket& socket);
+
+    RaceRoom(const RaceRoom&) = delete;
+    RaceRoom& operator=(const RaceRoom&) = delete;
+
+    // Start over with a new race on a freshly generated level. A local world
+    // becomes racer 0, played on this machine; it must already hold the
+    // level, and its answerPuzzle is left to the caller.
+    void open(std::uint32_t seed, int width, int height, int expectedRacers, World* localWorld = nullptr);
+
+    // A datagram of size bytes from a peer, read up to just after the message
+    // type. Joins are only taken while accepting(); everything else only from
+    // racers in the room.
+    void receive(RaceMessage type, const sf::IpAddress& address, unsigned short port, std::size_t size, WireReader& reader);
+
+    // One fixed tick: step the racers once the race is on, and send
+    // snapshots when one is due. Safe to run alongside other rooms' ticks.
+    void tick(const char* localMoves = nullptr, std::size_t count = 0);
+
+    bool accepting() const { return !everyoneJoined && joined() < expected; }
+    bool hasRacer(const sf::IpAddress& address, unsigned short port) const;
+    int joined() const { return static_cast<int>(entrants.size()); }
+    int expectedRacers() const { return expected; }
+    bool started() const { return everyoneJoined && roomTick >= startTick; }
+    bool over() const;
+    bool idle() const; // The race ended a while ago, or every remote racer has gone quiet
+    int countdownSeconds() const; // Until the start, rounded up; 0 once it has begun or while racers are joining
+    std::uint32_t seed() const { return levelSeed; }
+
+    const std::vector<RacerState>& racers() const { return states; }
+    const TrafficStats& traffic() const { return total; }
+
+    // Per client traffic, bytes a second over the time it has been connected
+    void printTraffic(std::ostream& out) const;
+
+private:
+    struct Racer {
+        World* world = nullptr;
+        std::unique_ptr<World> ownWorld; // Remote racers only
+        std::string pendingMoves;        // Applied one a tick, like held keys repeating
+        RacerStatus status = RacerStatus::Racing;
+        std::uint32_t finishTicks = 0;
+
+        // Remote racers only
+        bool remote = false;
+        sf::IpAddress address;
+        unsigned short port = 0;
+        std::uint32_t movesReceived = 0; // Sequence of the next move expected
+        std::uint32_t ackedSnapshot = noBaseline;
+        std::uint32_t lastHeard = 0;     // Room tick
+        std::uint32_t joinTick = 0;
+        TrafficStats traffic;
+    };
+
+    bool silent(const Racer& racer) const; // Nothing heard for raceTimeoutTicks
+    Racer* findRacer(const sf::IpAddress& address, unsigned short port);
+    void handleJoin(const sf::IpAddress& address, unsigned short port, WireReader& reader);
+    void handleInput(Racer& racer, WireReader& reader);
+    void stepRacer(Racer& racer);
+    void sendSnapshots();
+    void sendWelcome(Racer& racer, std::size_t id);
+    void send(Racer& racer, const WireBuffer& buffer);
+
+    sf::UdpSocket& socket;
+    std::uint32_t levelSeed = 0;
+    int levelWidth = firstLevelSize;
+    int levelHeight = firstLevelSize;
+    int expected = 1;
+    std::vector<Racer> entrants;
+    std::vector<RacerState> states;
+    BlockList levelBlocks;
+    SnapshotHistory history;
+    std::uint32_t snapshotSequence = 0;
+    InterestGrid interest;
+    std::vector<RacerState> rosterStates; // As of the last roster change
+    std::uint32_t rosterSequence = 0;     // Snapshot the roster last changed in
+    WireBuffer roster;
+    std::uint32_t roomTick = 0;
+    std::uint32_t startTick = 0;
+    std::uint32_t overTick = 0;
+    bool everyoneJoined = false; // The countdown is running or the race has started
+    WireBuffer outgoing;                 // Every datagram is built here and sent before the next
+    TrafficStats total;
+};
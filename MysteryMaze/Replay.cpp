@@ -0,0 +1,413 @@
+#include "Replay.h"
+#include "SaveGame.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <cstring>
+
+static const std::size_t replayFlushSize = 64 * 1024;
+
+static void appendVarint(std::vector<char>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static void appendBytes(std::vector<char>& out, const void* data, std::size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+ReplayRecorder::~ReplayRecorder() {
+    if (isOpen()) {
+        flush();
+    }
+}
+
+bool ReplayRecorder::open(const std::string& filename) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    file.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    ReplayHeader header = { replayMagic, replayFormatVersion, sizeof(ReplayHeader), ticksPerSecond };
+    pending.clear();
+    appendBytes(pending, &header, sizeof(header));
+    lastTick = 0;
+    return true;
+}
+
+void ReplayRecorder::beginEvent(std::uint32_t tick, ReplayEvent type) {
+    appendVarint(pending, tick >= lastTick ? tick - lastTick : 0);
+    pending.push_back(static_cast<char>(type));
+    lastTick = tick;
+}
+
+void ReplayRecorder::recordSnapshot(const World& world) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (!isOpen()) {
+        return;
+    }
+    serializeWorld(world, scratch, SaveMode::FullGrid);
+    ReplaySnapshotExtras extras = {};
+    extras.gameRngState = world.gameRng.getState();
+    extras.tick = world.tick;
+    extras.levelTicks = world.levelTicks;
+    extras.timeLimit = world.timeLimit;
+    extras.enemyMoveTicks = world.enemy.moveTicks;
+
+    beginEvent(world.tick, ReplayEvent::Snapshot);
+    appendVarint(pending, scratch.size());
+    appendBytes(pending, scratch.data(), scratch.size());
+    appendBytes(pending, &extras, sizeof(extras));
+    flush();
+}
+
+void ReplayRecorder::recordMoves(std::uint32_t tick, const char* moves, std::size_t count) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (!isOpen()) {
+        return;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        beginEvent(tick, ReplayEvent::Move);
+        pending.push_back(moves[i]);
+    }
+    if (pending.size() >= replayFlushSize) {
+        flush();
+    }
+}
+
+void ReplayRecorder::recordAnswer(std::uint32_t tick, int answer) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (!isOpen()) {
+        return;
+    }
+    beginEvent(tick, ReplayEvent::Answer);
+    std::int64_t value = answer;
+    appendVarint(pending, (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+void ReplayRecorder::recordLevelAdvance(std::uint32_t tick) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (isOpen()) {
+        beginEvent(tick, ReplayEvent::LevelAdvance);
+    }
+}
+
+void ReplayRecorder::finish(const World& world) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (!isOpen()) {
+        return;
+    }
+    std::uint64_t hash = hashWorld(world);
+    beginEvent(world.tick, ReplayEvent::End);
+    appendBytes(pending, &hash, sizeof(hash));
+    flush();
+    file.close();
+}
+
+void ReplayRecorder::flush() {
+    file.write(pending.data(), static_cast<std::streamsize>(pending.size()));
+    file.flush();
+    pending.clear();
+}
+
+static bool validHeader(const ReplayHeader& header) {
+    return header.magic == replayMagic && header.version == replayFormatVersion && header.headerSize == sizeof(ReplayHeader)
+        && header.ticksPerSecond == static_cast<std::uint32_t>(ticksPerSecond);
+}
+
+bool ReplayReader::openBuffer(const char* buffer, std::size_t bufferSize) {
+    streaming = false;
+    data = buffer;
+    size = bufferSize;
+    pos = 0;
+    tick = 0;
+    fileLeft = 0;
+    good = true;
+    ReplayHeader header;
+    return read(&header, sizeof(header)) && validHeader(header);
+}
+
+bool ReplayReader::openFile(const std::string& filename, std::size_t chunkSize) {
+    file.open(filename, std::ios::binary | std::ios::ate);
+    streaming = true;
+    chunk.resize(std::max(chunkSize, sizeof(ReplayHeader)));
+    data = chunk.data();
+    size = 0;
+    pos = 0;
+    tick = 0;
+    std::streamoff length = file ? static_cast<std::streamoff>(file.tellg()) : 0;
+    fileLeft = length > 0 ? static_cast<std::uint64_t>(length) : 0;
+    file.seekg(0);
+    good = static_cast<bool>(file);
+    ReplayHeader header;
+    return read(&header, sizeof(header)) && validHeader(header);
+}
+
+// Make count bytes available from pos, refilling the chunk from the file if needed
+bool ReplayReader::fill(std::size_t count) {
+    if (size - pos >= count) {
+        return true;
+    }
+    if (!streaming) {
+        return false;
+    }
+    std::memmove(chunk.data(), chunk.data() + pos, size - pos);
+    size -= pos;
+    pos = 0;
+    file.read(chunk.data() + size, static_cast<std::streamsize>(chunk.size() - size));
+    std::size_t got = static_cast<std::size_t>(file.gcount());
+    size += got;
+    fileLeft -= std::min<std::uint64_t>(fileLeft, got);
+    return size - pos >= count;
+}
+
+std::uint64_t ReplayReader::varint() {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64 && fill(1); shift += 7) {
+        std::uint8_t byte = static_cast<std::uint8_t>(data[pos++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    good = false;
+    return 0;
+}
+
+// Copies through the chunk a piece at a time, so a large snapshot never grows it
+bool ReplayReader::read(void* out, std::size_t count) {
+    char* dest = static_cast<char*>(out);
+    while (good && count > 0) {
+        if (!fill(1)) {
+            good = false;
+            break;
+        }
+        std::size_t piece = std::min(count, size - pos);
+        std::memcpy(dest, data + pos, piece);
+        dest += piece;
+        pos += piece;
+        count -= piece;
+    }
+    return good;
+}
+
+bool ReplayReader::skip(std::size_t count) {
+    while (good && count > 0) {
+        if (!fill(1)) {
+            good = false;
+            break;
+        }
+        std::size_t piece = std::min(count, size - pos);
+        pos += piece;
+        count -= piece;
+    }
+    return good;
+}
+
+bool ReplayReader::next(ReplayEvent& type, std::uint32_t& eventTick) {
+    eventTick = tick + static_cast<std::uint32_t>(varint());
+    std::uint8_t typeByte;
+    if (!read(&typeByte, 1)) {
+        return false;
+    }
+    type = static_cast<ReplayEvent>(typeByte);
+    tick = eventTick;
+    return true;
+}
+
+ReplayPlayer::ReplayPlayer(World& world, ReplayReader& reader) : world(world), reader(reader) {
+    moves.reserve(16);
+    previousAnswerer = world.answerPuzzle;
+    world.answerPuzzle = [this](const AdditionQuestion&) {
+        if (!haveEvent && !this->reader.next(eventType, eventTick)) {
+            desynced = true;
+            return 0;
+        }
+        haveEvent = false;
+        if (eventType != ReplayEvent::Answer || eventTick != this->world.tick) {
+            desynced = true;
+            return 0;
+        }
+        std::uint64_t zigzag = this->reader.varint();
+        return static_cast<int>(static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1));
+    };
+}
+
+ReplayPlayer::~ReplayPlayer() {
+    world.answerPuzzle = previousAnswerer;
+}
+
+bool ReplayPlayer::applySnapshot() {
+    // Checked before sizing anything by it, so a corrupt length fails the replay instead of the allocation
+    std::uint64_t snapshotSize = reader.varint();
+    if (!reader.ok() || snapshotSize > reader.remaining() || snapshotSize > maxFullGridSaveSize()) {
+        return false;
+    }
+    snapshot.resize(static_cast<std::size_t>(snapshotSize));
+    ReplaySnapshotExtras extras;
+    if (!reader.read(snapshot.data(), snapshot.size()) || !reader.read(&extras, sizeof(extras))
+        || !deserializeWorld(world, snapshot.data(), snapshot.size())) {
+        return false;
+    }
+    world.gameRng.setState(extras.gameRngState);
+    world.tick = extras.tick;
+    world.levelTicks = extras.levelTicks;
+    world.timeLimit = extras.timeLimit;
+    world.enemy.moveTicks = extras.enemyMoveTicks;
+    world.puzzleFailed = false;
+    started = true;
+    return true;
+}
+
+// Handles every event stamped with the world's current tick; moves are
+// collected for the step that follows
+bool ReplayPlayer::applyEventsDue() {
+    moves.clear();
+    while (true) {
+        if (!haveEvent) {
+            if (!reader.next(eventType, eventTick)) {
+                return false;
+            }
+            haveEvent = true;
+        }
+        if (!started && eventType != ReplayEvent::Snapshot) {
+            return false;
+        }
+        if (started && eventTick > world.tick) {
+            return true; // Due on a later tick
+        }
+        if (started && eventTick < world.tick) {
+            return false;
+        }
+        if (eventType == ReplayEvent::Answer) {
+            return true; // Consumed by the puzzle during the step
+        }
+        haveEvent = false;
+
+        switch (eventType) {
+        case ReplayEvent::Snapshot:
+            if (!applySnapshot()) {
+                return false;
+            }
+            break;
+        case ReplayEvent::Move: {
+            char move;
+            if (!reader.read(&move, 1)) {
+                return false;
+            }
+            moves.push_back(move);
+            break;
+        }
+        case ReplayEvent::LevelAdvance:
+            advanceLevel(world);
+            break;
+        case ReplayEvent::End: {
+            std::uint64_t recordedHash;
+            if (!reader.read(&recordedHash, sizeof(recordedHash))) {
+                return false;
+            }
+            matched = hashWorld(world) == recordedHash;
+            reachedEnd = true;
+            return true;
+        }
+        default:
+            return false; // An answer nobody asked for, or an unknown event
+        }
+    }
+}
+
+bool ReplayPlayer::advance() {
+    if (reachedEnd || desynced) {
+        return false;
+    }
+    if (!applyEventsDue()) {
+        desynced = true;
+        return false;
+    }
+    if (reachedEnd) {
+        return false;
+    }
+    result = stepWorld(world, moves.data(), moves.size());
+    return !desynced;
+}
+
+bool runReplay(World& world, const char* data, std::size_t size, ReplayStats& stats) {
+    stats = ReplayStats();
+    ReplayReader reader;
+    if (!reader.openBuffer(data, size)) {
+        return false;
+    }
+
+    ReplayPlayer player(world, reader);
+    bool gameOver = false;
+    while (player.advance()) {
+        if (gameOver) {
+            return false; // The recording kept going after the game ended
+        }
+        ++stats.ticks;
+        if (player.lastResult() == TickResult::ExitReached) {
+            ++stats.levelsCompleted;
+        }
+        else if (player.lastResult() != TickResult::Playing) {
+            gameOver = true;
+        }
+    }
+
+    stats.finished = player.ended() && !player.failed();
+    stats.hashMatched = player.hashMatched();
+    stats.finalHash = hashWorld(world);
+    return stats.finished;
+}
+
+bool readReplayFile(const std::string& filename, std::vector<char>& data) {
+    std::ifstream infile(filename, std::ios::binary | std::ios::ate);
+    if (!infile) {
+        return false;
+    }
+    std::streamsize size = infile.tellg();
+    if (size <= 0) {
+        return false;
+    }
+    data.resize(static_cast<std::size_t>(size));
+    infile.seekg(0);
+    return static_cast<bool>(infile.read(data.data(), size));
+}
+
+bool replayDuration(const std::string& filename, std::uint32_t& ticks) {
+    ReplayReader reader;
+    if (!reader.openFile(filename)) {
+        return false;
+    }
+    bool started = false;
+    std::uint32_t startTick = 0;
+    ReplayEvent type;
+    std::uint32_t eventTick;
+    while (reader.next(type, eventTick)) {
+        if (!started) {
+            started = true;
+            startTick = eventTick;
+        }
+        switch (type) {
+        case ReplayEvent::Snapshot:
+            reader.skip(static_cast<std::size_t>(reader.varint()) + sizeof(ReplaySnapshotExtras));
+            break;
+        case ReplayEvent::Move:
+            reader.skip(1);
+            break;
+        case ReplayEvent::Answer:
+            reader.varint();
+            break;
+        case ReplayEvent::LevelAdvance:
+            break;
+        case ReplayEvent::End:
+            ticks = eventTick - startTick;
+            return true;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "World.h"
+
+// A replay is everything needed to run a game again tick for tick: a
+// snapshot of the starting world followed by the inputs, each stamped with
+// the simulation tick it was applied on.
+//
+//   ReplayHeader
+//   events, each:  varint tick delta since the previous event, uint8 type, payload
+//     Snapshot      varint size, full-grid save, ReplaySnapshotExtras
+//     Move          uint8 'W' / 'A' / 'S' / 'D'
+//     Answer        zigzag varint puzzle answer
+//     LevelAdvance  (none) the game moved on to the next level
+//     End           uint64 hashWorld of the final state
+//
+// A snapshot starts the recording and follows every load, so loading a
+// save mid-game replays correctly too.
+const std::uint32_t replayMagic = 0x50525a4d; // "MZRP"
+const std::uint16_t replayFormatVersion = 2;
+
+enum class ReplayEvent : std::uint8_t {
+    Snapshot = 1,
+    Move = 2,
+    Answer = 3,
+    End = 4,
+    LevelAdvance = 5,
+};
+
+#pragma pack(push, 1)
+struct ReplayHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t headerSize;
+    std::uint32_t ticksPerSecond;
+};
+
+// Simulation state a save file does not carry
+struct ReplaySnapshotExtras {
+    std::uint64_t gameRngState;
+    std::uint32_t tick;
+    std::uint32_t levelTicks;
+    float timeLimit;
+    std::int32_t enemyMoveTicks;
+};
+#pragma pack(pop)
+
+class ReplayRecorder {
+public:
+    ReplayRecorder() = default;
+    ~ReplayRecorder(); // Writes out whatever is buffered, without an End event
+
+    ReplayRecorder(const ReplayRecorder&) = delete;
+    ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+
+    bool open(const std::string& filename);
+    bool isOpen() const { return file.is_open(); }
+
+    void recordSnapshot(const World& world);
+    void recordMoves(std::uint32_t tick, const char* moves, std::size_t count);
+    void recordAnswer(std::uint32_t tick, int answer);
+    void recordLevelAdvance(std::uint32_t tick);
+
+    // Append the End event with the final state hash and close the file
+    void finish(const World& world);
+
+private:
+    void beginEvent(std::uint32_t tick, ReplayEvent type);
+    void flush();
+
+    std::ofstream file;
+    std::vector<char> pending; // Written out in large chunks
+    std::vector<char> scratch;
+    std::uint32_t lastTick = 0;
+};
+
+// Reads replay events either from memory or streamed from disk through a
+// small fixed-size chunk, so a file of any length costs the same memory.
+class ReplayReader {
+public:
+    ReplayReader() = default;
+    ReplayReader(const ReplayReader&) = delete;
+    ReplayReader& operator=(const ReplayReader&) = delete;
+
+    // Both check the header before anything else is read
+    bool openBuffer(const char* data, std::size_t size);
+    bool openFile(const std::string& filename, std::size_t chunkSize = 4096);
+
+    // Reads the tick and type of the next event; the payload is left to the caller
+    bool next(ReplayEvent& type, std::uint32_t& eventTick);
+
+    std::uint64_t varint();
+    bool read(void* out, std::size_t count);
+    bool skip(std::size_t count);
+    bool ok() const { return good; }
+
+    // Bytes left to read, in the buffer or the rest of the file
+    std::uint64_t remaining() const { return (size - pos) + fileLeft; }
+
+private:
+    bool fill(std::size_t count);
+
+    std::ifstream file;
+    std::vector<char> chunk;
+    const char* data = nullptr;
+    std::size_t size = 0;
+    std::size_t pos = 0;
+    std::uint32_t tick = 0; // Tick of the last event read
+    std::uint64_t fileLeft = 0; // Bytes of the file not yet read into the chunk
+    bool streaming = false;
+    bool good = false;
+};
+
+// Drives a world from a replay one tick at a time, e.g. for a ghost that
+// runs alongside the live game. Puzzle answers are pulled from the stream.
+class ReplayPlayer {
+public:
+    ReplayPlayer(World& world, ReplayReader& reader);
+    ~ReplayPlayer();
+
+    ReplayPlayer(const ReplayPlayer&) = delete;
+    ReplayPlayer& operator=(const ReplayPlayer&) = delete;
+
+    // Apply the events due on the world's current tick and step it once.
+    // Returns false once the End event is reached or the replay desyncs.
+    bool advance();
+
+    TickResult lastResult() const { return result; }
+    bool ended() const { return reachedEnd; }
+    bool failed() const { return desynced; }
+    bool hashMatched() const { return matched; }
+
+private:
+    bool applyEventsDue();
+    bool applySnapshot();
+
+    World& world;
+    ReplayReader& reader;
+    PuzzleAnswerer previousAnswerer;
+
+    bool haveEvent = false; // Read ahead: due on a later tick, or an answer for the step
+    ReplayEvent eventType = ReplayEvent::End;
+    std::uint32_t eventTick = 0;
+
+    std::vector<char> moves;
+    std::vector<char> snapshot;
+    TickResult result = TickResult::Playing;
+    bool started = false;
+    bool reachedEnd = false;
+    bool desynced = false;
+    bool matched = false;
+};
+
+struct ReplayStats {
+    std::uint32_t ticks = 0;  // Ticks simulated
+    int levelsCompleted = 0;
+    bool finished = false;    // Reached the End event without desyncing
+    bool hashMatched = false; // Final state matches the recording
+    std::uint64_t finalHash = 0;
+};
+
+// Run a recording through the simulation as fast as it will go, with no
+// window or sleeping. Returns false if the data is malformed or desyncs.
+bool runReplay(World& world, const char* data, std::size_t size, ReplayStats& stats);
+bool readReplayFile(const std::string& filename, std::vector<char>& data);
+
+// Ticks from the first snapshot to the End event, found by streaming through the file
+bool replayDuration(const std::string& filename, std::uint32_t& ticks);
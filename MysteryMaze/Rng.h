@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+// Small deterministic random number generator (PCG32). Unlike rand() and
+// std::random_shuffle its sequence is the same on every compiler and
+// platform, so a maze can be rebuilt exactly from its seed.
+class Rng {
+public:
+    explicit Rng(std::uint64_t seed = 0) { reseed(seed); }
+
+    void reseed(std::uint64_t seed) {
+        state = 0;
+        next();
+        state += seed;
+        next();
+    }
+
+    std::uint32_t next() {
+        std::uint64_t old = state;
+        state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+        std::uint32_t xorshifted = static_cast<std::uint32_t>(((old >> 18u) ^ old) >> 27u);
+        std::uint32_t rot = static_cast<std::uint32_t>(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // Uniform-enough integer in [0, bound)
+    int below(int bound) {
+        return static_cast<int>((static_cast<std::uint64_t>(next()) * static_cast<std::uint32_t>(bound)) >> 32);
+    }
+
+    std::uint64_t getState() const { return state; }
+    void setState(std::uint64_t newState) { state = newState; }
+
+private:
+    std::uint64_t state;
+};
@@ -0,0 +1,100 @@
+#include "Rollback.h"
+
+RollbackBuffer::RollbackBuffer(std::size_t capacityTicks) : entries(capacityTicks > 0 ? capacityTicks : 1) {}
+
+void RollbackBuffer::capture(const World& world) {
+    // Undoing only works back through an unbroken run of single steps on the same grids
+    if (world.arenaEpoch != epoch || (count > 0 && world.tick != at(0).tick + 1)) {
+        count = 0;
+        epoch = world.arenaEpoch;
+    }
+
+    Entry& entry = entries[head];
+    entry.tick = world.tick;
+    entry.levelTicks = world.levelTicks;
+    entry.timeLimit = world.timeLimit;
+    entry.gameRngState = world.gameRng.getState();
+    entry.playerX = world.playerX;
+    entry.playerY = world.playerY;
+    entry.powerUpX = world.powerUpX;
+    entry.powerUpY = world.powerUpY;
+    entry.powerUpActive = world.powerUpActive;
+    entry.puzzleFailed = world.puzzleFailed;
+    entry.enemyX = world.enemy.x;
+    entry.enemyY = world.enemy.y;
+    entry.enemyMoveTicks = world.enemy.moveTicks;
+
+    const auto& stack = world.enemy.backtrackStack;
+    entry.stackSize = stack.size();
+    entry.aboveTop = stack.size() < stack.capacity() ? stack.begin()[stack.size()] : std::make_pair(0, 0);
+    entry.blockCount = world.purpleBlocks.size();
+    for (std::size_t i = 0; i < entry.blockCount; ++i) {
+        entry.blocks[i] = world.purpleBlocks[i];
+    }
+
+    head = (head + 1) % entries.size();
+    count = count < entries.size() ? count + 1 : count;
+}
+
+bool RollbackBuffer::rewind(World& world, std::uint32_t tick) {
+    if (!contains(tick) || world.arenaEpoch != epoch) {
+        return false;
+    }
+
+    // Undo the enemy's search newest tick first: a tick that grew the stack
+    // marked the cell it pushed and overwrote the slot above the old top
+    auto& stack = world.enemy.backtrackStack;
+    std::size_t sizeAfter = stack.size();
+    std::size_t age = 0;
+    for (;; ++age) {
+        const Entry& entry = at(age);
+        if (sizeAfter > entry.stackSize) {
+            std::pair<int, int> pushed = stack.begin()[entry.stackSize];
+            world.enemy.visited[pushed.second][pushed.first] = false;
+            stack.begin()[entry.stackSize] = entry.aboveTop;
+        }
+        sizeAfter = entry.stackSize;
+        if (entry.tick == tick) {
+            break;
+        }
+    }
+
+    const Entry& entry = at(age);
+    world.tick = entry.tick;
+    world.levelTicks = entry.levelTicks;
+    world.timeLimit = entry.timeLimit;
+    world.gameRng.setState(entry.gameRngState);
+    world.playerX = entry.playerX;
+    world.playerY = entry.playerY;
+    world.powerUpX = entry.powerUpX;
+    world.powerUpY = entry.powerUpY;
+    world.powerUpActive = entry.powerUpActive;
+    world.puzzleFailed = entry.puzzleFailed;
+    world.enemy.x = entry.enemyX;
+    world.enemy.y = entry.enemyY;
+    world.enemy.moveTicks = entry.enemyMoveTicks;
+    stack.resize(entry.stackSize);
+
+    // Solved blocks come back
+    world.purpleBlocks.clear();
+    for (std::size_t i = 0; i < entry.blockCount; ++i) {
+        world.purpleBlocks.push_back(entry.blocks[i]);
+        world.maze[entry.blocks[i].second][entry.blocks[i].first] = 'P';
+    }
+
+    head = (head + entries.size() - (age + 1)) % entries.size();
+    count -= age + 1;
+    return true;
+}
+
+bool RollbackBuffer::contains(std::uint32_t tick) const {
+    return count > 0 && tick >= oldestTick() && tick <= newestTick();
+}
+
+std::uint32_t RollbackBuffer::oldestTick() const {
+    return at(count - 1).tick;
+}
+
+std::uint32_t RollbackBuffer::newestTick() const {
+    return at(0).tick;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "World.h"
+
+// The last few seconds of world state, one entry per tick, for rewinding
+// (replay scrubbing, netcode rollback).
+//
+// Only the small dynamic state is copied each tick. The grids are never
+// copied: within a level the maze only changes where a purple block is
+// solved, and the enemy's search only ever marks one cell and pushes one
+// stack slot per tick, so each entry also keeps what that tick could
+// overwrite and a rewind undoes the ticks newest first. A level change or
+// load rebuilds the grids, so the window starts over when that happens.
+class RollbackBuffer {
+public:
+    explicit RollbackBuffer(std::size_t capacityTicks = 4 * ticksPerSecond);
+
+    // Call right before stepping the world; records its state at world.tick
+    void capture(const World& world);
+
+    // Put the world back to the state captured at tick. The world must not
+    // have changed since the last capture except by stepping it once.
+    // Entries from that tick on are dropped, so capture again before stepping.
+    bool rewind(World& world, std::uint32_t tick);
+
+    bool contains(std::uint32_t tick) const;
+    std::uint32_t oldestTick() const;
+    std::uint32_t newestTick() const;
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return entries.size(); }
+    void clear() { count = 0; }
+
+private:
+    struct Entry {
+        std::uint32_t tick;
+        std::uint32_t levelTicks;
+        float timeLimit;
+        std::uint64_t gameRngState;
+        int playerX, playerY;
+        int powerUpX, powerUpY;
+        bool powerUpActive;
+        bool puzzleFailed;
+        int enemyX, enemyY, enemyMoveTicks;
+        std::size_t stackSize;
+        std::pair<int, int> aboveTop; // Stack slot a push this tick would overwrite
+        std::size_t blockCount;
+        std::pair<int, int> blocks[purpleBlockCount];
+    };
+
+    // age 0 is the newest entry
+    Entry& at(std::size_t age) { return entries[(head + entries.size() - 1 - age) % entries.size()]; }
+    const Entry& at(std::size_t age) const { return entries[(head + entries.size() - 1 - age) % entries.size()]; }
+
+    std::vector<Entry> entries;
+    std::size_t head = 0; // Where the next capture goes
+    std::size_t count = 0;
+    std::uint32_t epoch = 0;
+};
@@ -0,0 +1,185 @@
+#include "RoomServer.h"
+#include "AllocationCounter.h"
+#include <SFML/System/Time.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+using Clock = std::chrono::steady_clock;
+
+RoomServer::RoomServer(int roomCount, int racersPerRoom, unsigned extraThreads, int mazeSize)
+    : pool(extraThreads), racersPerRoom(std::max(1, std::min(racersPerRoom, maxRacers))),
+      mazeSize(std::max(5, mazeSize)), seeds(static_cast<std::uint64_t>(std::time(nullptr))) {
+    for (int i = 0; i < std::max(1, roomCount); ++i) {
+        rooms.emplace_back(new RaceRoom(socket));
+        openRoom(rooms.size() - 1);
+    }
+    roomBusyUs.assign(rooms.size(), 0.0);
+
+    tickRoom = [this](std::size_t index) {
+        Clock::time_point start = Clock::now();
+        rooms[index]->tick();
+        roomBusyUs[index] += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    };
+}
+
+bool RoomServer::listen(unsigned short port) {
+    if (socket.bind(port) != sf::Socket::Done) {
+        return false;
+    }
+    socket.setBlocking(false);
+    selector.clear();
+    selector.add(socket);
+    return true;
+}
+
+void RoomServer::openRoom(std::size_t index) {
+    rooms[index]->open(seeds.next(), mazeSize, mazeSize, racersPerRoom);
+}
+
+void RoomServer::run(std::ostream& out, double seconds, double reportSeconds) {
+    const Clock::duration tickPeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tickSeconds));
+    const Clock::duration maxBehind = std::chrono::milliseconds(250);
+    Clock::time_point start = Clock::now();
+    Clock::time_point nextTick = start;
+    Clock::time_point lastReport = start;
+
+    while (!stopping && (seconds <= 0.0 || Clock::now() - start < std::chrono::duration<double>(seconds))) {
+        std::uint64_t allocationsBefore = allocationCount();
+
+        // Take datagrams as they arrive until the next tick is due
+        for (Clock::time_point now = Clock::now(); now < nextTick; now = Clock::now()) {
+            sf::Int64 waitUs = std::chrono::duration_cast<std::chrono::microseconds>(nextTick - now).count();
+            if (waitUs <= 0) {
+                break; // A zero timeout would wait forever
+            }
+            if (selector.wait(sf::microseconds(waitUs))) {
+                receive();
+            }
+        }
+        receive();
+
+        Clock::time_point tickStart = Clock::now();
+        tickRooms();
+        Clock::time_point tickEnd = Clock::now();
+        double tickUs = std::chrono::duration<double, std::micro>(tickEnd - tickStart).count();
+        windowTickUs += tickUs;
+        windowAllocations += allocationCount() - allocationsBefore;
+        ++windowTicks;
+
+        nextTick += tickPeriod;
+        std::uint32_t dropped = 0;
+        if (tickEnd - nextTick > maxBehind) {
+            // Too far behind to catch up; drop the missed ticks rather than run them back to back
+            dropped = static_cast<std::uint32_t>((tickEnd - nextTick) / tickPeriod);
+            lateTicks += dropped;
+            nextTick = tickEnd;
+        }
+        {
+            std::lock_guard<std::mutex> lock(loadMutex);
+            ++load.ticks;
+            load.lateTicks += dropped;
+            load.tickUs.record(static_cast<std::uint32_t>(tickUs));
+        }
+
+        double windowSeconds = std::chrono::duration<double>(tickEnd - lastReport).count();
+        if (reportSeconds > 0.0 && windowSeconds >= reportSeconds) {
+            report(out, std::chrono::duration<double>(tickEnd - start).count(), windowSeconds);
+            lastReport = tickEnd;
+        }
+    }
+}
+
+ServerLoad RoomServer::takeLoad() {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    ServerLoad taken = load;
+    load.ticks = 0;
+    load.lateTicks = 0;
+    load.tickUs.clear();
+    return taken;
+}
+
+void RoomServer::receive() {
+    sf::IpAddress address;
+    unsigned short port;
+    while (receiveDatagram(socket, incoming, address, port) == sf::Socket::Done) {
+        WireReader reader(incoming);
+        std::uint8_t typeByte = 0;
+        if (!reader.getUint8(typeByte)) {
+            continue;
+        }
+        RaceMessage type = static_cast<RaceMessage>(typeByte);
+        PeerKey key(address.toInteger(), port);
+        auto known = peerRooms.find(key);
+        if (known != peerRooms.end()) {
+            rooms[known->second]->receive(type, address, port, incoming.size(), reader);
+            continue;
+        }
+        if (type != RaceMessage::Join) {
+            continue;
+        }
+
+        // Someone new: fill the rooms in order, so racers are not spread thin
+        for (std::size_t index = 0; index < rooms.size(); ++index) {
+            if (rooms[index]->accepting()) {
+                rooms[index]->receive(type, address, port, incoming.size(), reader);
+                if (rooms[index]->hasRacer(address, port)) {
+                    peerRooms[key] = index;
+                }
+                break;
+            }
+        }
+    }
+}
+
+void RoomServer::tickRooms() {
+    MemoryTagScope memoryTag(MemoryTag::Network);
+    pool.forEach(rooms.size(), tickRoom);
+    reopenIdleRooms();
+}
+
+void RoomServer::reopenIdleRooms() {
+    for (std::size_t index = 0; index < rooms.size(); ++index) {
+        if (!rooms[index]->idle()) {
+            continue;
+        }
+        for (auto peer = peerRooms.begin(); peer != peerRooms.end();) {
+            peer = peer->second == index ? peerRooms.erase(peer) : std::next(peer);
+        }
+        openRoom(index);
+    }
+}
+
+void RoomServer::report(std::ostream& out, double elapsedSeconds, double windowSeconds) {
+    int racing = 0;
+    int filling = 0;
+    int racers = 0;
+    double maxRoomUs = 0.0;
+    double totalRoomUs = 0.0;
+    for (std::size_t index = 0; index < rooms.size(); ++index) {
+        const RaceRoom& room = *rooms[index];
+        racers += room.joined();
+        racing += room.started() && !room.over() ? 1 : 0;
+        filling += room.joined() > 0 && room.accepting() ? 1 : 0;
+        maxRoomUs = std::max(maxRoomUs, roomBusyUs[index]);
+        totalRoomUs += roomBusyUs[index];
+    }
+    double ticks = std::max(1u, windowTicks);
+
+    // Room times are per tick; busy is the share of the pool's threads spent ticking rooms.
+    // Allocations count everything from receiving to the end of the tick.
+    char line[288];
+    std::snprintf(line, sizeof(line),
+        "%7.0fs  rooms %zu (%d racing, %d filling)  racers %d  ticks/s %.1f  tick %.0f us  room avg %.2f us max %.2f us  busy %.1f%%  late %u  allocs/tick %.2f",
+        elapsedSeconds, rooms.size(), racing, filling, racers, windowTicks / windowSeconds, windowTickUs / ticks,
+        totalRoomUs / ticks / rooms.size(), maxRoomUs / ticks, 100.0 * totalRoomUs / (windowSeconds * 1e6 * threads()),
+        lateTicks, windowAllocations / ticks);
+    out << line << std::endl;
+
+    windowTicks = 0;
+    windowAllocations = 0;
+    lateTicks = 0;
+    windowTickUs = 0.0;
+    std::fill(roomBusyUs.begin(), roomBusyUs.end(), 0.0);
+}
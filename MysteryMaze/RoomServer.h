@@ -0,0 +1,88 @@
+#pragma once
+#include <SFML/Network/SocketSelector.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+#include "Histogram.h"
+#include "RaceRoom.h"
+#include "WireBuffer.h"
+#include "Rng.h"
+#include "WorkerPool.h"
+
+// A headless dedicated server running many races at once. Only Network and
+// System are needed, no window or graphics.
+//
+// All rooms share one UDP port. The main thread waits on the socket with a
+// SocketSelector between ticks and routes each datagram to its sender's
+// room; a Join from someone new goes to the first room still filling up.
+// On every tick the rooms are stepped in parallel on a WorkerPool, each
+// room touched by one thread only, and nothing is received while they run.
+// A room whose race has ended or whose racers have all gone quiet is opened
+// again on a fresh seed.
+// The server's ticks since it was last asked, for whoever is watching it
+// from another thread (a load test, say)
+struct ServerLoad {
+    std::uint32_t ticks = 0;
+    std::uint32_t lateTicks = 0;
+    Histogram tickUs; // Every room ticked, all together
+};
+
+class RoomServer {
+public:
+    RoomServer(int roomCount, int racersPerRoom, unsigned extraThreads, int mazeSize = firstLevelSize);
+
+    RoomServer(const RoomServer&) = delete;
+    RoomServer& operator=(const RoomServer&) = delete;
+
+    bool listen(unsigned short port);
+    unsigned short port() const { return socket.getLocalPort(); }
+    unsigned threads() const { return pool.threads(); }
+
+    // Serve on the fixed tick for seconds of wall time, or until stop() if 0,
+    // printing a load report every reportSeconds (never if 0)
+    void run(std::ostream& out, double seconds = 0.0, double reportSeconds = 5.0);
+
+    // Both safe to call while run() is going on another thread
+    void stop() { stopping = true; }
+    ServerLoad takeLoad(); // And start counting again
+
+private:
+    using PeerKey = std::pair<sf::Uint32, unsigned short>;
+
+    void receive();
+    void tickRooms();
+    void reopenIdleRooms();
+    void openRoom(std::size_t index);
+    void report(std::ostream& out, double elapsedSeconds, double windowSeconds);
+
+    sf::UdpSocket socket;
+    sf::SocketSelector selector;
+    WorkerPool pool;
+    std::function<void(std::size_t)> tickRoom;
+
+    std::vector<std::unique_ptr<RaceRoom>> rooms;
+    std::map<PeerKey, std::size_t> peerRooms; // Which room each client address and port is in
+    std::vector<double> roomBusyUs;           // Time spent ticking each room since the last report
+    int racersPerRoom;
+    int mazeSize;
+    Rng seeds;
+
+    // Load since the last report
+    std::uint32_t windowTicks = 0;
+    std::uint32_t lateTicks = 0; // Ticks dropped after falling too far behind
+    double windowTickUs = 0.0;   // Wall time of whole ticks, all rooms together
+    std::uint64_t windowAllocations = 0; // Heap allocations while receiving and ticking
+
+    std::atomic<bool> stopping{ false };
+    std::mutex loadMutex;
+    ServerLoad load;
+    WireBuffer incoming;
+};
@@ -0,0 +1,191 @@
+#include "SaveCatalog.h"
+#include "World.h"
+#include "AllocationCounter.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+
+static const std::size_t entriesOffset = sizeof(SaveIndexHeader);
+static const std::size_t thumbnailsOffset = entriesOffset + maxSaveSlots * sizeof(SaveSlotEntry);
+static const std::size_t indexFileSize = thumbnailsOffset + maxSaveSlots * thumbnailBytes;
+
+static bool validSlot(int slot) {
+    return slot >= 0 && slot < maxSaveSlots;
+}
+
+static std::vector<char> emptyIndex() {
+    std::vector<char> index(indexFileSize, 0);
+    SaveIndexHeader header = { saveIndexMagic, saveIndexVersion, sizeof(SaveIndexHeader), sizeof(SaveSlotEntry), 0, maxSaveSlots };
+    std::memcpy(index.data(), &header, sizeof(header));
+    return index;
+}
+
+void makeThumbnail(const World& world, unsigned char* thumbnail) {
+    std::memset(thumbnail, 0, thumbnailBytes);
+    for (int ty = 0; ty < thumbnailSize; ++ty) {
+        int y = ty * world.height / thumbnailSize;
+        for (int tx = 0; tx < thumbnailSize; ++tx) {
+            int x = tx * world.width / thumbnailSize;
+            if (world.maze[y][x] == '#') {
+                int bit = ty * thumbnailSize + tx;
+                thumbnail[bit / 8] |= static_cast<unsigned char>(1u << (bit % 8));
+            }
+        }
+    }
+}
+
+SaveSlotEntry makeSlotEntry(const World& world, SaveMode mode, std::size_t saveBytes) {
+    SaveSlotEntry entry = {};
+    entry.used = 1;
+    entry.mode = static_cast<std::uint8_t>(mode);
+    entry.level = world.level;
+    entry.timestamp = static_cast<std::int64_t>(std::time(nullptr));
+    entry.seed = world.seed;
+    entry.width = world.width;
+    entry.height = world.height;
+    entry.remainingTime = remainingTime(world);
+    entry.saveBytes = static_cast<std::uint32_t>(saveBytes);
+    return entry;
+}
+
+SaveCatalog::SaveCatalog(const std::string& indexFilename) : indexFilename(indexFilename) {}
+
+std::string SaveCatalog::slotFilename(int slot) {
+    if (slot == autosaveSlot) {
+        return "game_state.dat"; // Where the game has always saved
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "save_slot_%03d.dat", slot);
+    return name;
+}
+
+// Header and entry table in a single read; the thumbnails are left on disk
+bool SaveCatalog::readIndex(std::vector<char>& table) {
+    std::FILE* file = std::fopen(indexFilename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    table.resize(thumbnailsOffset);
+    bool ok = std::fread(table.data(), 1, table.size(), file) == table.size();
+    std::fclose(file);
+
+    SaveIndexHeader header;
+    std::memcpy(&header, table.data(), sizeof(header));
+    return ok && header.magic == saveIndexMagic && header.version == saveIndexVersion
+        && header.headerSize == sizeof(SaveIndexHeader) && header.entrySize == sizeof(SaveSlotEntry)
+        && header.slotCount == maxSaveSlots;
+}
+
+bool SaveCatalog::list(std::vector<SaveSlotEntry>& entries) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    std::vector<char> table;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!readIndex(table) && (!rebuildLocked() || !readIndex(table))) {
+            return false;
+        }
+    }
+    entries.resize(maxSaveSlots);
+    std::memcpy(static_cast<void*>(entries.data()), table.data() + entriesOffset, maxSaveSlots * sizeof(SaveSlotEntry));
+    return true;
+}
+
+bool SaveCatalog::readThumbnail(int slot, unsigned char* thumbnail) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (!validSlot(slot)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    std::FILE* file = std::fopen(indexFilename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fseek(file, static_cast<long>(thumbnailsOffset + slot * thumbnailBytes), SEEK_SET) == 0
+        && std::fread(thumbnail, 1, thumbnailBytes, file) == thumbnailBytes;
+    std::fclose(file);
+    return ok;
+}
+
+bool SaveCatalog::updateSlot(int slot, const SaveSlotEntry& entry, const unsigned char* thumbnail) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (!validSlot(slot)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Rebuilding keeps every other slot's entry, where an empty index would drop them
+    std::vector<char> table;
+    if (!readIndex(table) && !rebuildLocked()) {
+        return false;
+    }
+
+    SaveSlotEntry placed = entry;
+    placed.thumbnailOffset = static_cast<std::uint32_t>(thumbnailsOffset + slot * thumbnailBytes);
+
+    std::FILE* file = std::fopen(indexFilename.c_str(), "r+b");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fseek(file, static_cast<long>(entriesOffset + slot * sizeof(SaveSlotEntry)), SEEK_SET) == 0
+        && std::fwrite(&placed, sizeof(placed), 1, file) == 1
+        && std::fseek(file, static_cast<long>(placed.thumbnailOffset), SEEK_SET) == 0
+        && std::fwrite(thumbnail, 1, thumbnailBytes, file) == thumbnailBytes;
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool SaveCatalog::saveSlot(const World& world, int slot, SaveMode mode) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (!validSlot(slot)) {
+        return false;
+    }
+    std::vector<char> buffer;
+    serializeWorld(world, buffer, mode);
+    if (!writeFileAtomically(slotFilename(slot), buffer.data(), buffer.size())) {
+        return false;
+    }
+    unsigned char thumbnail[thumbnailBytes];
+    makeThumbnail(world, thumbnail);
+    return updateSlot(slot, makeSlotEntry(world, mode, buffer.size()), thumbnail);
+}
+
+bool SaveCatalog::loadSlot(World& world, int slot) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    return validSlot(slot) && loadWorld(world, slotFilename(slot));
+}
+
+bool SaveCatalog::rebuild() {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    std::lock_guard<std::mutex> lock(mutex);
+    return rebuildLocked();
+}
+
+bool SaveCatalog::rebuildLocked() {
+    std::vector<char> index = emptyIndex();
+
+    World scratch;
+    std::vector<char> buffer;
+    for (int slot = 0; slot < maxSaveSlots; ++slot) {
+        std::ifstream infile(slotFilename(slot), std::ios::binary | std::ios::ate);
+        std::streamsize size = infile ? static_cast<std::streamsize>(infile.tellg()) : 0;
+        if (size < static_cast<std::streamsize>(sizeof(SaveHeader))) {
+            continue;
+        }
+        buffer.resize(static_cast<std::size_t>(size));
+        infile.seekg(0);
+        if (!infile.read(buffer.data(), size) || !deserializeWorld(scratch, buffer.data(), buffer.size())) {
+            continue;
+        }
+
+        std::uint32_t magic;
+        std::memcpy(&magic, buffer.data(), sizeof(magic));
+        SaveSlotEntry entry = makeSlotEntry(scratch, magic == seedSaveMagic ? SaveMode::SeedDelta : SaveMode::FullGrid, buffer.size());
+        entry.timestamp = 0;
+        entry.thumbnailOffset = static_cast<std::uint32_t>(thumbnailsOffset + slot * thumbnailBytes);
+        std::memcpy(index.data() + entriesOffset + slot * sizeof(SaveSlotEntry), &entry, sizeof(entry));
+        makeThumbnail(scratch, reinterpret_cast<unsigned char*>(index.data() + entry.thumbnailOffset));
+    }
+
+    return writeFileAtomically(indexFilename, index.data(), index.size());
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "SaveGame.h"
+
+struct World;
+
+// Index of the save slots, so the load menu can list every save with one
+// small read instead of opening and parsing each save file.
+//
+//   SaveIndexHeader
+//   SaveSlotEntry[slotCount]            metadata per slot, indexed by slot number
+//   thumbnails[slotCount]               thumbnailBytes each, at entry.thumbnailOffset
+//
+// Entries and thumbnails have fixed positions, so writing a save rewrites
+// only its own entry in place. Slot 0 is the autosave and keeps the old
+// single save file name.
+const std::uint32_t saveIndexMagic = 0x49535a4d; // "MZSI"
+const std::uint16_t saveIndexVersion = 1;
+const int maxSaveSlots = 512;
+const int autosaveSlot = 0;
+const int thumbnailSize = 32; // Cells per side, one bit per cell (set for a wall)
+const std::size_t thumbnailBytes = thumbnailSize * thumbnailSize / 8;
+
+#pragma pack(push, 1)
+struct SaveIndexHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t headerSize;
+    std::uint16_t entrySize;
+    std::uint16_t reserved;
+    std::uint32_t slotCount;
+};
+
+struct SaveSlotEntry {
+    std::uint8_t used;
+    std::uint8_t mode; // SaveMode the slot file was written in
+    std::uint8_t reserved[2];
+    std::int32_t level;
+    std::int64_t timestamp; // Seconds since the epoch, 0 if unknown
+    std::uint32_t seed;
+    std::int32_t width, height;
+    float remainingTime;
+    std::uint32_t saveBytes;
+    std::uint32_t thumbnailOffset;
+};
+#pragma pack(pop)
+
+// Downsample the maze to a thumbnailSize x thumbnailSize bitmap
+void makeThumbnail(const World& world, unsigned char* thumbnail);
+SaveSlotEntry makeSlotEntry(const World& world, SaveMode mode, std::size_t saveBytes);
+
+class SaveCatalog {
+public:
+    explicit SaveCatalog(const std::string& indexFilename = "save_slots.idx");
+
+    static std::string slotFilename(int slot);
+
+    // Every slot's entry (unused ones have used == 0), read in one go.
+    // A missing or damaged index is rebuilt from the slot files first.
+    bool list(std::vector<SaveSlotEntry>& entries);
+    bool readThumbnail(int slot, unsigned char* thumbnail);
+
+    // Rewrite one slot's entry and thumbnail in place. Safe to call from the autosave thread.
+    // A missing or damaged index is rebuilt from the slot files first.
+    bool updateSlot(int slot, const SaveSlotEntry& entry, const unsigned char* thumbnail);
+
+    // Write the slot file and its index entry
+    bool saveSlot(const World& world, int slot, SaveMode mode);
+    bool loadSlot(World& world, int slot);
+
+    // Recreate the index by opening every slot file; only needed when the index is lost
+    bool rebuild();
+
+private:
+    // Both with mutex held, so no updateSlot can land between reading the
+    // slot files and writing the index
+    bool readIndex(std::vector<char>& table);
+    bool rebuildLocked();
+
+    std::string indexFilename;
+    std::mutex mutex;
+};
@@ -0,0 +1,372 @@
+#include "SaveGame.h"
+#include "World.h"
+#include "GridCodec.h"
+#include "Profiler.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Pairs and bools are copied straight between the arena and the file
+static_assert(sizeof(std::pair<int, int>) == 2 * sizeof(std::int32_t), "purple blocks and backtrack stack are saved as raw int32 pairs");
+static_assert(sizeof(bool) == 1, "the enemy visited grid is saved as raw bytes");
+static_assert(sizeof(SaveHeader) == 16 && sizeof(SaveWorldRecord) == 72 && sizeof(SeedSaveRecord) == 56, "save records must not change size silently");
+static_assert(purpleBlockCount <= 2, "SeedSaveRecord has room for two purple blocks");
+
+namespace {
+    struct Crc32Table {
+        std::uint32_t entries[256];
+
+        Crc32Table() {
+            for (std::uint32_t i = 0; i < 256; ++i) {
+                std::uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+        }
+    };
+}
+
+std::uint32_t crc32(const void* data, std::size_t size) {
+    // Built once, safely, whichever thread saves first
+    static const Crc32Table table;
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Fill in the header at the front of buffer from the payload behind it
+static void writeHeader(std::vector<char>& buffer, std::uint32_t magic, std::uint16_t version) {
+    SaveHeader header;
+    header.magic = magic;
+    header.version = version;
+    header.headerSize = sizeof(SaveHeader);
+    header.payloadSize = static_cast<std::uint32_t>(buffer.size() - sizeof(SaveHeader));
+    header.checksum = crc32(buffer.data() + sizeof(SaveHeader), header.payloadSize);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+}
+
+std::size_t maxFullGridSaveSize() {
+    // Each grid at its worst: an exception for every cell and PackBits
+    // literals all the way, which add a control byte per 128 plane bytes
+    std::size_t cells = static_cast<std::size_t>(maxSavedMazeSize) * maxSavedMazeSize;
+    std::size_t planeBytes = (cells + 7) / 8;
+    std::size_t grid = 4 + 5 * cells + planeBytes + planeBytes / 128 + 1;
+    return sizeof(SaveHeader) + sizeof(SaveWorldRecord) + 2 * grid
+        + (purpleBlockCount + cells) * sizeof(std::pair<int, int>);
+}
+
+static bool validDimensions(int width, int height) {
+    return width >= 3 && height >= 3 && width <= maxSavedMazeSize && height <= maxSavedMazeSize;
+}
+
+// A seed save is regenerated, so it may only name a size generation can build
+static bool validGeneratedDimensions(int width, int height) {
+    return validDimensions(width, height) && width >= 5 && height >= 5 && width % 2 == 1 && height % 2 == 1;
+}
+
+// Every one of count raw int32 pairs at pairs lies inside a width x height maze
+static bool pairsInside(const char* pairs, std::size_t count, int width, int height) {
+    for (std::size_t i = 0; i < count; ++i) {
+        std::int32_t xy[2];
+        std::memcpy(xy, pairs + i * sizeof(xy), sizeof(xy));
+        if (xy[0] < 0 || xy[1] < 0 || xy[0] >= width || xy[1] >= height) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void serializeFullGrid(const World& world, std::vector<char>& buffer) {
+    std::size_t cells = world.maze.size();
+    const char* blocks = reinterpret_cast<const char*>(world.purpleBlocks.begin());
+    const char* stack = reinterpret_cast<const char*>(world.enemy.backtrackStack.begin());
+    std::size_t blocksBytes = world.purpleBlocks.size() * sizeof(std::pair<int, int>);
+    std::size_t stackBytes = world.enemy.backtrackStack.size() * sizeof(std::pair<int, int>);
+
+    // resize() keeps the capacity of earlier saves, so repeated saves do not reallocate
+    buffer.resize(sizeof(SaveHeader) + sizeof(SaveWorldRecord));
+
+    SaveWorldRecord record = {};
+    record.seed = world.seed;
+    record.width = world.width;
+    record.height = world.height;
+    record.level = world.level;
+    record.playerX = world.playerX;
+    record.playerY = world.playerY;
+    record.exitX = world.exitX;
+    record.exitY = world.exitY;
+    record.powerUpX = world.powerUpX;
+    record.powerUpY = world.powerUpY;
+    record.powerUpActive = world.powerUpActive ? 1 : 0;
+    record.remainingTime = remainingTime(world);
+    record.enemyX = world.enemy.x;
+    record.enemyY = world.enemy.y;
+    record.purpleBlockCount = static_cast<std::uint32_t>(world.purpleBlocks.size());
+    record.backtrackDepth = static_cast<std::uint32_t>(world.enemy.backtrackStack.size());
+
+    record.mazeBytes = static_cast<std::uint32_t>(compressGrid(world.maze.data(), cells, '#', ' ', buffer));
+    buffer.insert(buffer.end(), blocks, blocks + blocksBytes);
+    record.visitedBytes = static_cast<std::uint32_t>(compressGrid(reinterpret_cast<const char*>(world.enemy.visited.data()), cells, 0, 1, buffer));
+    buffer.insert(buffer.end(), stack, stack + stackBytes);
+    std::memcpy(buffer.data() + sizeof(SaveHeader), &record, sizeof(record));
+
+    writeHeader(buffer, saveMagic, saveFormatVersion);
+}
+
+static void serializeSeedDelta(const World& world, std::vector<char>& buffer) {
+    buffer.resize(sizeof(SaveHeader) + sizeof(SeedSaveRecord));
+
+    SeedSaveRecord record = {};
+    record.seed = world.seed;
+    record.width = world.width;
+    record.height = world.height;
+    record.level = world.level;
+    record.playerX = world.playerX;
+    record.playerY = world.playerY;
+    record.enemyX = world.enemy.x;
+    record.enemyY = world.enemy.y;
+    record.powerUpCollected = world.powerUpActive ? 0 : 1;
+    record.purpleBlocksLeft = static_cast<std::uint8_t>(world.purpleBlocks.size());
+    record.remainingTime = remainingTime(world);
+    for (std::size_t i = 0; i < world.purpleBlocks.size(); ++i) {
+        record.purpleBlocks[i][0] = world.purpleBlocks[i].first;
+        record.purpleBlocks[i][1] = world.purpleBlocks[i].second;
+    }
+    std::memcpy(buffer.data() + sizeof(SaveHeader), &record, sizeof(record));
+
+    writeHeader(buffer, seedSaveMagic, seedSaveFormatVersion);
+}
+
+void serializeWorld(const World& world, std::vector<char>& buffer, SaveMode mode) {
+    PROFILE_ZONE("serializeWorld");
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    if (mode == SaveMode::SeedDelta) {
+        serializeSeedDelta(world, buffer);
+    }
+    else {
+        serializeFullGrid(world, buffer);
+    }
+}
+
+static bool deserializeFullGrid(World& world, const char* in, std::size_t payloadSize) {
+    if (payloadSize < sizeof(SaveWorldRecord)) {
+        return false;
+    }
+    SaveWorldRecord record;
+    std::memcpy(&record, in, sizeof(record));
+    in += sizeof(record);
+
+    // Sanity-check the record against the payload before anything is overwritten
+    if (!validDimensions(record.width, record.height)) {
+        return false;
+    }
+    std::size_t cells = static_cast<std::size_t>(record.width) * record.height;
+    if (record.purpleBlockCount > static_cast<std::uint32_t>(purpleBlockCount) || record.backtrackDepth > cells) {
+        return false;
+    }
+    std::size_t blocksBytes = record.purpleBlockCount * sizeof(std::pair<int, int>);
+    std::size_t stackBytes = record.backtrackDepth * sizeof(std::pair<int, int>);
+    if (payloadSize != sizeof(SaveWorldRecord) + record.mazeBytes + blocksBytes + record.visitedBytes + stackBytes) {
+        return false;
+    }
+    auto inside = [&](int x, int y) { return x >= 0 && y >= 0 && x < record.width && y < record.height; };
+    if (!inside(record.playerX, record.playerY) || !inside(record.exitX, record.exitY) || !inside(record.enemyX, record.enemyY)
+        || (record.powerUpActive && !inside(record.powerUpX, record.powerUpY))) {
+        return false;
+    }
+    const char* blocks = in + record.mazeBytes;
+    const char* visited = blocks + blocksBytes;
+    const char* stack = visited + record.visitedBytes;
+    if (!pairsInside(blocks, record.purpleBlockCount, record.width, record.height)
+        || !pairsInside(stack, record.backtrackDepth, record.width, record.height)) {
+        return false;
+    }
+
+    // Expand both grids before committing anything, so a bad stream leaves the world untouched.
+    // Per thread, as the autosaver and the catalog load and save alongside the game.
+    static thread_local std::vector<char> mazeCells, visitedCells;
+    mazeCells.resize(cells);
+    visitedCells.resize(cells);
+    if (decompressGrid(in, record.mazeBytes, mazeCells.data(), cells, '#', ' ') != record.mazeBytes ||
+        decompressGrid(visited, record.visitedBytes, visitedCells.data(), cells, 0, 1) != record.visitedBytes) {
+        return false;
+    }
+
+    world.seed = record.seed;
+    world.width = record.width;
+    world.height = record.height;
+    world.level = record.level;
+    world.playerX = record.playerX;
+    world.playerY = record.playerY;
+    world.exitX = record.exitX;
+    world.exitY = record.exitY;
+    world.powerUpX = record.powerUpX;
+    world.powerUpY = record.powerUpY;
+    world.powerUpActive = record.powerUpActive != 0;
+    world.timeLimit = record.remainingTime;
+    world.levelTicks = 0;
+
+    resetLevelArena(world);
+    std::memcpy(world.maze.data(), mazeCells.data(), cells);
+    world.purpleBlocks.resize(record.purpleBlockCount);
+    std::memcpy(static_cast<void*>(world.purpleBlocks.begin()), blocks, blocksBytes);
+
+    world.enemy.reset(world.arena, world.width, world.height, record.enemyX, record.enemyY);
+    std::memcpy(world.enemy.visited.data(), visitedCells.data(), cells);
+    world.enemy.backtrackStack.resize(record.backtrackDepth);
+    std::memcpy(static_cast<void*>(world.enemy.backtrackStack.begin()), stack, stackBytes);
+    return true;
+}
+
+static bool deserializeSeedDelta(World& world, const char* in, std::size_t payloadSize) {
+    if (payloadSize != sizeof(SeedSaveRecord)) {
+        return false;
+    }
+    SeedSaveRecord record;
+    std::memcpy(&record, in, sizeof(record));
+
+    if (!validGeneratedDimensions(record.width, record.height) || record.purpleBlocksLeft > purpleBlockCount) {
+        return false;
+    }
+    auto inside = [&](int x, int y) { return x >= 0 && y >= 0 && x < record.width && y < record.height; };
+    if (!inside(record.playerX, record.playerY) || !inside(record.enemyX, record.enemyY)) {
+        return false;
+    }
+
+    // Rebuild the level exactly as it was generated
+    world.seed = record.seed;
+    world.width = record.width;
+    world.height = record.height;
+    world.level = record.level;
+    startLevel(world);
+
+    // Clear the purple blocks that were solved since
+    auto stillStanding = [&](const std::pair<int, int>& block) {
+        for (int i = 0; i < record.purpleBlocksLeft; ++i) {
+            if (record.purpleBlocks[i][0] == block.first && record.purpleBlocks[i][1] == block.second) {
+                return true;
+            }
+        }
+        return false;
+    };
+    for (const auto& block : world.purpleBlocks) {
+        if (!stillStanding(block)) {
+            world.maze[block.second][block.first] = ' ';
+        }
+    }
+    world.purpleBlocks.erase(std::remove_if(world.purpleBlocks.begin(), world.purpleBlocks.end(),
+        [&](const std::pair<int, int>& block) { return !stillStanding(block); }), world.purpleBlocks.end());
+
+    if (record.powerUpCollected) {
+        world.powerUpActive = false;
+        world.powerUpX = -1;
+        world.powerUpY = -1;
+    }
+
+    world.playerX = record.playerX;
+    world.playerY = record.playerY;
+    world.enemy.reset(world.arena, world.width, world.height, record.enemyX, record.enemyY);
+    world.timeLimit = record.remainingTime;
+    world.levelTicks = 0;
+    return true;
+}
+
+bool deserializeWorld(World& world, const char* data, std::size_t size) {
+    PROFILE_ZONE("deserializeWorld");
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    SaveHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.headerSize != sizeof(SaveHeader) || header.payloadSize != size - sizeof(header)) {
+        return false;
+    }
+    const char* payload = data + sizeof(header);
+    if (crc32(payload, header.payloadSize) != header.checksum) {
+        return false;
+    }
+
+    if (header.magic == saveMagic && header.version == saveFormatVersion) {
+        return deserializeFullGrid(world, payload, header.payloadSize);
+    }
+    if (header.magic == seedSaveMagic && header.version == seedSaveFormatVersion) {
+        return deserializeSeedDelta(world, payload, header.payloadSize);
+    }
+    return false;
+}
+
+bool writeFileAtomically(const std::string& filename, const char* data, std::size_t size) {
+    PROFILE_ZONE("writeFileAtomically");
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    std::string tempName = filename + ".tmp";
+    std::FILE* file = std::fopen(tempName.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Unable to open file for writing" << std::endl;
+        return false;
+    }
+    bool written = std::fwrite(data, 1, size, file) == size && std::fflush(file) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    written = (std::fclose(file) == 0) && written;
+    if (!written) {
+        std::remove(tempName.c_str());
+        return false;
+    }
+    return replaceFile(tempName, filename);
+}
+
+bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    // std::rename refuses to replace an existing file on Windows
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+bool saveWorld(const World& world, const std::string& filename, SaveMode mode) {
+    static thread_local std::vector<char> buffer;
+    serializeWorld(world, buffer, mode);
+    return writeFileAtomically(filename, buffer.data(), buffer.size());
+}
+
+bool loadWorld(World& world, const std::string& filename) {
+    MemoryTagScope memoryTag(MemoryTag::Save);
+    std::ifstream infile(filename, std::ios::binary | std::ios::ate);
+    if (!infile) {
+        return false; // Unable to open file
+    }
+    std::streamsize size = infile.tellg();
+    if (size <= 0) {
+        return false;
+    }
+    static thread_local std::vector<char> buffer;
+    buffer.resize(static_cast<std::size_t>(size));
+    infile.seekg(0);
+    if (!infile.read(buffer.data(), size)) {
+        return false;
+    }
+    return deserializeWorld(world, buffer.data(), buffer.size());
+}
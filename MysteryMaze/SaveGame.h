@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct World;
+
+// Binary save files come in two flavours, told apart by the header magic.
+//
+// Full grid ("MZSV"), all fields little-endian:
+//   SaveHeader                    magic, version, payload size, CRC32 of the payload
+//   SaveWorldRecord               fixed-size scalar state
+//   maze cells                    mazeBytes of compressGrid output ('#' / ' ')
+//   purple blocks                 purpleBlockCount * (int32 x, int32 y)
+//   enemy visited grid            visitedBytes of compressGrid output (0 / 1)
+//   enemy backtrack stack         backtrackDepth * (int32 x, int32 y)
+//
+// Seed plus delta ("MZSD"):
+//   SaveHeader
+//   SeedSaveRecord                seed and size to regenerate the level, then
+//                                 what changed since it started
+//
+// Bump the matching version whenever a layout changes shape.
+const std::uint32_t saveMagic = 0x56535a4d;     // "MZSV"
+const std::uint32_t seedSaveMagic = 0x44535a4d; // "MZSD"
+const std::uint16_t saveFormatVersion = 3;
+const std::uint16_t seedSaveFormatVersion = 1;
+
+enum class SaveMode {
+    FullGrid,  // Every cell plus the enemy's whole search state
+    SeedDelta, // Regenerate from the seed, then apply the recorded changes
+};
+
+#pragma pack(push, 1)
+struct SaveHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t headerSize;
+    std::uint32_t payloadSize;
+    std::uint32_t checksum;
+};
+
+struct SaveWorldRecord {
+    std::uint32_t seed;
+    std::int32_t width, height, level;
+    std::int32_t playerX, playerY;
+    std::int32_t exitX, exitY;
+    std::int32_t powerUpX, powerUpY;
+    std::uint8_t powerUpActive;
+    std::uint8_t reserved[3];
+    float remainingTime;
+    std::int32_t enemyX, enemyY;
+    std::uint32_t purpleBlockCount;
+    std::uint32_t backtrackDepth;
+    std::uint32_t mazeBytes;
+    std::uint32_t visitedBytes;
+};
+
+// The enemy restarts its search from its saved position, and the purple
+// blocks still standing are listed so solved ones can be cleared again.
+struct SeedSaveRecord {
+    std::uint32_t seed;
+    std::int32_t width, height, level;
+    std::int32_t playerX, playerY;
+    std::int32_t enemyX, enemyY;
+    std::uint8_t powerUpCollected;
+    std::uint8_t purpleBlocksLeft;
+    std::uint8_t reserved[2];
+    float remainingTime;
+    std::int32_t purpleBlocks[2][2];
+};
+#pragma pack(pop)
+
+std::uint32_t crc32(const void* data, std::size_t size);
+
+// Largest maze we accept from a file, to reject corrupt dimensions before allocating
+const int maxSavedMazeSize = 8192;
+
+// Upper bound on a full-grid save deserializeWorld could accept, for readers
+// sizing a buffer from a length they have not yet checked
+std::size_t maxFullGridSaveSize();
+
+// Serialize the world into buffer (reusing its capacity) / restore it from a buffer.
+// deserializeWorld accepts either save mode and validates the header and
+// checksum before touching the world.
+void serializeWorld(const World& world, std::vector<char>& buffer, SaveMode mode = SaveMode::FullGrid);
+bool deserializeWorld(World& world, const char* data, std::size_t size);
+
+// Write data to filename.tmp, flush it to disk and rename it over filename,
+// so a crash mid-save never leaves a torn file behind
+bool writeFileAtomically(const std::string& filename, const char* data, std::size_t size);
+
+// Rename from over to, replacing to if it already exists
+bool replaceFile(const std::string& from, const std::string& to);
+
+// One buffered write / one read of a complete snapshot
+bool saveWorld(const World& world, const std::string& filename, SaveMode mode = SaveMode::FullGrid);
+bool loadWorld(World& world, const std::string& filename);
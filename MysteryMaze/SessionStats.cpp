@@ -0,0 +1,98 @@
+#include "SessionStats.h"
+#include "World.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+    const std::size_t worstHitchesShown = 10;
+}
+
+SessionStats::SessionStats() {
+    hitches.reserve(hitchLogSize);
+    levels.reserve(64);
+}
+
+void SessionStats::recordFrame(float seconds, int level, std::uint32_t tick) {
+    if (pauses != pausesSeen) {
+        pausesSeen = pauses;
+        ++pausedFrames;
+        return;
+    }
+    double us = seconds * 1e6;
+    std::uint32_t frameUs = static_cast<std::uint32_t>(std::min(us, static_cast<double>(UINT32_MAX)));
+    frames.record(frameUs);
+
+    LevelFrames& onLevel = framesOn(level);
+    ++onLevel.frames;
+    onLevel.worstUs = std::max(onLevel.worstUs, frameUs);
+    if (frameUs > hitchMs * 1000) {
+        ++hitchCount;
+        ++onLevel.hitches;
+        if (frameUs > severeHitchMs * 1000) {
+            ++severeHitchCount;
+            ++onLevel.severeHitches;
+        }
+        if (hitches.size() < hitchLogSize) {
+            hitches.push_back({ frameUs, level, tick });
+        }
+    }
+}
+
+SessionStats::LevelFrames& SessionStats::framesOn(int level) {
+    if (levels.empty() || levels.back().level != level) {
+        auto found = std::find_if(levels.begin(), levels.end(), [level](const LevelFrames& entry) { return entry.level == level; });
+        if (found != levels.end()) {
+            return *found;
+        }
+        levels.emplace_back();
+        levels.back().level = level;
+    }
+    return levels.back();
+}
+
+void SessionStats::writeReport(std::ostream& out) const {
+    auto ms = [](std::uint32_t us) { return us / 1000.0; };
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2);
+
+    out << "Session performance: " << frames.count() << " frames, " << ticks.count() << " ticks";
+    if (pausedFrames > 0) {
+        out << " (" << pausedFrames << " frames waiting on the console left out)";
+    }
+    out << '\n';
+    out << "  frame  p50 " << ms(frames.percentile(0.50)) << " ms  p95 " << ms(frames.percentile(0.95))
+        << " ms  p99 " << ms(frames.percentile(0.99)) << " ms  max " << ms(frames.max()) << " ms\n";
+    out << "  tick   p50 " << ticks.percentile(0.50) / 1000.0 << " us  p95 " << ticks.percentile(0.95) / 1000.0
+        << " us  p99 " << ticks.percentile(0.99) / 1000.0 << " us  max " << ticks.max() / 1000.0 << " us\n";
+    out << "  hitches: " << hitchCount << " frames over " << hitchMs << " ms, " << severeHitchCount
+        << " over " << severeHitchMs << " ms\n";
+
+    if (hitchCount > 0) {
+        out << "  level    frames  >" << std::setw(2) << hitchMs << " ms  >" << std::setw(2) << severeHitchMs << " ms     worst\n";
+        for (const LevelFrames& level : levels) {
+            out << "  " << std::setw(5) << level.level << std::setw(10) << level.frames << std::setw(8) << level.hitches
+                << std::setw(8) << level.severeHitches << std::setw(8) << ms(level.worstUs) << " ms\n";
+        }
+
+        std::vector<Hitch> worst(hitches);
+        std::stable_sort(worst.begin(), worst.end(), [](const Hitch& a, const Hitch& b) { return a.frameUs > b.frameUs; });
+        worst.resize(std::min(worst.size(), worstHitchesShown));
+        out << "  worst hitches" << (hitchCount > hitches.size() ? " of the first logged" : "") << ":\n";
+        for (const Hitch& hitch : worst) {
+            out << "    " << std::setw(8) << ms(hitch.frameUs) << " ms on level " << hitch.level
+                << ", " << std::setprecision(1) << hitch.tick * tickSeconds << " s into the game\n" << std::setprecision(2);
+        }
+    }
+
+    out << "  memory        live KB    peak KB      allocs       frees\n";
+    for (int tag = 0; tag < static_cast<int>(MemoryTag::Count); ++tag) {
+        MemoryTagStats memory = memoryTagStats(static_cast<MemoryTag>(tag));
+        out << "    " << std::left << std::setw(10) << memoryTagName(static_cast<MemoryTag>(tag)) << std::right
+            << std::setw(9) << memory.liveBytes / 1024.0 << std::setw(11) << memory.peakBytes / 1024.0
+            << std::setw(12) << memory.allocations << std::setw(12) << memory.frees << '\n';
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
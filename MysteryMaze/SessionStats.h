@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "Histogram.h"
+#include "Profiler.h"
+
+// Frame and tick times over a whole play session, for the report printed
+// when the game ends. Frames are kept in microseconds and ticks in
+// nanoseconds, each in a Histogram, and a frame slower than hitchMs is a
+// hitch, remembered with the level it happened on.
+//
+// A frame or tick in which the game stopped for the console (a puzzle, the
+// level menu, loading) is not a hitch the player would blame on the game,
+// so it is counted as paused rather than timed.
+//
+// The report ends with live and peak heap bytes per memory tag.
+const std::uint32_t hitchMs = 16;
+const std::uint32_t severeHitchMs = 33;
+const std::size_t hitchLogSize = 256; // Hitches past this are counted but not listed
+
+class SessionStats {
+public:
+    SessionStats();
+
+    // The game is waiting on the console
+    void pause() { ++pauses; }
+    std::uint64_t pauseCount() const { return pauses; }
+
+    // At the start of each frame, with how long the one before it took
+    // and the level it was played on
+    void recordFrame(float seconds, int level, std::uint32_t tick);
+    void recordTick(std::uint64_t ns) { ticks.record(static_cast<std::uint32_t>(ns < UINT32_MAX ? ns : UINT32_MAX)); }
+
+    void writeReport(std::ostream& out) const;
+
+private:
+    struct Hitch {
+        std::uint32_t frameUs;
+        int level;
+        std::uint32_t tick; // Simulation tick the frame ended on
+    };
+
+    // Per level reached; grows only when a new level starts
+    struct LevelFrames {
+        int level = 0;
+        std::uint64_t frames = 0;
+        std::uint32_t hitches = 0;
+        std::uint32_t severeHitches = 0;
+        std::uint32_t worstUs = 0;
+    };
+
+    LevelFrames& framesOn(int level);
+
+    Histogram frames;
+    Histogram ticks;
+    std::uint64_t pauses = 0;
+    std::uint64_t pausesSeen = 0;
+    std::uint64_t pausedFrames = 0;
+    std::vector<Hitch> hitches;
+    std::uint64_t hitchCount = 0;
+    std::uint64_t severeHitchCount = 0;
+    std::vector<LevelFrames> levels;
+};
+
+// Times one tick into a SessionStats, unless the game paused during it
+class SessionTickTimer {
+public:
+    explicit SessionTickTimer(SessionStats& stats) : stats(stats), pausesAtStart(stats.pauseCount()), startNs(profileClockNs()) {}
+    ~SessionTickTimer() {
+        if (stats.pauseCount() == pausesAtStart) {
+            stats.recordTick(profileClockNs() - startNs);
+        }
+    }
+
+    SessionTickTimer(const SessionTickTimer&) = delete;
+    SessionTickTimer& operator=(const SessionTickTimer&) = delete;
+
+private:
+    SessionStats& stats;
+    std::uint64_t pausesAtStart;
+    std::uint64_t startNs;
+};
@@ -0,0 +1,311 @@
+#include "Spectator.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+
+static const int watchRetryTicks = ticksPerSecond / 2;
+
+SpectatorBroadcaster::SpectatorBroadcaster(int maxSpectators) : maxSpectators(std::max(1, maxSpectators)) {
+    watchers.reserve(this->maxSpectators);
+    byAddress.reserve(this->maxSpectators);
+}
+
+bool SpectatorBroadcaster::listen(unsigned short port) {
+    if (socket.bind(port) != sf::Socket::Done) {
+        return false;
+    }
+    socket.setBlocking(false);
+    return true;
+}
+
+std::uint64_t SpectatorBroadcaster::keyOf(const sf::IpAddress& address, unsigned short port) {
+    return static_cast<std::uint64_t>(address.toInteger()) << 16 | port;
+}
+
+void SpectatorBroadcaster::tick(const World& world) {
+    MemoryTagScope memoryTag(MemoryTag::Network);
+    ++ticks;
+    ++counts.ticks;
+    receive();
+
+    // A new level goes to everyone in full; otherwise just what changed
+    if (!haveLevel || world.arenaEpoch != epoch) {
+        haveLevel = true;
+        epoch = world.arenaEpoch;
+        levelBlocks.assign(world.purpleBlocks.begin(), world.purpleBlocks.end());
+        previous = racerStateOf(world, levelBlocks, RacerStatus::Racing, 0);
+        for (Watcher& watcher : watchers) {
+            watcher.needsLevel = true;
+        }
+    }
+    RacerState now = racerStateOf(world, levelBlocks, RacerStatus::Racing, 0);
+
+    SharedDatagram changes = pool.acquire();
+    WireBuffer& buffer = changes.buffer();
+    buffer.putUint8(static_cast<std::uint8_t>(SpectatorMessage::Tick));
+    buffer.emplace<TickHeader>()->tick = ticks;
+    writeRacerFields(buffer, previous, now);
+    previous = now;
+    ++counts.serialized;
+
+    bool socketReady = true;
+    for (std::size_t i = 0; i < watchers.size();) {
+        Watcher& watcher = watchers[i];
+        if (ticks - watcher.lastHeard > static_cast<std::uint32_t>(spectatorTimeoutTicks)) {
+            remove(i);
+            continue;
+        }
+        if (watcher.needsLevel) {
+            if (!levelDatagram) {
+                buildLevel(world);
+            }
+            watcher.needsLevel = false;
+            queue(watcher, levelDatagram);
+            ++counts.levelsSent;
+        }
+        else {
+            queue(watcher, changes);
+        }
+        // Once the socket is full the rest just queue, and go out first next tick
+        if (socketReady) {
+            socketReady = flush(watcher);
+        }
+        ++i;
+    }
+    levelDatagram.reset();
+}
+
+void SpectatorBroadcaster::finish() {
+    SharedDatagram end = pool.acquire();
+    end.buffer().putUint8(static_cast<std::uint8_t>(SpectatorMessage::End));
+    for (Watcher& watcher : watchers) {
+        sendDatagram(socket, end.buffer(), watcher.address, watcher.port);
+    }
+    watchers.clear();
+    byAddress.clear();
+}
+
+void SpectatorBroadcaster::receive() {
+    sf::IpAddress address;
+    unsigned short port;
+    while (receiveDatagram(socket, incoming, address, port) == sf::Socket::Done) {
+        WireReader reader(incoming);
+        std::uint8_t type = 0;
+        if (!reader.getUint8(type)) {
+            continue;
+        }
+        auto known = byAddress.find(keyOf(address, port));
+        if (static_cast<SpectatorMessage>(type) == SpectatorMessage::Watch) {
+            const WatchHeader* watch = reader.view<WatchHeader>();
+            if (!watch || watch->version != spectatorProtocolVersion) {
+                continue;
+            }
+            if (known != byAddress.end()) {
+                watchers[known->second].needsLevel = true;
+                watchers[known->second].lastHeard = ticks;
+            }
+            else if (static_cast<int>(watchers.size()) < maxSpectators) {
+                byAddress.emplace(keyOf(address, port), watchers.size());
+                watchers.emplace_back();
+                watchers.back().address = address;
+                watchers.back().port = port;
+                watchers.back().lastHeard = ticks;
+            }
+        }
+        else if (known != byAddress.end()) {
+            if (static_cast<SpectatorMessage>(type) == SpectatorMessage::Still) {
+                watchers[known->second].lastHeard = ticks;
+            }
+            else if (static_cast<SpectatorMessage>(type) == SpectatorMessage::Leave) {
+                remove(known->second);
+            }
+        }
+    }
+}
+
+void SpectatorBroadcaster::remove(std::size_t index) {
+    byAddress.erase(keyOf(watchers[index].address, watchers[index].port));
+    if (index + 1 < watchers.size()) {
+        watchers[index] = std::move(watchers.back());
+        byAddress[keyOf(watchers[index].address, watchers[index].port)] = index;
+    }
+    watchers.pop_back();
+}
+
+void SpectatorBroadcaster::queue(Watcher& watcher, const SharedDatagram& datagram) {
+    if (watcher.queued == spectatorBacklog) {
+        // Too far behind to catch up tick by tick: start it over from the level
+        for (SharedDatagram& held : watcher.backlog) {
+            held.reset();
+        }
+        watcher.first = 0;
+        watcher.queued = 0;
+        watcher.needsLevel = true;
+        ++counts.dropped;
+        return;
+    }
+    watcher.backlog[(watcher.first + watcher.queued) % spectatorBacklog] = datagram;
+    ++watcher.queued;
+}
+
+bool SpectatorBroadcaster::flush(Watcher& watcher) {
+    while (watcher.queued > 0) {
+        SharedDatagram& next = watcher.backlog[watcher.first];
+        sf::Socket::Status status = sendDatagram(socket, next.buffer(), watcher.address, watcher.port);
+        if (status == sf::Socket::NotReady || status == sf::Socket::Partial) {
+            ++counts.backlogged;
+            return false;
+        }
+        if (status == sf::Socket::Done) {
+            ++counts.datagramsSent;
+            counts.bytesSent += next.buffer().size();
+        }
+        next.reset();
+        watcher.first = (watcher.first + 1) % spectatorBacklog;
+        --watcher.queued;
+    }
+    return true;
+}
+
+void SpectatorBroadcaster::buildLevel(const World& world) {
+    levelDatagram = pool.acquire();
+    WireBuffer& buffer = levelDatagram.buffer();
+    buffer.putUint8(static_cast<std::uint8_t>(SpectatorMessage::Level));
+    LevelHeader* header = buffer.emplace<LevelHeader>();
+    header->version = spectatorProtocolVersion;
+    header->seed = world.seed;
+    header->width = world.width;
+    header->height = world.height;
+    header->level = world.level;
+    header->tick = ticks;
+    writeRacerFields(buffer, RacerState(), previous);
+    ++counts.serialized;
+}
+
+SpectatorClient::SpectatorClient(World& world) : world(world) {
+}
+
+bool SpectatorClient::connect(const sf::IpAddress& game, unsigned short port) {
+    if (socket.bind(sf::Socket::AnyPort) != sf::Socket::Done) {
+        return false;
+    }
+    socket.setBlocking(false);
+    gameAddress = game;
+    gamePort = port;
+    ticks = 0;
+    lastHeard = 0;
+    return true;
+}
+
+void SpectatorClient::tick() {
+    MemoryTagScope memoryTag(MemoryTag::Network);
+    ++ticks;
+    sf::IpAddress address;
+    unsigned short port;
+    while (receiveDatagram(socket, incoming, address, port) == sf::Socket::Done) {
+        if (address != gameAddress || port != gamePort) {
+            continue;
+        }
+        stats.bytesReceived += incoming.size();
+        ++stats.packetsReceived;
+        lastHeard = ticks;
+        WireReader reader(incoming);
+        std::uint8_t type = 0;
+        if (!reader.getUint8(type)) {
+            continue;
+        }
+        if (static_cast<SpectatorMessage>(type) == SpectatorMessage::Level) {
+            handleLevel(reader);
+        }
+        else if (static_cast<SpectatorMessage>(type) == SpectatorMessage::Tick) {
+            handleTick(reader);
+        }
+        else if (static_cast<SpectatorMessage>(type) == SpectatorMessage::End) {
+            gameOver = true;
+        }
+    }
+
+    if (gameOver) {
+        return;
+    }
+    if (!inSync) {
+        if (lastAsked == 0 || ticks - lastAsked >= static_cast<std::uint32_t>(watchRetryTicks)) {
+            send(SpectatorMessage::Watch);
+            lastAsked = ticks;
+        }
+    }
+    else if (ticks - lastSent >= static_cast<std::uint32_t>(ticksPerSecond)) {
+        send(SpectatorMessage::Still);
+    }
+}
+
+void SpectatorClient::leave() {
+    if (!gameOver) {
+        send(SpectatorMessage::Leave);
+    }
+}
+
+void SpectatorClient::handleLevel(WireReader& reader) {
+    const LevelHeader* header = reader.view<LevelHeader>();
+    RacerState full;
+    if (!header || header->version != spectatorProtocolVersion
+        || !validRaceMazeSize(header->width, header->height) || !readRacerFields(reader, full)) {
+        return;
+    }
+
+    // The same seed and size as the game's, so the same maze and blocks
+    if (!haveLevel || world.seed != header->seed || world.width != header->width || world.height != header->height
+        || world.level != header->level) {
+        world.seed = header->seed;
+        world.width = header->width;
+        world.height = header->height;
+        world.level = header->level;
+        world.showMessages = false;
+        startLevel(world);
+        levelBlocks.assign(world.purpleBlocks.begin(), world.purpleBlocks.end());
+        haveLevel = true;
+    }
+    if (!applyRacerState(world, levelBlocks, full)) {
+        return;
+    }
+    state = full;
+    lastTick = header->tick;
+    inSync = true;
+}
+
+void SpectatorClient::handleTick(WireReader& reader) {
+    const TickHeader* header = reader.view<TickHeader>();
+    if (!inSync || !header) {
+        return;
+    }
+    std::uint32_t tick = header->tick;
+    if (static_cast<std::int32_t>(tick - lastTick) <= 0) {
+        return; // Late or duplicated
+    }
+    if (tick != lastTick + 1) {
+        // One went missing, and every tick after builds on it
+        inSync = false;
+        ++restartCount;
+        return;
+    }
+    RacerState next = state;
+    if (!readRacerFields(reader, next) || (next != state && !applyRacerState(world, levelBlocks, next))) {
+        inSync = false;
+        ++restartCount;
+        return;
+    }
+    state = next;
+    lastTick = tick;
+}
+
+void SpectatorClient::send(SpectatorMessage type) {
+    outgoing.clear();
+    outgoing.putUint8(static_cast<std::uint8_t>(type));
+    if (type == SpectatorMessage::Watch) {
+        outgoing.emplace<WatchHeader>()->version = spectatorProtocolVersion;
+    }
+    if (sendDatagram(socket, outgoing, gameAddress, gamePort) == sf::Socket::Done) {
+        stats.bytesSent += outgoing.size();
+        ++stats.packetsSent;
+    }
+    lastSent = ticks;
+}
@@ -0,0 +1,179 @@
+#pragma once
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "RaceProtocol.h"
+#include "WireBuffer.h"
+#include "World.h"
+
+// Live games streamed to spectators. A spectator is sent the level's seed
+// and size once, builds the maze from them as a race client does, and from
+// then on gets one small datagram a tick: the player's RacerState fields
+// that changed since the tick before (player, enemy, blocks, power-up and
+// timer), written with writeRacerFields.
+//
+// Every datagram is a uint8 SpectatorMessage followed by its header:
+//   Watch  spectator -> game  WatchHeader; to start watching, or to start over
+//                             after missing a tick
+//   Still  spectator -> game  (none); once a second, so the game keeps sending
+//   Level  game -> spectator  LevelHeader, then the full state as fields against RacerState()
+//   Tick   game -> spectator  TickHeader, then the fields changed since tick - 1
+//   End    game -> spectator  (none); the game is over
+//   Leave  spectator -> game  (none)
+//
+// A tick lost on the way leaves the spectator one behind for good, so it
+// asks for the Level again rather than guessing.
+const std::uint16_t spectatorProtocolVersion = 1;
+const int spectatorTimeoutTicks = 5 * ticksPerSecond;
+const std::size_t spectatorBacklog = 8; // Datagrams queued for a spectator the socket would not take
+
+enum class SpectatorMessage : std::uint8_t {
+    Watch = 1,
+    Still = 2,
+    Level = 3,
+    Tick = 4,
+    End = 5,
+    Leave = 6,
+};
+
+struct WatchHeader {
+    LittleUint16 version;
+};
+
+struct LevelHeader {
+    LittleUint16 version;
+    LittleUint32 seed;
+    LittleInt32 width, height, level;
+    LittleUint32 tick;
+};
+
+struct TickHeader {
+    LittleUint32 tick;
+};
+
+// What a broadcast took, since it started
+struct BroadcastStats {
+    std::uint64_t ticks = 0;
+    std::uint64_t levelsSent = 0;   // To spectators joining, starting over or on a new level
+    std::uint64_t datagramsSent = 0;
+    std::uint64_t bytesSent = 0;
+    std::uint64_t serialized = 0;   // Datagrams built; each is shared by every spectator it goes to
+    std::uint64_t backlogged = 0;   // Sends the socket would not take at once
+    std::uint64_t dropped = 0;      // Spectators whose backlog overflowed, and had to start over
+};
+
+// Streams one World to every spectator that asks. Each tick's datagram is
+// built once into a SharedDatagram, and every spectator's send comes from
+// that one buffer; a spectator the socket cannot take more for right now
+// holds a reference in its backlog until it can, so nothing is copied per
+// spectator either way. All spectators share the one UDP port.
+class SpectatorBroadcaster {
+public:
+    explicit SpectatorBroadcaster(int maxSpectators);
+
+    SpectatorBroadcaster(const SpectatorBroadcaster&) = delete;
+    SpectatorBroadcaster& operator=(const SpectatorBroadcaster&) = delete;
+
+    // Bind the socket; port 0 picks a free one
+    bool listen(unsigned short port);
+    unsigned short port() const { return socket.getLocalPort(); }
+
+    // Once per fixed tick, after the world has stepped: take in spectators,
+    // then send each of them this tick. A new level is noticed by the
+    // world's arena epoch and sent to everyone.
+    void tick(const World& world);
+
+    // Tell every spectator the game is over
+    void finish();
+
+    int spectators() const { return static_cast<int>(watchers.size()); }
+    const BroadcastStats& stats() const { return counts; }
+
+private:
+    struct Watcher {
+        sf::IpAddress address;
+        unsigned short port = 0;
+        std::uint32_t lastHeard = 0;
+        bool needsLevel = true;
+        SharedDatagram backlog[spectatorBacklog]; // A ring, oldest at first
+        std::size_t first = 0;
+        std::size_t queued = 0;
+    };
+
+    static std::uint64_t keyOf(const sf::IpAddress& address, unsigned short port);
+    void receive();
+    void remove(std::size_t index);
+    void queue(Watcher& watcher, const SharedDatagram& datagram);
+    bool flush(Watcher& watcher); // False once the socket stops taking datagrams
+    void buildLevel(const World& world);
+
+    int maxSpectators;
+    sf::UdpSocket socket;
+    WireBuffer incoming;
+    SharedWireBufferPool pool; // Before everything holding its datagrams, so it goes last
+    std::vector<Watcher> watchers;
+    std::unordered_map<std::uint64_t, std::size_t> byAddress; // Into watchers
+
+    std::uint32_t epoch = 0;
+    bool haveLevel = false;
+    BlockList levelBlocks;
+    RacerState previous;
+    SharedDatagram levelDatagram; // This tick's Level, built the first time someone needs it
+    std::uint32_t ticks = 0;
+    BroadcastStats counts;
+};
+
+// Watches a broadcast game. The world passed in is for drawing, like a race
+// client's: built from the seed in each Level and moved only by the ticks.
+class SpectatorClient {
+public:
+    explicit SpectatorClient(World& world);
+
+    SpectatorClient(const SpectatorClient&) = delete;
+    SpectatorClient& operator=(const SpectatorClient&) = delete;
+
+    // Start asking to watch; the Level arrives during a later tick()
+    bool connect(const sf::IpAddress& game, unsigned short port);
+
+    // Once per fixed tick: apply what the game sent, and keep it sending
+    void tick();
+
+    // Tell the game we are gone rather than letting it time out
+    void leave();
+
+    bool watching() const { return inSync; }
+    bool ended() const { return gameOver; }
+    bool timedOut() const { return ticks - lastHeard > static_cast<std::uint32_t>(spectatorTimeoutTicks); }
+    std::uint32_t gameTick() const { return lastTick; }
+    const RacerState& player() const { return state; }
+    std::uint32_t restarts() const { return restartCount; } // Times a missed tick had us ask for the level again
+    const TrafficStats& traffic() const { return stats; }
+
+private:
+    void handleLevel(WireReader& reader);
+    void handleTick(WireReader& reader);
+    void send(SpectatorMessage type);
+
+    World& world;
+    sf::UdpSocket socket;
+    sf::IpAddress gameAddress;
+    unsigned short gamePort = 0;
+    WireBuffer incoming;
+    WireBuffer outgoing;
+    BlockList levelBlocks;
+    RacerState state;
+
+    bool inSync = false;
+    bool gameOver = false;
+    bool haveLevel = false;
+    std::uint32_t lastTick = 0;
+    std::uint32_t ticks = 0;
+    std::uint32_t lastHeard = 0;
+    std::uint32_t lastAsked = 0;
+    std::uint32_t lastSent = 0;
+    std::uint32_t restartCount = 0;
+    TrafficStats stats;
+};
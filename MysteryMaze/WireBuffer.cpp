@@ -0,0 +1,53 @@
+#include "WireBuffer.h"
+
+WireBuffer* WireBufferPool::acquire() {
+    if (free.empty()) {
+        buffers.emplace_back(new WireBuffer());
+        free.reserve(buffers.size()); // So release never has to grow it
+        return buffers.back().get();
+    }
+    WireBuffer* buffer = free.back();
+    free.pop_back();
+    buffer->clear();
+    return buffer;
+}
+
+void WireBufferPool::release(WireBuffer* buffer) {
+    if (buffer) {
+        free.push_back(buffer);
+    }
+}
+
+SharedDatagram SharedWireBufferPool::acquire() {
+    SharedDatagram::Entry* entry = nullptr;
+    if (free.empty()) {
+        entries.emplace_back(new SharedDatagram::Entry());
+        free.reserve(entries.size()); // So recycle never has to grow it
+        entry = entries.back().get();
+        entry->pool = this;
+    }
+    else {
+        entry = free.back();
+        free.pop_back();
+        entry->buffer.clear();
+    }
+    return SharedDatagram(entry);
+}
+
+void SharedWireBufferPool::recycle(SharedDatagram::Entry* entry) {
+    free.push_back(entry);
+}
+
+sf::Socket::Status sendDatagram(sf::UdpSocket& socket, const WireBuffer& buffer, const sf::IpAddress& address, unsigned short port) {
+    if (buffer.full()) {
+        return sf::Socket::Error;
+    }
+    return socket.send(buffer.data(), buffer.size(), address, port);
+}
+
+sf::Socket::Status receiveDatagram(sf::UdpSocket& socket, WireBuffer& buffer, sf::IpAddress& address, unsigned short& port) {
+    std::size_t received = 0;
+    sf::Socket::Status status = socket.receive(buffer.receiveSpace(), wireBufferBytes, received, address, port);
+    buffer.received(status == sf::Socket::Done ? received : 0);
+    return status;
+}
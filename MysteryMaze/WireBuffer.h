@@ -0,0 +1,248 @@
+#pragma once
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Serialization for datagrams that never touches the heap. A WireBuffer is
+// a fixed block big enough for any datagram we send; messages are written
+// into it field by field or as whole structs, and the socket reads from and
+// receives into it directly, so nothing is copied on the way in or out.
+//
+// Everything on the wire is little-endian. Multi-byte fields in message
+// structs are LittleEndian<T>, which stores its bytes in wire order and has
+// an alignment of 1, so a struct made of them and single bytes has no
+// padding and the same layout on every compiler: it can be placed straight
+// into a buffer, or viewed where it lies in one that was received.
+const std::size_t wireBufferBytes = 1472; // The most one datagram carries over Ethernet without fragmenting
+
+template <typename T>
+class LittleEndian {
+public:
+    static_assert(std::is_integral<T>::value, "LittleEndian holds integers only");
+    using Unsigned = typename std::make_unsigned<T>::type;
+
+    LittleEndian() = default;
+    LittleEndian(T value) { *this = value; }
+
+    LittleEndian& operator=(T value) {
+        Unsigned bits = static_cast<Unsigned>(value);
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            bytes[i] = static_cast<unsigned char>(bits >> (8 * i));
+        }
+        return *this;
+    }
+
+    operator T() const {
+        Unsigned bits = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            bits = static_cast<Unsigned>(bits | static_cast<Unsigned>(bytes[i]) << (8 * i));
+        }
+        return static_cast<T>(bits);
+    }
+
+private:
+    unsigned char bytes[sizeof(T)] = {};
+};
+
+using LittleInt16 = LittleEndian<std::int16_t>;
+using LittleUint16 = LittleEndian<std::uint16_t>;
+using LittleInt32 = LittleEndian<std::int32_t>;
+using LittleUint32 = LittleEndian<std::uint32_t>;
+static_assert(sizeof(LittleUint32) == 4 && alignof(LittleUint32) == 1, "LittleEndian must be unpadded");
+
+class WireBuffer {
+public:
+    void clear() { used = 0; overflowed = false; }
+    const char* data() const { return bytes; }
+    std::size_t size() const { return used; }
+    bool full() const { return overflowed; } // Something did not fit; the buffer must not be sent
+
+    // Room for a T at the end, constructed in place and left for the caller
+    // to fill; nullptr if it does not fit
+    template <typename T>
+    T* emplace() {
+        static_assert(alignof(T) == 1 && std::is_trivially_copyable<T>::value, "Wire structs must be unpadded");
+        char* at = reserve(sizeof(T));
+        return at ? new (at) T() : nullptr;
+    }
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(alignof(T) == 1 && std::is_trivially_copyable<T>::value, "Wire structs must be unpadded");
+        append(&value, sizeof(T));
+    }
+
+    void putUint8(std::uint8_t value) {
+        char* at = reserve(1);
+        if (at) {
+            *at = static_cast<char>(value);
+        }
+    }
+
+    void append(const void* source, std::size_t count) {
+        char* at = reserve(count);
+        if (at && count > 0) {
+            std::memcpy(at, source, count);
+        }
+    }
+
+    // Datagram sockets write straight into the buffer
+    char* receiveSpace() { clear(); return bytes; }
+    void received(std::size_t count) { used = count < wireBufferBytes ? count : wireBufferBytes; }
+
+private:
+    char* reserve(std::size_t count) {
+        if (overflowed || count > wireBufferBytes - used) {
+            overflowed = true;
+            return nullptr;
+        }
+        char* at = bytes + used;
+        used += count;
+        return at;
+    }
+
+    std::size_t used = 0;
+    bool overflowed = false;
+    char bytes[wireBufferBytes];
+};
+
+// Reads a received datagram in place
+class WireReader {
+public:
+    WireReader(const char* data, std::size_t size) : next(data), end(data + size) {}
+    explicit WireReader(const WireBuffer& buffer) : WireReader(buffer.data(), buffer.size()) {}
+
+    // The T at the read position, where it lies in the datagram; nullptr if
+    // the datagram is too short
+    template <typename T>
+    const T* view() {
+        static_assert(alignof(T) == 1 && std::is_trivially_copyable<T>::value, "Wire structs must be unpadded");
+        if (remaining() < sizeof(T)) {
+            return nullptr;
+        }
+        const T* value = reinterpret_cast<const T*>(next);
+        next += sizeof(T);
+        return value;
+    }
+
+    template <typename T>
+    bool get(T& value) {
+        const T* at = view<T>();
+        if (!at) {
+            return false;
+        }
+        value = *at;
+        return true;
+    }
+
+    bool getUint8(std::uint8_t& value) {
+        if (remaining() < 1) {
+            return false;
+        }
+        value = static_cast<std::uint8_t>(*next++);
+        return true;
+    }
+
+    std::size_t remaining() const { return static_cast<std::size_t>(end - next); }
+
+private:
+    const char* next;
+    const char* end;
+};
+
+// Buffers handed out and taken back, for datagrams that outlive the call
+// that made them (held back by a NetworkEmulator, say). The pool only
+// allocates while it grows to the most ever out at once. One owner thread.
+class WireBufferPool {
+public:
+    WireBuffer* acquire();
+    void release(WireBuffer* buffer);
+
+    std::size_t allocated() const { return buffers.size(); }
+
+private:
+    std::vector<std::unique_ptr<WireBuffer>> buffers;
+    std::vector<WireBuffer*> free;
+};
+
+// A datagram many sends share, such as one tick of a broadcast built once
+// for every spectator. Copies of the handle count references, and the
+// buffer goes back to its pool when the last one lets go, so a datagram
+// still queued for a slow receiver outlives the tick that built it. The
+// pool must outlive every handle. One owner thread.
+class SharedWireBufferPool;
+
+class SharedDatagram {
+public:
+    SharedDatagram() = default;
+    SharedDatagram(const SharedDatagram& other) : entry(other.entry) { retain(); }
+    SharedDatagram(SharedDatagram&& other) : entry(other.entry) { other.entry = nullptr; }
+    SharedDatagram& operator=(SharedDatagram other) { std::swap(entry, other.entry); return *this; }
+    ~SharedDatagram() { reset(); }
+
+    void reset();
+    explicit operator bool() const { return entry != nullptr; }
+    WireBuffer& buffer() const;
+    int references() const;
+
+private:
+    friend class SharedWireBufferPool;
+    struct Entry;
+    explicit SharedDatagram(Entry* entry) : entry(entry) { retain(); }
+    void retain();
+
+    Entry* entry = nullptr;
+};
+
+class SharedWireBufferPool {
+public:
+    SharedWireBufferPool() = default;
+    SharedWireBufferPool(const SharedWireBufferPool&) = delete;
+    SharedWireBufferPool& operator=(const SharedWireBufferPool&) = delete;
+
+    // An empty buffer with this one reference to it
+    SharedDatagram acquire();
+
+    std::size_t allocated() const { return entries.size(); }
+
+private:
+    friend class SharedDatagram;
+    void recycle(SharedDatagram::Entry* entry);
+
+    std::vector<std::unique_ptr<SharedDatagram::Entry>> entries;
+    std::vector<SharedDatagram::Entry*> free;
+};
+
+struct SharedDatagram::Entry {
+    WireBuffer buffer;
+    int references = 0;
+    SharedWireBufferPool* pool = nullptr;
+};
+
+inline void SharedDatagram::retain() {
+    if (entry) {
+        ++entry->references;
+    }
+}
+
+inline void SharedDatagram::reset() {
+    if (entry && --entry->references == 0) {
+        entry->pool->recycle(entry);
+    }
+    entry = nullptr;
+}
+
+inline WireBuffer& SharedDatagram::buffer() const { return entry->buffer; }
+inline int SharedDatagram::references() const { return entry ? entry->references : 0; }
+
+// Hand a buffer to the socket, or take the next datagram into one, without
+// going through an sf::Packet
+sf::Socket::Status sendDatagram(sf::UdpSocket& socket, const WireBuffer& buffer, const sf::IpAddress& address, unsigned short port);
+sf::Socket::Status receiveDatagram(sf::UdpSocket& socket, WireBuffer& buffer, sf::IpAddress& address, unsigned short& port);
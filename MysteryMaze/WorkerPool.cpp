@@ -0,0 +1,67 @@
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+WorkerPool::WorkerPool(unsigned threads) {
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::forEach(std::size_t count, const std::function<void(std::size_t)>& job) {
+    if (count == 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batchJob = &job;
+        batchSize = count;
+        nextItem = 0;
+        busyWorkers = static_cast<unsigned>(workers.size());
+        ++batch;
+    }
+    wakeWorkers.notify_all();
+    work();
+
+    // Every worker checks in, even one that woke too late to find an item left
+    std::unique_lock<std::mutex> lock(mutex);
+    batchDone.wait(lock, [this] { return busyWorkers == 0; });
+    batchJob = nullptr;
+}
+
+void WorkerPool::work() {
+    for (std::size_t item = nextItem++; item < batchSize; item = nextItem++) {
+        (*batchJob)(item);
+    }
+}
+
+void WorkerPool::workerLoop() {
+    nameProfilerThread("worker pool");
+    std::uint64_t seenBatch = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&] { return stopping || batch != seenBatch; });
+            if (stopping) {
+                return;
+            }
+            seenBatch = batch;
+        }
+        work();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0) {
+            batchDone.notify_one();
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads for running the same job over many independent
+// items, e.g. ticking every room on the server. forEach hands out item
+// indices one at a time, so a slow item never holds up a whole batch, and
+// the calling thread works through items too instead of sitting idle.
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads); // Extra threads besides the caller; 0 runs everything on the caller
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Run job(i) for every i below count and return once all have finished.
+    // Jobs must not touch each other's items.
+    void forEach(std::size_t count, const std::function<void(std::size_t)>& job);
+
+    unsigned threads() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+private:
+    void workerLoop();
+    void work();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable batchDone;
+    const std::function<void(std::size_t)>* batchJob = nullptr;
+    std::size_t batchSize = 0;
+    std::uint64_t batch = 0;      // Bumped for every forEach, so workers can tell a new batch from the last
+    unsigned busyWorkers = 0;
+    bool stopping = false;
+
+    std::atomic<std::size_t> nextItem{ 0 };
+};
@@ -0,0 +1,500 @@
+#include "World.h"
+#include "Profiler.h"
+#include "AllocationCounter.h"
+#include <iostream>
+#include <array>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+// Directions for maze carving (up, right, down, left)
+const std::vector<std::pair<int, int>> DIRECTIONS = {
+    {0, -1},  // Up
+    {1, 0},   // Right
+    {0, 1},   // Down
+    {-1, 0}   // Left
+};
+
+void Enemy::reset(LevelArena& arena, int mazeWidth, int mazeHeight, int startX, int startY) {
+    x = startX;
+    y = startY;
+    // A DFS path can never be longer than the number of cells
+    visited.bind(arena, mazeWidth, mazeHeight, false);
+    backtrackStack.bind(arena, static_cast<std::size_t>(mazeWidth) * mazeHeight);
+    visited[y][x] = true;
+    backtrackStack.push_back({ x, y });
+    moveTicks = 0;
+}
+
+// Rewind the level arena and carve out this level's maze and purple block list.
+// Anything else still pointing into the arena (e.g. the enemy) must be rebuilt afterwards.
+void resetLevelArena(World& world) {
+    world.mazeMapping.reset();
+    world.arena.reset();
+    ++world.arenaEpoch;
+    world.maze.bind(world.arena, world.width, world.height, '#');
+    world.purpleBlocks.bind(world.arena, purpleBlockCount);
+}
+
+// Build a fresh level from the world's current size and seed, up to but not
+// including the step until; Done builds all of it
+void buildLevel(World& world, LevelStep until) {
+    // Reset maze and every other level-scoped structure
+    resetLevelArena(world);
+    world.rng.reseed(world.seed);
+    world.gameRng.reseed(~static_cast<std::uint64_t>(world.seed));
+
+    // Reset player position to top-left corner
+    world.playerX = 1;
+    world.playerY = 1;
+
+    // Reset exit position to bottom-right corner of the maze
+    world.exitX = world.width - 2;
+    world.exitY = world.height - 2;
+
+    initializeMaze(world);
+    if (until > LevelStep::Generate) {
+        generateMaze(world, 1, 1); // Start maze generation from position (1, 1)
+    }
+    if (until > LevelStep::PurpleBlocks) {
+        placePurpleBlocks(world);
+    }
+    if (until > LevelStep::PowerUp) {
+        placePowerUp(world);
+    }
+    if (until > LevelStep::Enemy) {
+        placeEnemy(world); // A generated maze always has room
+    }
+}
+
+void startLevel(World& world) {
+    PROFILE_ZONE("startLevel");
+    buildLevel(world, LevelStep::Done);
+
+    // Reset the game timer for the new level
+    world.levelTicks = 0;
+    world.timeLimit = levelTimeLimit;
+    world.puzzleFailed = false;
+}
+
+void advanceLevel(World& world) {
+    // Increment the level
+    world.level++;
+
+    // Increase maze dimensions proportionally
+    world.height += levelGrowth;
+    world.width += levelGrowth;
+
+    world.seed = nextLevelSeed(world.seed);
+    startLevel(world);
+}
+
+// Each level's seed follows from the previous one, so a run is reproducible from its first seed
+std::uint32_t nextLevelSeed(std::uint32_t seed) {
+    return Rng(seed).next();
+}
+
+// Initialize the maze with walls ('#')
+void initializeMaze(World& world) {
+    for (int i = 0; i < world.height; ++i) {
+        for (int j = 0; j < world.width; ++j) {
+            world.maze[i][j] = '#'; // Initialize all cells as walls
+        }
+    }
+}
+
+void generateMaze(World& world, int startX, int startY) {
+    PROFILE_ZONE("generateMaze");
+    std::uint64_t startNs = profileClockNs();
+    auto& maze = world.maze;
+
+    // Only every other cell is ever pushed, so a quarter of the grid bounds the stack
+    ArenaArray<std::pair<int, int>> cellStack;
+    cellStack.bind(world.arena, static_cast<std::size_t>(world.width) * world.height / 4 + 1);
+    maze[startY][startX] = ' ';
+    cellStack.push_back({ startX, startY });
+
+    while (!cellStack.empty()) {
+        int x = cellStack.back().first;
+        int y = cellStack.back().second;
+        std::array<int, 4> directions = { 0, 1, 2, 3 };
+        for (int i = 3; i > 0; --i) {
+            std::swap(directions[i], directions[world.rng.below(i + 1)]);
+        }
+
+        bool moved = false;
+        for (int dir : directions) {
+            int nx = x + DIRECTIONS[dir].first * 2;
+            int ny = y + DIRECTIONS[dir].second * 2;
+
+            if (nx >= 0 && nx < world.width && ny >= 0 && ny < world.height && maze[ny][nx] == '#') {
+                maze[ny][nx] = ' ';
+                maze[y + DIRECTIONS[dir].second][x + DIRECTIONS[dir].first] = ' ';
+                cellStack.push_back({ nx, ny });
+                moved = true;
+                break;
+            }
+        }
+
+        if (!moved) {
+            cellStack.pop_back();
+        }
+    }
+
+    maze[world.exitY][world.exitX] = 'E';
+    world.generateNs = profileClockNs() - startNs;
+}
+
+// Function to place exactly two purple blocks randomly on the maze
+void placePurpleBlocks(World& world) {
+    PROFILE_ZONE("placePurpleBlocks");
+    while (!world.purpleBlocks.full()) { // Limit to 2 blocks
+        int x = world.rng.below(world.width);
+        int y = world.rng.below(world.height);
+
+        // Ensure the block is placed on a walkable cell and not overlapping existing blocks
+        if (world.maze[y][x] == ' ' && std::find(world.purpleBlocks.begin(), world.purpleBlocks.end(), std::make_pair(x, y)) == world.purpleBlocks.end()) {
+            world.purpleBlocks.push_back({ x, y });
+            world.maze[y][x] = 'P'; // Mark the block in the maze
+        }
+    }
+}
+
+// Function to place the power-up in the maze at a random walkable position
+void placePowerUp(World& world) {
+    PROFILE_ZONE("placePowerUp");
+    while (true) {
+        int x = world.rng.below(world.width);
+        int y = world.rng.below(world.height);
+
+        // Ensure the power-up is on a walkable tile, not overlapping purple blocks, exit, or the player
+        if (world.maze[y][x] == ' ' && !(x == world.playerX && y == world.playerY) &&
+            !(x == world.exitX && y == world.exitY) &&
+            std::find(world.purpleBlocks.begin(), world.purpleBlocks.end(), std::make_pair(x, y)) == world.purpleBlocks.end()) {
+            world.powerUpX = x;
+            world.powerUpY = y;
+            world.powerUpActive = true;  // Activate the power-up
+            break;
+        }
+    }
+}
+
+// Set initial enemy position, away from the player. False, with the enemy
+// left as it was, if no acceptable cell turned up in placeEnemyAttempts tries.
+bool placeEnemy(World& world) {
+    PROFILE_ZONE("placeEnemy");
+    int enemyStartX = world.width - 3;
+    int enemyStartY = world.height - 3;
+    int attempts = 0;
+    while (world.maze[enemyStartY][enemyStartX] == '#' || (enemyStartX == world.playerX && enemyStartY == world.playerY) || isTooCloseToPlayer(world, enemyStartX, enemyStartY)) {
+        if (++attempts > placeEnemyAttempts) {
+            return false;
+        }
+        enemyStartX = world.rng.below(world.width);
+        enemyStartY = world.rng.below(world.height);
+    }
+    world.enemy.reset(world.arena, world.width, world.height, enemyStartX, enemyStartY);
+    return true;
+}
+
+// Advance the simulation by one tick, applying the moves pressed during it first
+TickResult stepWorld(World& world, const char* moves, std::size_t moveCount) {
+    for (std::size_t i = 0; i < moveCount && !world.puzzleFailed; ++i) {
+        movePlayer(world, moves[i]);
+    }
+    ++world.tick;
+    ++world.levelTicks;
+
+    if (world.puzzleFailed) {
+        return TickResult::PuzzleFailed;
+    }
+    if (isExitReached(world)) {
+        return TickResult::ExitReached;
+    }
+    if (world.enemy.x == world.playerX && world.enemy.y == world.playerY) {
+        return TickResult::Caught;
+    }
+
+    // Slow down enemy movement
+    if (++world.enemy.moveTicks >= enemyMoveTicks) {
+        world.enemy.move(world, world.gameRng);
+        world.enemy.moveTicks = 0;
+    }
+
+    if (remainingTime(world) <= 0.0f) {
+        return TickResult::TimeUp;
+    }
+    return TickResult::Playing;
+}
+
+// Function to move the player based on key input
+void movePlayer(World& world, char direction) {
+    PROFILE_ZONE("movePlayer");
+    int newX = world.playerX;
+    int newY = world.playerY;
+
+    if (direction == 'W') newY -= 1;  // Move up
+    else if (direction == 'S') newY += 1;  // Move down
+    else if (direction == 'A') newX -= 1;  // Move left
+    else if (direction == 'D') newX += 1;  // Move right
+
+    // Check for purple block interaction before moving
+    if (world.maze[newY][newX] == 'P') {
+        if (checkPurpleBlockInteraction(world, newX, newY)) {
+            return; // Stop movement if the block interaction fails
+        }
+    }
+
+    if (isWalkable(world, newX, newY)) {
+        world.playerX = newX;
+        world.playerY = newY;
+    }
+
+    // Check if the player collected the power-up
+    if (world.powerUpActive && newX == world.powerUpX && newY == world.powerUpY) {
+        collectPowerUp(world);
+    }
+
+}
+
+// Check if a cell is walkable (empty or exit)
+bool isWalkable(const World& world, int x, int y) {
+    return world.maze[y][x] == ' ' || world.maze[y][x] == 'E';
+}
+
+// Check if the player has reached the exit
+bool isExitReached(const World& world) {
+    return world.playerX == world.exitX && world.playerY == world.exitY;
+}
+
+// Check if the enemy is too close to the player
+bool isTooCloseToPlayer(const World& world, int enemyX, int enemyY) {
+    return std::abs(enemyX - world.playerX) < 2 && std::abs(enemyY - world.playerY) < 2;
+}
+
+// Function to check purple block interaction
+bool checkPurpleBlockInteraction(World& world, int x, int y) {
+    for (const auto& block : world.purpleBlocks) {
+        if (block.first == x && block.second == y) {
+            AdditionQuestion question = generateRandomAdditionQuestion(world.gameRng);
+
+            int attempts = 3; // Player gets three attempts
+            bool passed = false;
+
+            while (attempts > 0) {
+                int answer = world.answerPuzzle ? world.answerPuzzle(question) : askPuzzleOnConsole(question);
+
+                if (answer == question.correctAnswer) {
+                    if (world.showMessages) {
+                        std::cout << "Correct! The purple block disappears." << std::endl;
+                    }
+                    world.maze[y][x] = ' ';
+                    world.purpleBlocks.erase(std::remove(world.purpleBlocks.begin(), world.purpleBlocks.end(), block), world.purpleBlocks.end());
+                    passed = true;
+                    break;
+                }
+                else {
+                    attempts--;
+                    if (attempts > 0) {
+                        if (world.showMessages) {
+                            std::cout << "Incorrect! You have " << attempts << " attempt(s) remaining." << std::endl;
+                        }
+                    }
+                    else {
+                        if (world.showMessages) {
+                            std::cout << "Incorrect! You have no attempts left. Game Over!" << std::endl;
+                        }
+                        world.puzzleFailed = true; // End the game
+                    }
+                }
+            }
+            return !passed; // Return true if the block is still blocking
+        }
+    }
+    return false; // No interaction with a purple block
+}
+
+// Function to collect the power-up and apply a random effect
+void collectPowerUp(World& world) {
+    // Randomize the effect
+    int effect = world.gameRng.below(3);  // 0 = freeze enemy, 1 = extra time, 2 = teleport player
+
+    // Declare validTeleport before the switch statement
+    bool validTeleport = false;
+
+    switch (effect) {
+
+    case 0:  // Extra time
+        if (world.showMessages) {
+            std::cout << "Power-Up: Time extended by 30 seconds!" << std::endl;
+        }
+        world.levelTicks = 0;  // Restart the game timer with adjusted remaining time
+        world.timeLimit += 30;     // Add 30 seconds to the time limit
+        break;
+
+    case 1:  // Teleport player
+        if (world.showMessages) {
+            std::cout << "Power-Up: Teleporting to a new position!" << std::endl;
+        }
+
+        while (!validTeleport) {
+            int newX = world.gameRng.below(world.width);
+            int newY = world.gameRng.below(world.height);
+
+            // Ensure the teleport position is walkable and not near the enemy
+            if (isWalkable(world, newX, newY) && !isTooCloseToPlayer(world, newX, newY)) {
+                world.playerX = newX;
+                world.playerY = newY;
+                validTeleport = true;
+            }
+        }
+        break;
+
+    default:
+        if (world.showMessages) {
+            std::cerr << "Unknown power-up effect!" << std::endl;
+        }
+        break;
+    }
+
+    // Deactivate the power-up
+    world.powerUpActive = false;
+    world.powerUpX = -1;
+    world.powerUpY = -1;
+}
+
+// Seconds left on the level timer, never negative
+float remainingTime(const World& world) {
+    float remaining = world.timeLimit - elapsedLevelTime(world);
+    return remaining < 0.0f ? 0.0f : remaining;
+}
+
+// Seconds since the level timer was last restarted
+float elapsedLevelTime(const World& world) {
+    return world.levelTicks * tickSeconds;
+}
+
+// FNV-1a over everything the simulation reads, so two runs that agree on
+// this hash will keep agreeing tick for tick
+std::uint64_t hashWorld(const World& world) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void* data, std::size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    std::int32_t scalars[] = {
+        world.width, world.height, world.level, world.playerX, world.playerY, world.exitX, world.exitY,
+        world.powerUpX, world.powerUpY, world.powerUpActive, world.enemy.x, world.enemy.y, world.enemy.moveTicks,
+        static_cast<std::int32_t>(world.enemy.backtrackStack.size()), static_cast<std::int32_t>(world.purpleBlocks.size()),
+        static_cast<std::int32_t>(world.levelTicks), world.puzzleFailed,
+    };
+    std::uint64_t state[] = { world.seed, world.tick, world.gameRng.getState() };
+    mix(scalars, sizeof(scalars));
+    mix(state, sizeof(state));
+    mix(&world.timeLimit, sizeof(world.timeLimit));
+    mix(world.maze.data(), world.maze.size());
+    return hash;
+}
+
+// Breadth-first walking distance from (fromX, fromY) to every cell, row-major.
+// Cells that cannot be reached are left at UINT32_MAX.
+void buildDistanceField(const World& world, int fromX, int fromY, std::uint32_t* distances) {
+    MemoryTagScope memoryTag(MemoryTag::AI);
+    std::size_t cells = world.maze.size();
+    std::fill(distances, distances + cells, UINT32_MAX);
+
+    std::size_t width = static_cast<std::size_t>(world.width);
+    std::vector<std::size_t> queue;
+    queue.reserve(cells / 2);
+    distances[fromY * width + fromX] = 0;
+    queue.push_back(fromY * width + fromX);
+
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        int x = static_cast<int>(queue[head] % width);
+        int y = static_cast<int>(queue[head] / width);
+        std::uint32_t next = distances[queue[head]] + 1;
+        for (const auto& dir : DIRECTIONS) {
+            int nx = x + dir.first;
+            int ny = y + dir.second;
+            if (nx < 0 || ny < 0 || nx >= world.width || ny >= world.height || world.maze[ny][nx] == '#') {
+                continue;
+            }
+            std::size_t index = ny * width + nx;
+            if (distances[index] == UINT32_MAX) {
+                distances[index] = next;
+                queue.push_back(index);
+            }
+        }
+    }
+}
+
+void Enemy::move(const World& world, Rng& rng) {
+    PROFILE_ZONE("Enemy::move");
+
+    std::array<std::pair<int, int>, 4> neighbors;
+    int neighborCount = 0;
+
+    // Check all possible neighbors
+    for (const auto& dir : DIRECTIONS) {
+        int nx = x + dir.first;
+        int ny = y + dir.second;
+
+        // Add valid, unvisited neighbors
+        if (isWalkable(world, nx, ny) && !visited[ny][nx]) {
+            neighbors[neighborCount++] = { nx, ny };
+        }
+    }
+
+    if (neighborCount > 0) {
+        // Pick a random unvisited neighbor
+        int randomIndex = rng.below(neighborCount);
+        int nextX = neighbors[randomIndex].first;
+        int nextY = neighbors[randomIndex].second;
+
+        // Move to the chosen neighbor
+        x = nextX;
+        y = nextY;
+
+        // Mark it as visited and push it to the backtrack stack
+        visited[y][x] = true;
+        backtrackStack.push_back({ x, y });
+    }
+    else if (!backtrackStack.empty()) {
+        // Backtrack if no unvisited neighbors are found
+        backtrackStack.pop_back(); // Remove the current position
+        if (!backtrackStack.empty()) {
+            x = backtrackStack.back().first;
+            y = backtrackStack.back().second;
+        }
+    }
+}
+
+AdditionQuestion generateRandomAdditionQuestion(Rng& rng) {
+    static const std::vector<int> numbers = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    static const std::vector<int> maxSum = { 5, 10, 15, 20 };
+
+    int num1 = numbers[rng.below(static_cast<int>(numbers.size()))];
+    int num2 = numbers[rng.below(static_cast<int>(numbers.size()))];
+
+    // Ensure the sum doesn't exceed the maximum possible value (e.g., 100)
+    if (num1 + num2 > 100) {
+        return generateRandomAdditionQuestion(rng);
+    }
+
+    AdditionQuestion question;
+    question.num1 = num1;
+    question.num2 = num2;
+    question.correctAnswer = num1 + num2;
+
+    return question;
+}
+
+int askPuzzleOnConsole(const AdditionQuestion& question) {
+    MemoryTagScope memoryTag(MemoryTag::Text);
+    std::cout << "Solve the puzzle to pass: " << question.toString() << std::endl;
+    int answer;
+    std::cin >> answer;
+    return answer;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "LevelArena.h"
+#include "Rng.h"
+
+// Maze size of level 1; every later level adds levelGrowth cells per side
+const int firstLevelSize = 21;
+const int levelGrowth = 4;
+const int purpleBlockCount = 2;
+const int placeEnemyAttempts = 10000; // Random cells tried before placeEnemy gives up
+const float levelTimeLimit = 120.0f;  // 2 minutes in seconds
+
+// The simulation runs on fixed ticks rather than wall-clock time, so a run is
+// reproducible from its seed and inputs. The enemy moves every half second.
+const int ticksPerSecond = 60;
+const float tickSeconds = 1.0f / ticksPerSecond;
+const int enemyMoveTicks = ticksPerSecond / 2;
+
+// Directions for maze carving (up, right, down, left)
+extern const std::vector<std::pair<int, int>> DIRECTIONS;
+
+struct World;
+class MappedMazeFile;
+struct AdditionQuestion;
+
+// Where purple block puzzle answers come from: the console while playing,
+// the recording during a replay
+using PuzzleAnswerer = std::function<int(const AdditionQuestion&)>;
+
+class Enemy {
+public:
+    int x = 0, y = 0;
+    int moveTicks = 0; // Ticks since the last move, controls movement speed
+    ArenaGrid<bool> visited; // Tracks visited cells
+    ArenaArray<std::pair<int, int>> backtrackStack; // For DFS backtracking
+
+    // Carves the enemy's bookkeeping out of the level arena and puts it at (startX, startY)
+    void reset(LevelArena& arena, int mazeWidth, int mazeHeight, int startX, int startY);
+    void move(const World& world, Rng& rng); // One step of the search, choices drawn from rng
+};
+
+// Everything that makes up a running game: the current level's maze and
+// every entity in it. Level-scoped data lives in the world's own arena.
+struct World {
+    LevelArena arena;
+    std::uint32_t arenaEpoch = 0; // Bumped whenever the arena is reset and everything in it rebuilt
+
+    int width = firstLevelSize;
+    int height = firstLevelSize;
+    int level = 1;
+
+    // Seed of the current level. Size plus seed fully determine the generated
+    // maze, purple blocks, power-up and enemy start; rng is only used for that.
+    // gameRng drives everything random during play (enemy, power-ups, puzzles).
+    std::uint32_t seed = 0;
+    Rng rng;
+    Rng gameRng;
+
+    // Maze grid represented as a 2D character array. Usually carved from the
+    // arena; for a prebuilt level it is a copy-on-write view of mazeMapping.
+    ArenaGrid<char> maze;
+    std::shared_ptr<MappedMazeFile> mazeMapping;
+
+    // Player and exit positions
+    int playerX = 1, playerY = 1;
+    int exitX = firstLevelSize - 2, exitY = firstLevelSize - 2;
+
+    // Obstacle positions (purple blocks)
+    ArenaArray<std::pair<int, int>> purpleBlocks;
+
+    // Power-up position
+    int powerUpX = -1, powerUpY = -1;
+    bool powerUpActive = false;  // Whether the power-up is active
+
+    // Simulation clock: ticks since the game started and since the level
+    // timer was last restarted
+    std::uint32_t tick = 0;
+    std::uint32_t levelTicks = 0;
+    float timeLimit = levelTimeLimit;
+
+    Enemy enemy;
+
+    // Set when the player runs out of attempts on a purple block puzzle
+    bool puzzleFailed = false;
+    PuzzleAnswerer answerPuzzle; // Console when empty
+
+    bool showMessages = true; // Console messages for the player; off for ghosts and headless runs
+
+    std::uint64_t generateNs = 0; // How long the last generateMaze took, for the performance overlay
+};
+
+enum class TickResult {
+    Playing,
+    ExitReached,  // Caller moves on with advanceLevel
+    Caught,
+    TimeUp,
+    PuzzleFailed,
+};
+
+struct AdditionQuestion {
+    int num1;
+    int num2;
+    int correctAnswer;
+
+    std::string toString() const {
+        return "What is " + std::to_string(num1) + " + " + std::to_string(num2) + "? ";
+    }
+};
+
+// Level setup
+// The steps startLevel builds a level in, so a level can be stopped short of one
+enum class LevelStep {
+    Generate,
+    PurpleBlocks,
+    PowerUp,
+    Enemy,
+    Done,
+};
+
+void resetLevelArena(World& world);
+void buildLevel(World& world, LevelStep until);
+void startLevel(World& world);
+void advanceLevel(World& world);
+std::uint32_t nextLevelSeed(std::uint32_t seed);
+void initializeMaze(World& world);
+void generateMaze(World& world, int startX, int startY);
+void placePurpleBlocks(World& world);
+void placePowerUp(World& world);
+bool placeEnemy(World& world);
+
+// Gameplay
+TickResult stepWorld(World& world, const char* moves, std::size_t moveCount);
+void movePlayer(World& world, char direction);
+bool isWalkable(const World& world, int x, int y);
+bool isExitReached(const World& world);
+bool isTooCloseToPlayer(const World& world, int enemyX, int enemyY);
+bool checkPurpleBlockInteraction(World& world, int x, int y);
+void collectPowerUp(World& world);
+float remainingTime(const World& world);
+float elapsedLevelTime(const World& world);
+std::uint64_t hashWorld(const World& world);
+void buildDistanceField(const World& world, int fromX, int fromY, std::uint32_t* distances);
+AdditionQuestion generateRandomAdditionQuestion(Rng& rng);
+int askPuzzleOnConsole(const AdditionQuestion& question);